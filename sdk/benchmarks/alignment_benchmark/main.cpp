@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <tdv/utils/alignment/Alignment.h>
+
+using namespace tdv::utils::alignment;
+
+namespace
+{
+
+/**
+ * @brief Previous recognizer alignment: reweighted 4x4 systems solved with SVD, kept as the baseline
+ */
+cv::Matx23f legacyEstimate(
+	const std::vector<cv::Point2f> &src,
+	const std::vector<cv::Point2f> &dst,
+	const int iterations_count)
+{
+	std::vector<float> weights(src.size(), 1.f);
+
+	std::vector<float> temp(src.size());
+
+	for(int iterations = 0; ; ++iterations)
+	{
+		float sa[4][4], sb[4], sr[4];
+
+		std::memset(sa, 0, sizeof(sa));
+		std::memset(sb, 0, sizeof(sb));
+		std::memset(sr, 0, sizeof(sr));
+
+		for(size_t i = 0; i < src.size(); ++i)
+		{
+			const cv::Point2f &a = src[i];
+			const cv::Point2f &b = dst[i];
+			const float w = weights[i];
+
+			sa[0][0] += w * ( a.x * a.x  +  a.y * a.y );
+			sa[0][2] += w * ( a.x );
+			sa[0][3] += w * ( a.y );
+			sa[1][0] += w * ( a.y * a.x  -  a.x * a.y );
+			sa[2][2] += w * ( 1.f );
+
+			sb[0] += w * ( a.x * b.x + a.y * b.y );
+			sb[1] += w * ( a.y * b.x - a.x * b.y );
+			sb[2] += w * ( b.x );
+			sb[3] += w * ( b.y );
+		}
+
+		sa[1][1] = sa[0][0];
+		sa[1][2] = sa[0][3];
+		sa[1][3] = - sa[0][2];
+
+		sa[2][0] = sa[0][2];
+		sa[2][1] = sa[0][3];
+
+		sa[3][0] = sa[0][3];
+		sa[3][1] = -sa[0][2];
+		sa[3][3] = sa[2][2];
+
+		float sw[4];
+		for(int i = 0; i < 4; ++i)
+			sw[i] = 1.f / sqrt( std::abs<float>(sa[i][i]) + 1e-6 );
+
+		for(int i = 0; i < 4; ++i)
+		{
+			sb[i] *= sw[i];
+
+			for(int j = 0; j < 4; ++j)
+				sa[i][j] *= sw[i] * sw[j];
+		}
+
+		cv::solve(
+			cv::Mat_<float>(4, 4, (float*) sa),
+			cv::Mat_<float>(4, 1, (float*) sb),
+			cv::Mat_<float>(4, 1, (float*) sr),
+			cv::DECOMP_SVD);
+
+		for(int i = 0; i < 4; ++i)
+			sr[i] *= sw[i];
+
+		if(iterations >= iterations_count)
+		{
+			cv::Matx23f result;
+			result(0, 0) = sr[0];
+			result(0, 1) = sr[1];
+			result(0, 2) = sr[2];
+			result(1, 0) = -sr[1];
+			result(1, 1) = sr[0];
+			result(1, 2) = sr[3];
+			return result;
+		}
+
+		for(size_t i = 0; i < src.size(); ++i)
+		{
+			const cv::Point2f &a = src[i];
+			const cv::Point2f &b = dst[i];
+
+			cv::Point2f c;
+			c.x =   a.x * sr[0] + a.y * sr[1] + sr[2];
+			c.y = - a.x * sr[1] + a.y * sr[0] + sr[3];
+
+			weights[i] = cv::norm(b-c);
+		}
+
+		temp = weights;
+
+		std::nth_element(
+			temp.data(),
+			temp.data() + temp.size() / 2,
+			temp.data() + temp.size());
+
+		const float nw = temp[temp.size() / 2];
+
+		for(size_t i = 0; i < src.size(); ++i)
+			weights[i] = 1.f / (nw + weights[i] + 1e-6);
+	}
+}
+
+struct Case
+{
+	std::vector<cv::Point2f> src;
+	std::vector<cv::Point2f> dst;
+};
+
+const float CROP_SIZE = 112;
+
+/**
+ * @brief Recognizer crop points mapped to an image by a random similarity with landmark noise and occasional outliers
+ */
+std::vector<Case> generateCases(size_t count, std::mt19937& generator)
+{
+	const std::vector<cv::Point2f> crop = {
+		cv::Point2f(38.30f, 51.70f),
+		cv::Point2f(73.53f, 51.50f),
+		cv::Point2f(56.00f, 71.70f),
+		cv::Point2f(41.55f, 92.37f),
+		cv::Point2f(70.73f, 92.20f),
+	};
+
+	std::uniform_real_distribution<float> scale(0.5f, 4.f);
+	std::uniform_real_distribution<float> angle(-0.5f, 0.5f);
+	std::uniform_real_distribution<float> shift(0, 1000);
+	std::normal_distribution<float> noise(0, 1.5f);
+	std::uniform_real_distribution<float> uniform(0, 1);
+
+	std::vector<Case> cases(count);
+	for (Case& c : cases)
+	{
+		const float s = scale(generator), a = angle(generator);
+		const float tx = shift(generator), ty = shift(generator);
+		c.src = crop;
+		for (const cv::Point2f& p : crop)
+			c.dst.push_back(cv::Point2f(
+				s * (std::cos(a) * p.x + std::sin(a) * p.y) + tx + noise(generator),
+				s * (-std::sin(a) * p.x + std::cos(a) * p.y) + ty + noise(generator)));
+		if (uniform(generator) < 0.1f)
+		{
+			cv::Point2f& outlier = c.dst[generator() % c.dst.size()];
+			outlier = outlier + cv::Point2f(15, -15);
+		}
+	}
+	return cases;
+}
+
+/**
+ * @brief Largest distance between the crop corners mapped by the two transforms, in image pixels
+ */
+float deviation(const cv::Matx23f& a, const cv::Matx23f& b)
+{
+	float result = 0;
+	for (const cv::Point2f& p : {cv::Point2f(0, 0), cv::Point2f(CROP_SIZE, 0), cv::Point2f(0, CROP_SIZE), cv::Point2f(CROP_SIZE, CROP_SIZE)})
+	{
+		const float dx = (a(0, 0) - b(0, 0)) * p.x + (a(0, 1) - b(0, 1)) * p.y + a(0, 2) - b(0, 2);
+		const float dy = (a(1, 0) - b(1, 0)) * p.x + (a(1, 1) - b(1, 1)) * p.y + a(1, 2) - b(1, 2);
+		result = std::max(result, std::sqrt(dx * dx + dy * dy));
+	}
+	return result;
+}
+
+template <typename Function>
+double measure(const std::vector<Case>& cases, Function function, int iterations)
+{
+	volatile float sink = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		for (const Case& c : cases)
+			sink = sink + function(c)(0, 2);
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / (iterations * cases.size());
+}
+
+// max deviation of the method from the reference over all cases, mean deviation to mean
+template <typename Method, typename Reference>
+float compare(const std::vector<Case>& cases, Method method, Reference reference, float& mean)
+{
+	float result = 0;
+	mean = 0;
+	for (const Case& c : cases)
+	{
+		const float d = deviation(method(c), reference(c));
+		result = std::max(result, d);
+		mean += d / cases.size();
+	}
+	return result;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+	std::mt19937 generator(42);
+	const std::vector<Case> cases = generateCases(1000, generator);
+
+	auto legacy = [](const Case& c) { return legacyEstimate(c.src, c.dst, 10); };
+	auto legacyLeastSquares = [](const Case& c) { return legacyEstimate(c.src, c.dst, 0); };
+	auto closedForm = [](const Case& c) { return estimateSimilarity(c.src, c.dst); };
+	auto robust = [](const Case& c) { return estimateSimilarityRobust(c.src, c.dst); };
+	auto robustFull = [](const Case& c)
+	{
+		RobustParameters parameters;
+		parameters.tolerance = 0;
+		return estimateSimilarityRobust(c.src, c.dst, parameters);
+	};
+
+	std::cout << std::left << std::setw(24) << "method" << "time, us" << std::endl;
+	const double legacyTime = measure(cases, legacy, iterations);
+	const double closedFormTime = measure(cases, closedForm, iterations);
+	for (const auto& item : {std::make_pair("legacy (10 SVD)", legacyTime),
+		std::make_pair("legacy (1 SVD)", measure(cases, legacyLeastSquares, iterations)),
+		std::make_pair("closed_form", closedFormTime),
+		std::make_pair("robust", measure(cases, robust, iterations)),
+		std::make_pair("robust (no early stop)", measure(cases, robustFull, iterations))})
+		std::cout << std::left << std::setw(24) << item.first << std::fixed << std::setprecision(3) << item.second << std::endl;
+	std::cout << "speedup (closed_form vs legacy): " << std::setprecision(1) << legacyTime / closedFormTime << "x" << std::endl;
+
+	// the same problems must give the same transforms, deviations are in image pixels at the crop corners
+	float mean = 0;
+	bool failed = false;
+	auto check = [&](const std::string& name, float max, float limit)
+	{
+		std::cout << std::left << std::setw(40) << name << "max " << std::setprecision(5) << max << " px, mean " << mean << " px";
+		if (limit > 0 && max > limit)
+		{
+			std::cout << " - exceeds " << limit;
+			failed = true;
+		}
+		std::cout << std::endl;
+	};
+
+	check("closed_form vs legacy (1 SVD)", compare(cases, closedForm, legacyLeastSquares, mean), 0.05f);
+	check("robust (no early stop) vs legacy", compare(cases, robustFull, legacy, mean), 0.05f);
+	check("robust vs legacy", compare(cases, robust, legacy, mean), 0.05f);
+	// different estimators, reported for reference
+	check("closed_form vs legacy", compare(cases, closedForm, legacy, mean), 0);
+
+	return failed ? 1 : 0;
+}
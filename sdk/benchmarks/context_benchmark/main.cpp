@@ -0,0 +1,259 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <api/c_api.h>
+#include <tdv/data/Context.h>
+#include <tdv/data/JSONSerializer.h>
+#include <tdv/modules/ProcessingBlock.h>
+#include <tdv/utils/recognizer_utils/RecognizerUtils.h>
+
+using tdv::data::Context;
+using tdv::data::JSONSerializer;
+using namespace api;
+
+namespace
+{
+
+const size_t FACES = 50;
+const size_t MESH_POINTS = 468;
+const size_t TEMPLATE_SIZE = 512;
+const char* const EMOTIONS[] = {"ANGRY", "DISGUSTED", "SCARED", "HAPPY", "NEUTRAL", "SAD", "SURPRISED"};
+
+/**
+ * @brief Frame after detection, mesh fitting, recognition and attribute estimation of FACES faces,
+ * objects are filled the way FACE_DETECTOR, FITTER with the verbose landmarks output, FACE_RECOGNIZER
+ * and the estimators do
+ */
+Context makeFrame(std::mt19937& generator)
+{
+	std::uniform_real_distribution<double> coordinate(0, 1);
+
+	Context frame;
+	frame["image"]["format"] = "NDARRAY";
+	frame["image"]["dtype"] = "uint8_t";
+	for (int64_t dim : {1080, 1920, 3})
+		frame["image"]["shape"].push_back(dim);
+
+	Context& objects = frame["objects"];
+	for (size_t i = 0; i < FACES; ++i)
+	{
+		Context face;
+		face["id"] = static_cast<int64_t>(i);
+		face["class"] = "face";
+		face["confidence"] = coordinate(generator);
+		face["score"] = face["confidence"].get<double>();
+		for (int k = 0; k < 4; ++k)
+			face["bbox"].push_back(coordinate(generator));
+
+		Context& keypoints = face["keypoints"];
+		keypoints["fitter_type"] = "mesh";
+		Context& points = keypoints["points"];
+		for (size_t p = 0; p < MESH_POINTS; ++p)
+		{
+			Context point;
+			point["x"] = coordinate(generator);
+			point["y"] = coordinate(generator);
+			point["z"] = coordinate(generator);
+			points.push_back(std::move(point));
+		}
+		// named [x, y] points of the mesh
+		tdv::utils::recognizer_utils::constructFdaPonints2Context(keypoints);
+
+		std::vector<float> faceTemplate(TEMPLATE_SIZE);
+		for (float& value : faceTemplate)
+			value = static_cast<float>(coordinate(generator));
+		face["template"] = std::move(faceTemplate);
+		face["template_size"] = static_cast<int64_t>(TEMPLATE_SIZE);
+
+		face["age"] = static_cast<int64_t>(30);
+		face["gender"] = "FEMALE";
+		for (const char* name : EMOTIONS)
+		{
+			Context emotion;
+			emotion["emotion"] = name;
+			emotion["confidence"] = coordinate(generator);
+			face["emotions"].push_back(std::move(emotion));
+		}
+
+		objects.push_back(std::move(face));
+	}
+	return frame;
+}
+
+// Context building through the C API, the way api::Context does it
+HContext* makeFrameCApi(const Context& frame)
+{
+	HContext* result = TDVContext_create(nullptr);
+	HContext* objects = TDVContext_getOrInsertByKey(result, "objects", nullptr);
+	for (const Context& face : frame["objects"])
+	{
+		HContext* object = TDVContext_create(nullptr);
+		TDVContext_putLong(TDVContext_getOrInsertByKey(object, "id", nullptr), face["id"].get<int64_t>(), nullptr);
+		TDVContext_putStr(TDVContext_getOrInsertByKey(object, "class", nullptr), "face", nullptr);
+		TDVContext_putDouble(TDVContext_getOrInsertByKey(object, "confidence", nullptr), face["confidence"].get<double>(), nullptr);
+
+		HContext* points = TDVContext_getOrInsertByKey(TDVContext_getOrInsertByKey(object, "keypoints", nullptr), "points", nullptr);
+		for (const Context& point : face["keypoints"]["points"])
+		{
+			HContext* pointCtx = TDVContext_create(nullptr);
+			for (const char* key : {"x", "y", "z"})
+				TDVContext_putDouble(TDVContext_getOrInsertByKey(pointCtx, key, nullptr), point[key].get<double>(), nullptr);
+			TDVContext_pushBack(points, pointCtx, false, nullptr);
+			TDVContext_destroy(pointCtx, nullptr);
+		}
+
+		TDVContext_pushBack(objects, object, false, nullptr);
+		TDVContext_destroy(object, nullptr);
+	}
+	return result;
+}
+
+// Block doing nothing, the processSparse call is the JSON round trip only
+class PassThroughBlock : public tdv::modules::ProcessingBlock
+{
+public:
+	void operator()(Context&) override {}
+};
+
+template <typename Function>
+double measure(Function function, int iterations)
+{
+	function();	// warm up
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		function();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+void report(const std::string& group, const std::string& name, double time, size_t operations)
+{
+	std::cout << std::left << std::setw(12) << group << std::setw(28) << name << std::setw(14) << std::fixed
+		<< std::setprecision(3) << time << std::setprecision(1) << time * 1e6 / operations << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 50;
+	std::mt19937 generator(42);
+
+	// non-const, so operator[] is measured without inserting and at() through a const reference
+	Context frame = makeFrame(generator);
+	const Context& constFrame = frame;
+	const size_t points = FACES * MESH_POINTS;
+	double sink = 0;
+
+	std::cout << FACES << " faces, " << MESH_POINTS << " mesh points, " << TEMPLATE_SIZE << " template values per face" << std::endl;
+	std::cout << std::left << std::setw(12) << "group" << std::setw(28) << "case" << std::setw(14) << "time, ms" << "ns per item" << std::endl;
+
+	// Context
+
+	report("context", "insert", measure([&]{ Context result = makeFrame(generator); sink += result.size(); }, iterations), points * 3);
+
+	report("context", "lookup operator[]", measure([&]
+	{
+		Context& objects = frame["objects"];
+		for (size_t i = 0; i < FACES; ++i)
+		{
+			Context& pointsCtx = objects[i]["keypoints"]["points"];
+			for (size_t p = 0; p < MESH_POINTS; ++p)
+				sink += pointsCtx[p]["x"].get<double>();
+		}
+	}, iterations), points);
+
+	report("context", "lookup at", measure([&]
+	{
+		const Context& objects = constFrame.at("objects");
+		for (size_t i = 0; i < FACES; ++i)
+		{
+			const Context& pointsCtx = objects.at(i).at("keypoints").at("points");
+			for (size_t p = 0; p < MESH_POINTS; ++p)
+				sink += pointsCtx.at(p).at("x").get<double>();
+		}
+	}, iterations), points);
+
+	report("context", "iterate", measure([&]
+	{
+		for (const Context& face : constFrame["objects"])
+			for (const Context& point : face["keypoints"]["points"])
+				for (auto it = point.kvcbegin(); it != point.kvcend(); ++it)
+					sink += it->second.get<double>();
+	}, iterations), points * 3);
+
+	report("context", "copy", measure([&]{ Context copy(frame); sink += copy.size(); }, iterations), FACES);
+
+	Context moved(frame);
+	report("context", "move", measure([&]{ Context tmp(std::move(moved)); moved = std::move(tmp); }, iterations), 2);
+
+	// JSON serializer
+
+	std::string json;
+	const double serializeTime = measure([&]{ json = JSONSerializer::serialize(frame); }, iterations);
+	report("json", "serialize", serializeTime, FACES);
+	report("json", "deserialize", measure([&]{ Context result = JSONSerializer::deserialize(json); sink += result.size(); }, iterations), FACES);
+	std::cout << "json size: " << json.size() / 1024 << " KB, serialize " << std::setprecision(1)
+		<< json.size() / serializeTime / 1e3 << " MB/s" << std::endl;
+
+	// C API
+
+	HContext* handle = reinterpret_cast<HContext*>(&frame);
+
+	report("c_api", "build", measure([&]
+	{
+		HContext* result = makeFrameCApi(frame);
+		TDVContext_destroy(result, nullptr);
+	}, iterations), points * 3);
+
+	report("c_api", "getByKey/getByIndex", measure([&]
+	{
+		HContext* objects = TDVContext_getByKey(handle, "objects", nullptr);
+		for (size_t i = 0; i < FACES; ++i)
+		{
+			HContext* pointsCtx = TDVContext_getByKey(TDVContext_getByKey(TDVContext_getByIndex(objects, i, nullptr), "keypoints", nullptr), "points", nullptr);
+			for (size_t p = 0; p < MESH_POINTS; ++p)
+				sink += TDVContext_getDouble(TDVContext_getByKey(TDVContext_getByIndex(pointsCtx, p, nullptr), "x", nullptr), nullptr);
+		}
+	}, iterations), points);
+
+	report("c_api", "getKeys", measure([&]
+	{
+		HContext* face = TDVContext_getByIndex(TDVContext_getByKey(handle, "objects", nullptr), 0, nullptr);
+		HContext* keypoints = TDVContext_getByKey(face, "keypoints", nullptr);
+		const uint64_t length = TDVContext_getLength(keypoints, nullptr);
+		char** keys = TDVContext_getKeys(keypoints, length, nullptr);
+		for (uint64_t i = 0; i < length; ++i)
+		{
+			sink += std::strlen(keys[i]);
+			TDVContext_freePtr(keys[i]);
+		}
+		TDVContext_freePtr(keys);
+	}, iterations * 100), 1);
+
+	report("c_api", "clone", measure([&]
+	{
+		HContext* clone = TDVContext_clone(handle, nullptr);
+		TDVContext_destroy(clone, nullptr);
+	}, iterations), FACES);
+
+	HContext* destination = TDVContext_create(nullptr);
+	report("c_api", "copy", measure([&]{ TDVContext_copy(handle, destination, nullptr); }, iterations), FACES);
+	TDVContext_destroy(destination, nullptr);
+
+	TDVProcessingBlock* block = _tdv_ProcessingBlock_wrap(new PassThroughBlock());
+	report("c_api", "processSparse", measure([&]
+	{
+		char* result = TDVProcessingBlock_processSparse(block, const_cast<char*>(json.c_str()));
+		sink += std::strlen(result);
+		tdvFreeStr(result);
+	}, iterations), FACES);
+	TDVProcessingBlock_destroy(block);
+
+	return sink > 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <tdv/utils/heatmap_utils/HeatmapUtils.h>
+
+using namespace tdv::utils::heatmap_utils;
+
+namespace
+{
+
+const int JOINTS = 17;
+const int HEIGHT = 64;
+const int WIDTH = 48;
+
+/**
+ * @brief Previous pose postprocess: minMaxLoc per joint per person collected into a map, kept as the baseline
+ */
+std::map<int, std::vector<std::vector<float>>> legacyDecode(const float* heatmaps, int persons)
+{
+	std::map<int, std::vector<std::vector<float>>> keypoints;
+	for (int p = 0; p < persons; ++p)
+	{
+		keypoints[p] = std::vector<std::vector<float>>(JOINTS, std::vector<float>(3, 0.0));
+		for (int h = 0; h < JOINTS; ++h)
+		{
+			cv::Mat heatmap(HEIGHT, WIDTH, CV_32F, const_cast<float*>(heatmaps) + (p * JOINTS + h) * HEIGHT * WIDTH);
+			double minVal;
+			double maxVal;
+			cv::Point minLoc;
+			cv::Point maxLoc;
+			cv::minMaxLoc(heatmap, &minVal, &maxVal, &minLoc, &maxLoc);
+			keypoints[p][h][0] = maxLoc.x;
+			keypoints[p][h][1] = maxLoc.y;
+			keypoints[p][h][2] = maxVal;
+		}
+	}
+	return keypoints;
+}
+
+/**
+ * @brief Gaussian blobs at sub-pixel positions with a little noise, as the pose model outputs
+ */
+std::vector<float> generateHeatmaps(int persons, std::vector<float>& centers, std::mt19937& generator)
+{
+	std::uniform_real_distribution<float> x(4, WIDTH - 5), y(4, HEIGHT - 5);
+	std::uniform_real_distribution<float> noise(0, 0.01f);
+	const float sigma = 2;
+
+	std::vector<float> heatmaps(static_cast<size_t>(persons) * JOINTS * HEIGHT * WIDTH);
+	centers.clear();
+	for (int i = 0; i < persons * JOINTS; ++i)
+	{
+		const float cx = x(generator), cy = y(generator);
+		centers.push_back(cx);
+		centers.push_back(cy);
+		float* heatmap = heatmaps.data() + static_cast<size_t>(i) * HEIGHT * WIDTH;
+		for (int r = 0; r < HEIGHT; ++r)
+			for (int c = 0; c < WIDTH; ++c)
+				heatmap[r * WIDTH + c] = std::exp(-((c - cx) * (c - cx) + (r - cy) * (r - cy)) / (2 * sigma * sigma)) + noise(generator);
+	}
+	return heatmaps;
+}
+
+template <typename Function>
+double measure(Function function, int iterations)
+{
+	function();	// warm up
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		function();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+double meanError(const std::vector<float>& keypoints, const std::vector<float>& centers)
+{
+	double error = 0;
+	for (size_t i = 0; i < centers.size() / 2; ++i)
+		error += std::hypot(keypoints[3 * i] - centers[2 * i], keypoints[3 * i + 1] - centers[2 * i + 1]);
+	return error / (centers.size() / 2);
+}
+
+void report(const std::string& name, int persons, double time, double error)
+{
+	std::cout << std::left << std::setw(20) << name << std::setw(10) << persons
+		<< std::setw(14) << std::fixed << std::setprecision(3) << time << std::setprecision(4) << error << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+	std::mt19937 generator(42);
+
+	std::cout << std::left << std::setw(20) << "method" << std::setw(10) << "persons"
+		<< std::setw(14) << "time, ms" << "mean error, px" << std::endl;
+
+	for (int persons : {1, 16, 64})
+	{
+		std::vector<float> centers;
+		const std::vector<float> heatmaps = generateHeatmaps(persons, centers, generator);
+		const size_t count = static_cast<size_t>(persons) * JOINTS;
+
+		std::map<int, std::vector<std::vector<float>>> legacy;
+		const double legacyTime = measure([&]{ legacy = legacyDecode(heatmaps.data(), persons); }, iterations);
+		std::vector<float> legacyKeypoints;
+		for (const auto& person : legacy)
+			for (const auto& point : person.second)
+				legacyKeypoints.insert(legacyKeypoints.end(), point.begin(), point.end());
+		report("legacy", persons, legacyTime, meanError(legacyKeypoints, centers));
+
+		std::vector<float> keypoints(count * 3);
+		HeatmapParameters parameters;
+		parameters.refinement = HeatmapRefinement::NONE;
+		const double noneTime = measure([&]{ decodeHeatmaps(heatmaps.data(), count, HEIGHT, WIDTH, parameters, keypoints.data()); }, iterations);
+		report("none", persons, noneTime, meanError(keypoints, centers));
+		if (keypoints != legacyKeypoints)
+		{
+			std::cerr << "argmax differs from the legacy implementation" << std::endl;
+			return 1;
+		}
+		const double argmaxError = meanError(keypoints, centers);
+
+		auto run = [&](const std::string& name)
+		{
+			const double time = measure([&]{ decodeHeatmaps(heatmaps.data(), count, HEIGHT, WIDTH, parameters, keypoints.data()); }, iterations);
+			report(name, persons, time, meanError(keypoints, centers));
+			return time;
+		};
+
+		double darkTime = 0;
+		for (auto refinement : {std::make_pair("quadratic", HeatmapRefinement::QUADRATIC), std::make_pair("dark", HeatmapRefinement::DARK)})
+		{
+			parameters.refinement = refinement.second;
+			darkTime = run(refinement.first);
+			if (meanError(keypoints, centers) >= argmaxError)
+			{
+				std::cerr << refinement.first << " refinement does not improve the argmax accuracy" << std::endl;
+				return 1;
+			}
+		}
+
+		std::cout << "speedup (dark vs legacy): " << std::setprecision(2) << legacyTime / darkTime << "x" << std::endl;
+	}
+
+	return 0;
+}
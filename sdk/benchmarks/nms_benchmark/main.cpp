@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <tdv/utils/nms_utils/NMSUtils.h>
+
+using namespace tdv::utils::nms_utils;
+
+namespace
+{
+
+/**
+ * @brief Previous detector NMS over std::vector<std::vector<float>> boxes, kept as the baseline
+ */
+inline float area(const std::vector<float>& v) {
+	if (v.size()!=4)
+		return 0;
+	float area = (v[2]-v[0])*(v[3]-v[1]);
+	return (area > 0) ? area : 0;
+}
+
+inline std::vector<float> intersection(const std::vector<float>& v1, const std::vector<float>& v2) {
+
+	if (!(v1.size()==4 && v2.size()==4 && (v1[0]<v1[2]) && (v1[1]<v1[3]) && (v2[0]<v2[2]) && (v2[1]<v2[3])))
+		return {0, 0, 0, 0};
+
+	float x1_max = (v1[0] < v2[0]) ? v2[0] : v1[0];
+	float y1_max = (v1[1] < v2[1]) ? v2[1] : v1[1];
+	float x2_min = (v1[2] < v2[2]) ? v1[2] : v2[2];
+	float y2_min = (v1[3] < v2[3]) ? v1[3] : v2[3];
+
+	if ((x1_max >= x2_min) || (y1_max >= y2_min)) {
+		return {0, 0, 0, 0};
+	}
+	return {x1_max, y1_max, x2_min, y2_min};
+}
+
+void legacyNMS(const std::vector<std::vector<float>>& bboxes, const std::vector<float>& scores,
+	const float nms_threshold, std::vector<int>& indices)
+{
+	std::vector<std::pair<float, int> > score_index_vec;
+	for (size_t i = 0; i < scores.size(); ++i)
+		if (scores[i] > 0)
+			score_index_vec.push_back(std::make_pair(scores[i], i));
+	std::stable_sort(score_index_vec.begin(), score_index_vec.end(),
+		[](const std::pair<float, int>& a, const std::pair<float, int>& b){ return a.first > b.first; });
+
+	indices.clear();
+	for (size_t i = 0; i < score_index_vec.size(); ++i) {
+		const int idx = score_index_vec[i].second;
+		bool keep = true;
+		for (int k = 0; k < (int)indices.size() && keep; ++k) {
+			const int kept_idx = indices[k];
+			float intArea = static_cast<float>(area(intersection(bboxes[idx], bboxes[kept_idx])));
+			float unionArea = area(bboxes[idx]) + area(bboxes[kept_idx]) - intArea;
+			float overlap = intArea / unionArea;
+			keep = overlap <= nms_threshold;
+		}
+		if (keep)
+			indices.push_back(idx);
+	}
+}
+
+/**
+ * @brief Crowded scene: candidates are jittered around a number of objects, as detector outputs are
+ */
+Boxes generateBoxes(size_t count, std::mt19937& generator)
+{
+	const size_t objects = std::max<size_t>(count / 20, 1);
+	std::uniform_real_distribution<float> position(0, 640);
+	std::uniform_real_distribution<float> size(10, 120);
+	std::normal_distribution<float> jitter(0, 4);
+	std::uniform_real_distribution<float> score(0.05f, 1.f);
+	std::uniform_int_distribution<int> class_id(0, 3);
+
+	std::vector<std::vector<float>> centers;
+	for (size_t i = 0; i < objects; ++i)
+		centers.push_back({position(generator), position(generator), size(generator), size(generator)});
+
+	Boxes boxes;
+	boxes.reserve(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto& c = centers[i % objects];
+		const float x = c[0] + jitter(generator), y = c[1] + jitter(generator);
+		const float w = c[2] + jitter(generator), h = c[3] + jitter(generator);
+		boxes.push_back(x - w / 2, y - h / 2, x + w / 2, y + h / 2, score(generator), class_id(generator));
+	}
+	return boxes;
+}
+
+template <typename Function>
+double measure(Function function, int iterations)
+{
+	function();	// warm up
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		function();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+void report(const std::string& name, size_t count, double time, size_t kept)
+{
+	std::cout << std::left << std::setw(16) << name << std::setw(10) << count
+		<< std::setw(14) << std::fixed << std::setprecision(3) << time << kept << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+	std::mt19937 generator(42);
+
+	std::cout << std::left << std::setw(16) << "method" << std::setw(10) << "boxes"
+		<< std::setw(14) << "time, ms" << "kept" << std::endl;
+
+	for (size_t count : {1000, 10000})
+	{
+		const Boxes boxes = generateBoxes(count, generator);
+
+		std::vector<std::vector<float>> legacyBoxes;
+		for (size_t i = 0; i < boxes.size(); ++i)
+			legacyBoxes.push_back({boxes.x1[i], boxes.y1[i], boxes.x2[i], boxes.y2[i]});
+
+		std::vector<int> legacyIndices;
+		const double legacyTime = measure([&]{ legacyNMS(legacyBoxes, boxes.scores, 0.5f, legacyIndices); }, iterations);
+		report("legacy", count, legacyTime, legacyIndices.size());
+
+		NMSParameters parameters;
+		std::vector<int> indices;
+		const double hardTime = measure([&]{ indices = nms(boxes, parameters); }, iterations);
+		report("hard", count, hardTime, indices.size());
+		if (indices != legacyIndices)
+		{
+			std::cerr << "hard NMS result differs from the legacy implementation" << std::endl;
+			return 1;
+		}
+
+		auto run = [&](const std::string& name)
+		{
+			const double time = measure([&]{ indices = nms(boxes, parameters); }, iterations);
+			report(name, count, time, indices.size());
+		};
+
+		parameters.classAware = true;
+		run("class_aware");
+		parameters.classAware = false;
+
+		parameters.scoreThreshold = 0.05f;
+		parameters.method = NMSMethod::SOFT_LINEAR;
+		run("soft_linear");
+
+		parameters.method = NMSMethod::SOFT_GAUSSIAN;
+		run("soft_gaussian");
+
+		std::cout << "speedup (hard vs legacy): " << std::setprecision(2) << legacyTime / hardTime << "x" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,501 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <api/Service.h>
+
+#include "ConsoleArgumentsParser.h"
+
+using Context = api::Context;
+
+namespace
+{
+
+// operator new calls of the whole process, including the worker threads of the blocks
+std::atomic<uint64_t> allocations(0);
+
+}
+
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+namespace
+{
+
+/**
+ * @brief Benchmarked processing block and the way its input is prepared
+ */
+struct BenchmarkCase
+{
+	std::string unitType;
+	std::string image;							// file of the test_images folder
+	std::vector<std::string> prerequisites;		// blocks run once on the image to prepare the input objects
+	bool imageBatch;							// batch of images, otherwise batch of objects of one image
+	bool batched;								// false - the block is measured with batch size 1 only
+	size_t objects;								// fixed number of input objects, 0 - the batch size
+	bool trackIds;								// objects get distinct track ids
+	std::function<void(api::Service&, Context&)> configure;	// additional block config
+	std::string stateKey;						// input key selecting the state kept by the block between calls,
+												// set per call so that every call starts from an empty state
+};
+
+struct Resolution
+{
+	std::string name;
+	int width;
+	int height;
+};
+
+struct Measurement
+{
+	size_t calls = 0;
+	double mean = 0;
+	double p50 = 0;
+	double p95 = 0;
+	double p99 = 0;
+	double throughput = 0;		// items (images or objects) per second
+	double allocations = 0;		// per call, all threads of the process
+	double peakRss = 0;			// MB
+};
+
+std::vector<BenchmarkCase> benchmarkCases()
+{
+	const std::vector<std::string> face = {"FACE_DETECTOR", "FITTER"};
+	const std::vector<std::string> body = {"HUMAN_BODY_DETECTOR"};
+	const auto none = [](api::Service&, Context&){};
+
+	return {
+		{"FACE_DETECTOR", "face.jpg", {}, true, true, 0, false, none},
+		{"HUMAN_BODY_DETECTOR", "body.jpg", {}, true, true, 0, false, none},
+		{"FITTER", "face.jpg", {"FACE_DETECTOR"}, false, true, 0, false, none},
+		{"FACE_RECOGNIZER", "face.jpg", face, false, true, 0, false, none},
+		{"AGE_ESTIMATOR", "face.jpg", face, false, true, 0, false, none},
+		{"GENDER_ESTIMATOR", "face.jpg", face, false, true, 0, false, none},
+		{"EMOTION_ESTIMATOR", "face.jpg", face, false, true, 0, false, none},
+		{"GLASSES_ESTIMATOR", "face.jpg", face, false, true, 0, false, none},
+		{"MASK_ESTIMATOR", "face.jpg", face, false, true, 0, false, none},
+		{"EYE_OPENNESS_ESTIMATOR", "face.jpg", face, false, true, 0, false, none},
+		{"LIVENESS_ESTIMATOR", "face.jpg", face, false, true, 0, false, none},
+		{"FACE_ATTRIBUTES", "face.jpg", face, false, true, 0, false, none},
+		{"MATCHER_MODULE", "face.jpg", {"FACE_DETECTOR", "FITTER", "FACE_RECOGNIZER"}, false, false, 2, false, none},
+		{"BODY_RE_IDENTIFICATION", "body.jpg", body, false, true, 0, false, none},
+		{"BODY_REID_MATCHER", "body.jpg", {"HUMAN_BODY_DETECTOR", "BODY_RE_IDENTIFICATION"}, false, true, 0, false, none, "camera_group"},
+		{"POSE_ESTIMATOR", "body.jpg", body, false, true, 0, false, none},
+		{"ACTION_RECOGNIZER", "body.jpg", {"HUMAN_BODY_DETECTOR", "POSE_ESTIMATOR"}, false, true, 0, true, none},
+		{"TRACKER", "face.jpg", {}, false, false, 0, false,
+			[](api::Service&, Context& config){ config["detector"]["unit_type"] = "FACE_DETECTOR"; }},
+		{"TRACK_CACHE", "face.jpg", face, false, true, 0, true,
+			[](api::Service& service, Context& config)
+			{
+				for (const std::string unitType : {"AGE_ESTIMATOR", "GENDER_ESTIMATOR"})
+				{
+					Context estimator = service.createContext();
+					estimator["unit_type"] = unitType;
+					config["blocks"].push_back(estimator);
+				}
+			}, "stream_id"},
+	};
+}
+
+std::vector<std::string> split(const std::string& value)
+{
+	std::vector<std::string> result;
+	std::istringstream stream(value);
+	std::string item;
+	while (std::getline(stream, item, ','))
+		if (!item.empty())
+			result.push_back(item);
+	return result;
+}
+
+Resolution resolutionFromString(const std::string& name)
+{
+	if (name == "480p")
+		return {name, 640, 480};
+	if (name == "720p")
+		return {name, 1280, 720};
+	if (name == "1080p")
+		return {name, 1920, 1080};
+	if (name == "4k")
+		return {name, 3840, 2160};
+	throw std::invalid_argument("Incorrect resolution: " + name);
+}
+
+/**
+ * @brief Thread counts 1, 2, 4, ... up to max_threads
+ */
+std::vector<int> threadCounts(int maxThreads)
+{
+	std::vector<int> result;
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+		result.push_back(threads);
+	result.push_back(std::max(maxThreads, 1));
+	return result;
+}
+
+double peakRssMb()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize / (1024. * 1024.);
+	return 0;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	return usage.ru_maxrss / (1024. * 1024.);	// bytes
+#else
+	return usage.ru_maxrss / 1024.;				// kilobytes
+#endif
+#endif
+}
+
+/**
+ * @brief Put RGB image into the image Context, the data is copied
+ */
+void cvMatToBSM(Context& bsmCtx, const cv::Mat& img)
+{
+	const cv::Mat input_img = img.isContinuous() ? img : img.clone();
+	bsmCtx["format"] = "NDARRAY";
+	bsmCtx["blob"].setDataPtr(input_img.data, static_cast<int>(input_img.total() * input_img.elemSize()));
+	bsmCtx["dtype"] = "uint8_t";
+	for (int i = 0; i < input_img.dims; ++i)
+		bsmCtx["shape"].push_back(static_cast<int64_t>(input_img.size[i]));
+	bsmCtx["shape"].push_back(static_cast<int64_t>(input_img.channels()));
+}
+
+/**
+ * @brief Input of the benchmarked block for the batch size, null Context if the image has no objects
+ */
+Context prepareInput(api::Service& service, const BenchmarkCase& benchmarkCase, const Context& prepared, int batchSize)
+{
+	Context input = service.createContext();
+	if (benchmarkCase.imageBatch)
+	{
+		for (int i = 0; i < batchSize; ++i)
+		{
+			Context item = service.createContext();
+			item["image"] = prepared["image"];
+			input.push_back(item);
+		}
+		return input;
+	}
+
+	input["image"] = prepared["image"];
+	if (benchmarkCase.prerequisites.empty())
+		return input;
+
+	const Context objects = prepared["objects"];
+	if (!objects.size())
+		return service.createContext();
+
+	const size_t count = benchmarkCase.objects ? benchmarkCase.objects : static_cast<size_t>(batchSize);
+	for (size_t i = 0; i < count; ++i)
+	{
+		input["objects"].push_back(objects[static_cast<int>(i % objects.size())]);
+		if (benchmarkCase.trackIds)
+			input["objects"][static_cast<int>(i)]["track_id"] = static_cast<int64_t>(i);
+	}
+	return input;
+}
+
+double percentile(const std::vector<double>& sorted, double rank)
+{
+	if (sorted.empty())
+		return 0;
+	const size_t index = static_cast<size_t>(std::ceil(rank * sorted.size()));
+	return sorted[std::min(std::max<size_t>(index, 1), sorted.size()) - 1];
+}
+
+/**
+ * @brief Runs the block from the given number of threads, every thread processes its own copies of the input
+ * as a separate stream, latencies are measured per call
+ */
+Measurement measure(api::ProcessingBlock& block, const Context& input, const std::string& stateKey, size_t items,
+	int threads, int iterations, int warmup)
+{
+	// stateful blocks get a fresh state (stream, camera group) for every call
+	auto makeData = [&input, &stateKey](int thread, uint64_t call)
+	{
+		Context data(input);
+		if (data.isObject())
+		{
+			data["stream_id"] = "thread_" + std::to_string(thread);
+			if (!stateKey.empty())
+				data[stateKey] = "call_" + std::to_string(call);
+		}
+		return data;
+	};
+
+	for (int i = 0; i < warmup; ++i)
+	{
+		Context data = makeData(0, static_cast<uint64_t>(i));
+		block(data);
+	}
+
+	std::vector<std::vector<double>> latencies(threads);
+	std::vector<std::string> errors(threads);
+	const uint64_t firstCall = static_cast<uint64_t>(warmup);
+
+	const uint64_t allocationsBefore = allocations.load();
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		workers.emplace_back([&, t]
+		{
+			try
+			{
+				for (int i = 0; i < iterations; ++i)
+				{
+					Context data = makeData(t, firstCall + static_cast<uint64_t>(t) * iterations + i);
+
+					const auto callStart = std::chrono::steady_clock::now();
+					block(data);
+					latencies[t].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - callStart).count());
+				}
+			}
+			catch (const std::exception& e)
+			{
+				errors[t] = e.what();
+			}
+		});
+	}
+	for (auto& worker : workers)
+		worker.join();
+	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	// the input copies are included, as the callers make them too
+	const uint64_t totalAllocations = allocations.load() - allocationsBefore;
+
+	for (const auto& error : errors)
+		if (!error.empty())
+			throw std::runtime_error(error);
+
+	std::vector<double> all;
+	for (int t = 0; t < threads; ++t)
+		all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+	std::sort(all.begin(), all.end());
+
+	Measurement result;
+	result.calls = all.size();
+	for (double latency : all)
+		result.mean += latency / all.size();
+	result.p50 = percentile(all, 0.5);
+	result.p95 = percentile(all, 0.95);
+	result.p99 = percentile(all, 0.99);
+	result.throughput = wall > 0 ? all.size() * items / wall : 0;
+	result.allocations = all.empty() ? 0 : static_cast<double>(totalAllocations) / all.size();
+	result.peakRss = peakRssMb();
+	return result;
+}
+
+void printHeader()
+{
+	std::cout << std::left << std::setw(24) << "unit_type" << std::setw(8) << "res" << std::setw(7) << "batch"
+		<< std::setw(9) << "threads" << std::setw(10) << "p50, ms" << std::setw(10) << "p95, ms" << std::setw(10) << "p99, ms"
+		<< std::setw(12) << "items/s" << std::setw(10) << "allocs" << "peak RSS, MB" << std::endl;
+}
+
+void printMeasurement(const std::string& unitType, const std::string& resolution, int batchSize, int threads, const Measurement& m)
+{
+	std::cout << std::left << std::setw(24) << unitType << std::setw(8) << resolution << std::setw(7) << batchSize
+		<< std::setw(9) << threads << std::fixed << std::setprecision(2) << std::setw(10) << m.p50 << std::setw(10) << m.p95
+		<< std::setw(10) << m.p99 << std::setw(12) << m.throughput << std::setw(10) << std::setprecision(0) << m.allocations
+		<< std::setprecision(1) << m.peakRss << std::endl;
+}
+
+std::string jsonString(const std::string& value)
+{
+	std::string result = "\"";
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+			result += '\\';
+		result += c;
+	}
+	return result + "\"";
+}
+
+/**
+ * @brief Rewrites the output file with the results collected so far, so a failure of a later case keeps them
+ */
+void writeResults(const std::string& output, const std::string& sdkDir, int iterations,
+	const std::vector<std::string>& results, const std::vector<std::string>& skipped)
+{
+	std::ofstream file(output);
+	if (!file.is_open())
+		throw std::runtime_error("file " + output + " not open");
+
+	file << "{\"sdk_path\": " << jsonString(sdkDir) << ", \"iterations\": " << iterations << ", \"results\": [";
+	for (size_t i = 0; i < results.size(); ++i)
+		file << (i ? "," : "") << "\n  " << results[i];
+	file << "\n], \"skipped\": [";
+	for (size_t i = 0; i < skipped.size(); ++i)
+		file << (i ? "," : "") << "\n  " << skipped[i];
+	file << "\n]}\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::cout << "usage: " << argv[0] <<
+		" [--sdk_path ..]"
+		" [--images_path <sdk_path>/test_images]"
+		" [--units <comma separated unit types, all by default>]"
+		" [--batch_sizes 1,8,32]"
+		" [--resolutions 480p,1080p,4k]"
+		" [--threads <max number of threads>]"
+		" [--iterations 20]"
+		" [--warmup 3]"
+		" [--output sdk_benchmarks.json]"
+		<< std::endl;
+
+	ConsoleArgumentsParser parser(argc, argv);
+
+	const std::string sdk_dir = parser.get<std::string>("--sdk_path", "..");
+	const std::string images_dir = parser.get<std::string>("--images_path", sdk_dir + "/test_images");
+	const std::vector<std::string> units = split(parser.get<std::string>("--units", ""));
+	const std::vector<std::string> batchSizeNames = split(parser.get<std::string>("--batch_sizes", "1,8,32"));
+	const std::vector<std::string> resolutionNames = split(parser.get<std::string>("--resolutions", "480p,1080p,4k"));
+	const int maxThreads = parser.get<int>("--threads", std::max<int>(std::thread::hardware_concurrency(), 1));
+	const int iterations = parser.get<int>("--iterations", 20);
+	const int warmup = parser.get<int>("--warmup", 3);
+	const std::string output = parser.get<std::string>("--output", "sdk_benchmarks.json");
+
+	std::vector<int> batchSizes;
+	for (const std::string& name : batchSizeNames)
+		batchSizes.push_back(std::max(std::atoi(name.c_str()), 1));
+	std::vector<Resolution> resolutions;
+	for (const std::string& name : resolutionNames)
+		resolutions.push_back(resolutionFromString(name));
+
+	try {
+		api::Service service = api::Service::createService(sdk_dir);
+
+		std::vector<std::string> results;
+		std::vector<std::string> skipped;
+		writeResults(output, sdk_dir, iterations, results, skipped);
+
+		printHeader();
+		for (const BenchmarkCase& benchmarkCase : benchmarkCases())
+		{
+			if (!units.empty() && std::find(units.begin(), units.end(), benchmarkCase.unitType) == units.end())
+				continue;
+
+			// a case failing (e.g. its model is not shipped) is reported and the others still run
+			try {
+				Context config = service.createContext();
+				config["unit_type"] = benchmarkCase.unitType;
+				benchmarkCase.configure(service, config);
+				api::ProcessingBlock block = service.createProcessingBlock(config);
+
+				std::vector<api::ProcessingBlock> prerequisites;
+				for (const std::string& unitType : benchmarkCase.prerequisites)
+				{
+					Context prerequisiteConfig = service.createContext();
+					prerequisiteConfig["unit_type"] = unitType;
+					prerequisites.push_back(service.createProcessingBlock(prerequisiteConfig));
+				}
+
+				const cv::Mat image = cv::imread(images_dir + "/" + benchmarkCase.image, cv::IMREAD_COLOR);
+				if (image.empty())
+					throw std::runtime_error("can not read " + images_dir + "/" + benchmarkCase.image);
+
+				for (const Resolution& resolution : resolutions)
+				{
+					cv::Mat resized, rgb;
+					cv::resize(image, resized, cv::Size(resolution.width, resolution.height));
+					cv::cvtColor(resized, rgb, cv::COLOR_BGR2RGB);
+
+					Context prepared = service.createContext();
+					Context imgCtx = service.createContext();
+					cvMatToBSM(imgCtx, rgb);
+					prepared["image"] = imgCtx;
+					for (api::ProcessingBlock& prerequisite : prerequisites)
+						prerequisite(prepared);
+
+					for (int batchSize : batchSizes)
+					{
+						if (!benchmarkCase.batched && batchSize != batchSizes.front())
+							continue;
+						const int batch = benchmarkCase.batched ? batchSize : 1;
+
+						const Context input = prepareInput(service, benchmarkCase, prepared, batch);
+						if (input.isNone())
+						{
+							std::cout << benchmarkCase.unitType << ": no objects found on " << benchmarkCase.image
+								<< " at " << resolution.name << ", skipped" << std::endl;
+							break;
+						}
+						const size_t items = benchmarkCase.objects ? 1 : static_cast<size_t>(batch);
+
+						for (int threads : threadCounts(maxThreads))
+						{
+							const Measurement m = measure(block, input, benchmarkCase.stateKey, items, threads, iterations, warmup);
+							printMeasurement(benchmarkCase.unitType, resolution.name, batch, threads, m);
+
+							std::ostringstream result;
+							result << "{\"unit_type\": " << jsonString(benchmarkCase.unitType)
+								<< ", \"resolution\": " << jsonString(resolution.name) << ", \"batch_size\": " << batch
+								<< ", \"threads\": " << threads << ", \"calls\": " << m.calls
+								<< std::fixed << std::setprecision(4)
+								<< ", \"mean_ms\": " << m.mean << ", \"p50_ms\": " << m.p50 << ", \"p95_ms\": " << m.p95
+								<< ", \"p99_ms\": " << m.p99 << ", \"throughput\": " << m.throughput
+								<< ", \"allocations_per_call\": " << m.allocations << ", \"peak_rss_mb\": " << m.peakRss << "}";
+							results.push_back(result.str());
+							writeResults(output, sdk_dir, iterations, results, skipped);
+						}
+					}
+				}
+			}
+			catch (const std::exception& e) {
+				std::cout << benchmarkCase.unitType << ": skipped, " << e.what() << std::endl;
+				skipped.push_back("{\"unit_type\": " + jsonString(benchmarkCase.unitType) + ", \"error\": " + jsonString(e.what()) + "}");
+				writeResults(output, sdk_dir, iterations, results, skipped);
+			}
+		}
+
+		std::cout << "results are written to " << output << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cout << "! exception catched: '" << e.what() << "' ... exiting" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
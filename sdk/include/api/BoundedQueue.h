@@ -0,0 +1,162 @@
+#ifndef API_BOUNDED_QUEUE_H
+#define API_BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+
+namespace api
+{
+
+/**
+ * @brief Lock-free bounded multi-producer multi-consumer queue (ring of sequenced cells)
+ * 
+ * @tparam T Default constructible and move assignable item type
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+	/**
+	 * @param capacity Queue capacity, rounded up to a power of two
+	 */
+	explicit BoundedQueue(size_t capacity);
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	/**
+	 * @brief Add the item if the queue is not full
+	 * 
+	 * @return Is the item added, it is left intact otherwise
+	 */
+	bool tryPush(T& item);
+
+	/**
+	 * @brief Take the oldest item if the queue is not empty
+	 * 
+	 * @return Is an item taken
+	 */
+	bool tryPop(T& item);
+
+	/**
+	 * @brief Approximate number of the queued items
+	 */
+	size_t size() const;
+
+	size_t capacity() const { return cells.size(); }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	std::vector<Cell> cells;
+	const size_t mask;
+	// producers and consumers positions are kept on separate cache lines
+	char tailPadding[64];
+	std::atomic<size_t> tail;
+	char headPadding[64];
+	std::atomic<size_t> head;
+};
+
+
+namespace detail
+{
+
+inline size_t roundUpToPowerOfTwo(size_t value)
+{
+	if (!value)
+		throw std::invalid_argument("queue capacity must be positive");
+	size_t result = 1;
+	while (result < value)
+		result <<= 1;
+	return result;
+}
+
+}
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity) :
+	cells(detail::roundUpToPowerOfTwo(capacity)),
+	mask(cells.size() - 1),
+	tail(0),
+	head(0)
+{
+	for (size_t i = 0; i < cells.size(); ++i)
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool BoundedQueue<T>::tryPush(T& item)
+{
+	size_t position = tail.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Cell& cell = cells[position & mask];
+		const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+		if (difference == 0)
+		{
+			if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				cell.value = std::move(item);
+				cell.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			return false;	// full
+		}
+		else
+		{
+			position = tail.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template <typename T>
+bool BoundedQueue<T>::tryPop(T& item)
+{
+	size_t position = head.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Cell& cell = cells[position & mask];
+		const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+		if (difference == 0)
+		{
+			if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				item = std::move(cell.value);
+				cell.sequence.store(position + mask + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			return false;	// empty
+		}
+		else
+		{
+			position = head.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template <typename T>
+size_t BoundedQueue<T>::size() const
+{
+	const size_t h = head.load(std::memory_order_relaxed);
+	const size_t t = tail.load(std::memory_order_relaxed);
+	return t > h ? t - h : 0;
+}
+
+}
+
+#endif // API_BOUNDED_QUEUE_H
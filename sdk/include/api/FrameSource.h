@@ -0,0 +1,96 @@
+#ifndef API_FRAME_SOURCE_H
+#define API_FRAME_SOURCE_H
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <api/Pipeline.h>
+
+
+namespace api
+{
+
+/**
+ * @brief Frames from an image file or the images of a folder in name order, for testing the pipelines.
+ * Requires OpenCV, as the samples do.
+ * 
+ * Frame data: "image" (RGB), "frame" - index, "timestamp_ms" - index / fps, "stream_id", "source_path"
+ */
+class ImageFolderSource : public FrameSource
+{
+public:
+	/**
+	 * @param path Image file or folder
+	 * @param fps Frame rate of the timestamps
+	 * @param loops Number of passes over the images, 0 - endless
+	 * @param streamId Stream id of the frames
+	 */
+	explicit ImageFolderSource(const std::string& path, double fps = 25, size_t loops = 1, const std::string& streamId = "default");
+
+	virtual bool read(Context& frame) override;
+
+private:
+	std::vector<cv::String> paths;
+	const double fps;
+	const size_t loops;
+	const std::string streamId;
+	size_t index = 0;
+};
+
+
+inline ImageFolderSource::ImageFolderSource(const std::string& path, double fps, size_t loops, const std::string& streamId) :
+	fps(fps),
+	loops(loops),
+	streamId(streamId)
+{
+	std::vector<cv::String> files;
+	cv::glob(path, files, false);
+	for (const cv::String& file : files)
+	{
+		std::string extension = file.substr(std::min(file.rfind('.'), file.size()));
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".bmp")
+			paths.push_back(file);
+	}
+	std::sort(paths.begin(), paths.end());
+	if (paths.empty())
+		throw std::invalid_argument("no images found at " + path);
+}
+
+inline bool ImageFolderSource::read(Context& frame)
+{
+	if (loops && index >= paths.size() * loops)
+		return false;
+
+	const cv::String& path = paths[index % paths.size()];
+	cv::Mat image = cv::imread(path, cv::IMREAD_COLOR);
+	if (image.empty())
+		throw std::runtime_error("failed to read " + path);
+	cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
+
+	// the frame outlives the image, so the pixels are copied
+	frame["image"]["format"] = "NDARRAY";
+	frame["image"]["blob"].setDataPtr(image.data, static_cast<int>(image.total() * image.elemSize()));
+	frame["image"]["dtype"] = "uint8_t";
+	frame["image"]["shape"].push_back(static_cast<int64_t>(image.rows));
+	frame["image"]["shape"].push_back(static_cast<int64_t>(image.cols));
+	frame["image"]["shape"].push_back(static_cast<int64_t>(image.channels()));
+
+	frame["frame"] = static_cast<int64_t>(index);
+	frame["timestamp_ms"] = index * 1000. / fps;
+	frame["stream_id"] = streamId;
+	frame["source_path"] = std::string(path);
+	++index;
+	return true;
+}
+
+}
+
+#endif // API_FRAME_SOURCE_H
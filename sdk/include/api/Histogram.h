@@ -0,0 +1,121 @@
+#ifndef API_HISTOGRAM_H
+#define API_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace api
+{
+
+/**
+ * @brief Lock-free log-linear (HDR style) histogram of non-negative integers, e.g. latencies in microseconds:
+ * values below 8 are exact, larger ones fall into 8 buckets per power of two, i.e. within 12.5%.
+ * Used by the Pipeline statistics and the SDK metrics.
+ */
+class Histogram
+{
+public:
+	static const size_t SUB_BUCKETS = 8;
+	static const size_t BUCKETS = SUB_BUCKETS * 62;
+
+	void record(uint64_t value);
+
+	uint64_t getCount() const { return count.load(std::memory_order_relaxed); }
+	uint64_t getSum() const { return sum.load(std::memory_order_relaxed); }
+	uint64_t getMax() const { return max.load(std::memory_order_relaxed); }
+
+	/**
+	 * @return Upper bound of the bucket holding the given quantile, at most the max value
+	 */
+	uint64_t quantile(double q) const;
+
+	/**
+	 * @return Number of values not greater than the bound (approximated by bucket upper bounds)
+	 */
+	uint64_t countBelow(uint64_t bound) const;
+
+	static size_t bucketIndex(uint64_t value);
+	static uint64_t bucketUpperBound(size_t index);
+
+private:
+	static size_t highestBit(uint64_t value);
+
+	std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+	std::atomic<uint64_t> count{0};
+	std::atomic<uint64_t> sum{0};
+	std::atomic<uint64_t> max{0};
+};
+
+
+inline size_t Histogram::highestBit(uint64_t value)
+{
+#if defined(__GNUC__)
+	return 63 - __builtin_clzll(value);
+#else
+	size_t result = 0;
+	while (value >>= 1)
+		++result;
+	return result;
+#endif
+}
+
+inline size_t Histogram::bucketIndex(uint64_t value)
+{
+	if (value < SUB_BUCKETS)
+		return static_cast<size_t>(value);
+	const size_t exponent = highestBit(value);	// >= 3
+	const size_t sub = static_cast<size_t>(value >> (exponent - 3)) & (SUB_BUCKETS - 1);
+	return std::min(SUB_BUCKETS + (exponent - 3) * SUB_BUCKETS + sub, BUCKETS - 1);
+}
+
+inline uint64_t Histogram::bucketUpperBound(size_t index)
+{
+	if (index < SUB_BUCKETS)
+		return index;
+	const size_t exponent = (index - SUB_BUCKETS) / SUB_BUCKETS + 3;
+	const uint64_t sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+	return ((SUB_BUCKETS + sub + 1) << (exponent - 3)) - 1;
+}
+
+inline void Histogram::record(uint64_t value)
+{
+	buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(value, std::memory_order_relaxed);
+	uint64_t current = max.load(std::memory_order_relaxed);
+	while (current < value && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		;
+}
+
+inline uint64_t Histogram::quantile(double q) const
+{
+	const uint64_t total = getCount();
+	if (!total)
+		return 0;
+
+	const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(q * total + 0.5), 1);
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < BUCKETS; ++i)
+	{
+		cumulative += buckets[i].load(std::memory_order_relaxed);
+		if (cumulative >= rank)
+			return std::min(bucketUpperBound(i), getMax());
+	}
+	return getMax();
+}
+
+inline uint64_t Histogram::countBelow(uint64_t bound) const
+{
+	uint64_t result = 0;
+	for (size_t i = 0; i < BUCKETS && bucketUpperBound(i) <= bound; ++i)
+		result += buckets[i].load(std::memory_order_relaxed);
+	return result;
+}
+
+}
+
+#endif // API_HISTOGRAM_H
@@ -0,0 +1,448 @@
+#ifndef API_PIPELINE_H
+#define API_PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <api/BoundedQueue.h>
+#include <api/Context.h>
+#include <api/Histogram.h>
+#include <api/Service.h>
+
+
+namespace api
+{
+
+/**
+ * @brief Behaviour of a full stage queue
+ */
+enum class Backpressure
+{
+	BLOCK,			///< the producer waits
+	DROP_OLDEST,	///< the oldest queued frame is dropped, latency stays bounded
+	DROP_NEWEST		///< the incoming frame is dropped
+};
+
+/**
+ * @brief Source of the frames fed to Pipeline::run
+ */
+class FrameSource
+{
+public:
+	virtual ~FrameSource() = default;
+
+	/**
+	 * @brief Fill the next frame data (e.g. "image")
+	 * 
+	 * @return False at the end of the source
+	 */
+	virtual bool read(Context& frame) = 0;
+};
+
+/**
+ * @brief Streaming pipeline: every stage (e.g. detector, tracker, recognizer) runs on its own threads
+ * and takes the frames from a bounded lock-free queue, the processed frames are passed to the sink.
+ * With a single thread per stage the frames keep their order.
+ */
+class Pipeline
+{
+public:
+	using Stage = std::function<void(Context&)>;
+
+	/**
+	 * @param service Service creating the frame and statistics contexts
+	 * @param queueSize Capacity of every stage queue
+	 * @param backpressure Behaviour of a full queue
+	 */
+	explicit Pipeline(const Service& service, size_t queueSize = 4, Backpressure backpressure = Backpressure::BLOCK);
+
+	Pipeline(const Pipeline&) = delete;
+	Pipeline& operator=(const Pipeline&) = delete;
+
+	/**
+	 * @brief Waits for the queued frames, see finish
+	 */
+	~Pipeline();
+
+	/**
+	 * @brief Append a stage, must be called before the first frame
+	 * 
+	 * @param name Stage name in the statistics
+	 * @param stage Function processing a frame, e.g. calling a ProcessingBlock
+	 * @param threads Number of the stage threads
+	 */
+	Pipeline& addStage(const std::string& name, Stage stage, size_t threads = 1);
+
+	/**
+	 * @brief Set the function receiving the processed frames, called on the last stage threads.
+	 * Sink errors are counted like the stage ones, the stream goes on
+	 */
+	Pipeline& setSink(Stage sink);
+
+	/**
+	 * @brief Queue the frame to the first stage, starts the stage threads on the first call
+	 * 
+	 * @return False if the frame is dropped (DROP_NEWEST backpressure)
+	 */
+	bool push(Context&& frame);
+
+	/**
+	 * @brief Push the frames of the source until its end and wait for them to be processed
+	 */
+	void run(FrameSource& source);
+
+	/**
+	 * @brief Process the queued frames and stop the stage threads, no frames can be pushed afterwards
+	 */
+	void finish();
+
+	/**
+	 * @brief Counters of the pipeline
+	 * 
+	 * @return {"stages": [{"name", "queue_depth", "max_queue_depth", "processed", "dropped", "errors", "last_error",
+	 * "wait_ms", "latency_ms"}], "delivered", "sink_errors", "sink_last_error", "end_to_end_ms"}, where *_ms are {"count", "mean", "max", "p50", "p95", "p99"}
+	 */
+	Context getStatistics() const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Frame
+	{
+		explicit Frame(Context&& data) : data(std::move(data)), created(Clock::now()) {}
+
+		Context data;
+		Clock::time_point created;
+		Clock::time_point enqueued;
+	};
+
+	using Queue = BoundedQueue<std::unique_ptr<Frame>>;
+
+	struct StageState
+	{
+		StageState(const std::string& name, Stage function, size_t threads, size_t queueSize) :
+			name(name), function(std::move(function)), threads(threads), queue(queueSize) {}
+
+		const std::string name;
+		const Stage function;
+		const size_t threads;
+		Queue queue;
+		std::atomic<bool> closed{false};
+		std::atomic<size_t> running{0};
+		std::atomic<uint64_t> processed{0};
+		std::atomic<uint64_t> dropped{0};
+		std::atomic<uint64_t> errors{0};
+		std::atomic<uint64_t> maxDepth{0};
+		Histogram wait;
+		Histogram latency;
+		mutable std::mutex errorMutex;
+		std::string lastError;
+	};
+
+	// durations are recorded in microseconds
+	static void record(Histogram& histogram, Clock::duration duration);
+	Context toContext(const Histogram& histogram) const;
+	void countError(StageState& stage, const std::string& error);
+	void countSinkError(const std::string& error);
+
+	bool enqueue(StageState& stage, std::unique_ptr<Frame>& frame);
+	void deliver(std::unique_ptr<Frame>& frame);
+	void work(size_t index);
+	void start();
+
+	static void backoff(unsigned& attempt);
+
+	const Service service;
+	const size_t queueSize;
+	const Backpressure backpressure;
+	std::vector<std::unique_ptr<StageState>> stages;
+	Stage sink;
+	Histogram endToEnd;
+	std::atomic<uint64_t> delivered{0};
+	std::atomic<uint64_t> sinkErrors{0};
+	mutable std::mutex sinkErrorMutex;
+	std::string sinkLastError;
+	std::vector<std::thread> threads;
+	std::atomic<bool> started{false};
+	std::atomic<bool> finished{false};
+};
+
+
+inline void Pipeline::record(Histogram& histogram, Clock::duration duration)
+{
+	histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+
+inline Context Pipeline::toContext(const Histogram& histogram) const
+{
+	Context ctx = service.createContext();
+	const uint64_t total = histogram.getCount();
+	ctx["count"] = static_cast<int64_t>(total);
+	ctx["mean"] = total ? histogram.getSum() / 1000. / total : 0.;
+	ctx["max"] = histogram.getMax() / 1000.;
+	const std::pair<const char*, double> percentiles[] = {{"p50", 0.5}, {"p95", 0.95}, {"p99", 0.99}};
+	for (const auto& percentile : percentiles)
+		ctx[percentile.first] = histogram.quantile(percentile.second) / 1000.;
+	return ctx;
+}
+
+inline void Pipeline::countError(StageState& stage, const std::string& error)
+{
+	stage.errors.fetch_add(1, std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(stage.errorMutex);
+	stage.lastError = error;
+}
+
+inline void Pipeline::countSinkError(const std::string& error)
+{
+	sinkErrors.fetch_add(1, std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(sinkErrorMutex);
+	sinkLastError = error;
+}
+
+inline Pipeline::Pipeline(const Service& service, size_t queueSize, Backpressure backpressure) :
+	service(service),
+	queueSize(queueSize),
+	backpressure(backpressure)
+{}
+
+inline Pipeline::~Pipeline()
+{
+	try
+	{
+		finish();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+	}
+}
+
+inline Pipeline& Pipeline::addStage(const std::string& name, Stage stage, size_t threads)
+{
+	if (started)
+		throw std::logic_error("pipeline stages must be added before the first frame");
+	if (!threads)
+		throw std::invalid_argument("stage needs at least one thread");
+	stages.emplace_back(new StageState(name, std::move(stage), threads, queueSize));
+	return *this;
+}
+
+inline Pipeline& Pipeline::setSink(Stage sink)
+{
+	if (started)
+		throw std::logic_error("pipeline sink must be set before the first frame");
+	this->sink = std::move(sink);
+	return *this;
+}
+
+inline void Pipeline::start()
+{
+	if (stages.empty())
+		throw std::logic_error("pipeline has no stages");
+	started = true;
+	for (size_t i = 0; i < stages.size(); ++i)
+	{
+		stages[i]->running = stages[i]->threads;
+		for (size_t t = 0; t < stages[i]->threads; ++t)
+			threads.emplace_back(&Pipeline::work, this, i);
+	}
+}
+
+inline void Pipeline::backoff(unsigned& attempt)
+{
+	// spin shortly, then give the core away
+	if (++attempt < 64)
+		std::this_thread::yield();
+	else
+		std::this_thread::sleep_for(std::chrono::microseconds(std::min(50u << std::min(attempt / 64, 4u), 1000u)));
+}
+
+inline bool Pipeline::enqueue(StageState& stage, std::unique_ptr<Frame>& frame)
+{
+	frame->enqueued = Clock::now();
+	unsigned attempt = 0;
+	while (!stage.queue.tryPush(frame))
+	{
+		if (backpressure == Backpressure::DROP_NEWEST)
+		{
+			stage.dropped.fetch_add(1, std::memory_order_relaxed);
+			frame.reset();
+			return false;
+		}
+		if (backpressure == Backpressure::DROP_OLDEST)
+		{
+			std::unique_ptr<Frame> oldest;
+			if (stage.queue.tryPop(oldest))
+				stage.dropped.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		backoff(attempt);
+	}
+
+	const uint64_t depth = stage.queue.size();
+	uint64_t max = stage.maxDepth.load(std::memory_order_relaxed);
+	while (max < depth && !stage.maxDepth.compare_exchange_weak(max, depth, std::memory_order_relaxed));
+	return true;
+}
+
+inline void Pipeline::deliver(std::unique_ptr<Frame>& frame)
+{
+	if (sink)
+	{
+		try
+		{
+			sink(frame->data);
+		}
+		catch (const std::exception& e)
+		{
+			countSinkError(e.what());
+			return;
+		}
+		catch (...)
+		{
+			countSinkError("unknown exception");
+			return;
+		}
+	}
+	record(endToEnd, Clock::now() - frame->created);
+	delivered.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void Pipeline::work(size_t index)
+{
+	StageState& stage = *stages[index];
+	StageState* next = index + 1 < stages.size() ? stages[index + 1].get() : nullptr;
+
+	std::unique_ptr<Frame> frame;
+	unsigned attempt = 0;
+	for (;;)
+	{
+		if (!stage.queue.tryPop(frame))
+		{
+			// the queue is closed after the last push, so it is empty for good
+			if (stage.closed.load(std::memory_order_acquire) && !stage.queue.tryPop(frame))
+				break;
+			if (!frame)
+			{
+				backoff(attempt);
+				continue;
+			}
+		}
+		attempt = 0;
+
+		const Clock::time_point begin = Clock::now();
+		record(stage.wait, begin - frame->enqueued);
+		try
+		{
+			stage.function(frame->data);
+		}
+		catch (const std::exception& e)
+		{
+			// the frame is dropped, the stream goes on
+			countError(stage, e.what());
+			frame.reset();
+			continue;
+		}
+		catch (...)
+		{
+			countError(stage, "unknown exception");
+			frame.reset();
+			continue;
+		}
+		record(stage.latency, Clock::now() - begin);
+		stage.processed.fetch_add(1, std::memory_order_relaxed);
+
+		if (next)
+			enqueue(*next, frame);
+		else
+			deliver(frame);
+		frame.reset();
+	}
+
+	// the last thread of the stage closes the next queue
+	if (stage.running.fetch_sub(1) == 1 && next)
+		next->closed.store(true, std::memory_order_release);
+}
+
+inline bool Pipeline::push(Context&& frame)
+{
+	if (finished)
+		throw std::logic_error("pipeline is finished");
+	if (!started)
+		start();
+	std::unique_ptr<Frame> item(new Frame(std::move(frame)));
+	return enqueue(*stages.front(), item);
+}
+
+inline void Pipeline::run(FrameSource& source)
+{
+	for (;;)
+	{
+		Context frame = service.createContext();
+		if (!source.read(frame))
+			break;
+		push(std::move(frame));
+	}
+	finish();
+}
+
+inline void Pipeline::finish()
+{
+	if (finished.exchange(true))
+		return;
+	if (!started)
+		return;
+	stages.front()->closed.store(true, std::memory_order_release);
+	for (std::thread& thread : threads)
+		thread.join();
+	threads.clear();
+}
+
+inline Context Pipeline::getStatistics() const
+{
+	Context statistics = service.createContext();
+	Context stagesCtx = service.createContext();
+	for (const auto& stage : stages)
+	{
+		Context stageCtx = service.createContext();
+		stageCtx["name"] = stage->name;
+		stageCtx["queue_depth"] = static_cast<int64_t>(stage->queue.size());
+		stageCtx["max_queue_depth"] = static_cast<int64_t>(stage->maxDepth.load(std::memory_order_relaxed));
+		stageCtx["processed"] = static_cast<int64_t>(stage->processed.load(std::memory_order_relaxed));
+		stageCtx["dropped"] = static_cast<int64_t>(stage->dropped.load(std::memory_order_relaxed));
+		stageCtx["errors"] = static_cast<int64_t>(stage->errors.load(std::memory_order_relaxed));
+		{
+			std::lock_guard<std::mutex> lock(stage->errorMutex);
+			stageCtx["last_error"] = stage->lastError;
+		}
+		stageCtx["wait_ms"] = toContext(stage->wait);
+		stageCtx["latency_ms"] = toContext(stage->latency);
+		stagesCtx.push_back(std::move(stageCtx));
+	}
+	statistics["stages"] = std::move(stagesCtx);
+	statistics["delivered"] = static_cast<int64_t>(delivered.load(std::memory_order_relaxed));
+	statistics["sink_errors"] = static_cast<int64_t>(sinkErrors.load(std::memory_order_relaxed));
+	{
+		std::lock_guard<std::mutex> lock(sinkErrorMutex);
+		statistics["sink_last_error"] = sinkLastError;
+	}
+	statistics["end_to_end_ms"] = toContext(endToEnd);
+	return statistics;
+}
+
+}
+
+#endif // API_PIPELINE_H
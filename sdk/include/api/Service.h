@@ -28,7 +28,7 @@ public:
 	 * 
 	 * @return Context 
 	 */
-	Context createContext();
+	Context createContext() const;
 	
 	/**
 	 * @brief Create a Service object
@@ -38,6 +38,48 @@ public:
 	 */
 	static Service createService(std::string path_to_dir);
 
+	/**
+	 * @brief Start recording of the processing timeline: blocks, their stages, per object loops and C API calls
+	 * 
+	 * @param eventsPerThread Number of the last spans kept for every thread
+	 */
+	static void startTrace(uint64_t eventsPerThread = 65536);
+
+	/**
+	 * @brief Stop recording of the processing timeline, the recorded spans are kept for dumpTrace
+	 * 
+	 */
+	static void stopTrace();
+
+	/**
+	 * @brief Write the recorded timeline in Chrome trace format (chrome://tracing, ui.perfetto.dev)
+	 * 
+	 * @param path Path to json file
+	 */
+	static void dumpTrace(const std::string& path);
+
+	/**
+	 * @brief End the onnxruntime profiling of the live blocks created with "enable_trace",
+	 * their model events are added to the following dumpTrace. The profiling is not resumed,
+	 * must not be called while the blocks are processing
+	 */
+	static void endModelProfiling();
+
+	/**
+	 * @brief Get the snapshot of the processing metrics: calls, frames, objects, inferences, batch sizes,
+	 * latency percentiles of the blocks and their stages, error counts by codes
+	 * 
+	 * @return Context 
+	 */
+	static Context getMetrics();
+
+	/**
+	 * @brief Get the processing metrics in Prometheus text exposition format
+	 * 
+	 * @return std::string 
+	 */
+	static std::string getMetricsPrometheus();
+
 private:
 	Service(std::string path_to_dir):path_to_dir(path_to_dir){}
 	std::string path_to_dir;
@@ -55,7 +97,54 @@ inline Service Service::createService(std::string path_to_dir)
 }
 
 
-inline Context Service::createContext() {
+inline void Service::startTrace(uint64_t eventsPerThread)
+{
+	ContextEH* out_exception = nullptr;
+	TDVTrace_start(eventsPerThread, &out_exception);
+	checkException(out_exception);
+}
+
+inline void Service::stopTrace()
+{
+	ContextEH* out_exception = nullptr;
+	TDVTrace_stop(&out_exception);
+	checkException(out_exception);
+}
+
+inline void Service::dumpTrace(const std::string& path)
+{
+	ContextEH* out_exception = nullptr;
+	TDVTrace_dump(path.c_str(), &out_exception);
+	checkException(out_exception);
+}
+
+inline void Service::endModelProfiling()
+{
+	ContextEH* out_exception = nullptr;
+	TDVTrace_endModelProfiling(&out_exception);
+	checkException(out_exception);
+}
+
+inline Context Service::getMetrics()
+{
+	Context result;
+	ContextEH* out_exception = nullptr;
+	TDVMetrics_snapshot(result.getHandle(), &out_exception);
+	checkException(out_exception);
+	return result;
+}
+
+inline std::string Service::getMetricsPrometheus()
+{
+	ContextEH* out_exception = nullptr;
+	char* text = TDVMetrics_prometheus(&out_exception);
+	checkException(out_exception);
+	std::string result(text);
+	TDVContext_freePtr(text);
+	return result;
+}
+
+inline Context Service::createContext() const {
 	return Context();
 }
 
@@ -69,6 +69,13 @@ TDV_PUBLIC HPBlock* TDVProcessingBlock_createProcessingBlock(const HContext * co
 TDV_PUBLIC void TDVProcessingBlock_destroyBlock(HPBlock * handle_, ContextEH ** eh);
 TDV_PUBLIC void TDVProcessingBlock_processContext(HPBlock * handle_, HContext * config, ContextEH ** eh);
 
+TDV_PUBLIC void TDVTrace_start(uint64_t eventsPerThread, ContextEH ** eh);
+TDV_PUBLIC void TDVTrace_stop(ContextEH ** eh);
+TDV_PUBLIC void TDVTrace_dump(const char* path, ContextEH ** eh);
+TDV_PUBLIC void TDVTrace_endModelProfiling(ContextEH ** eh);
+TDV_PUBLIC void TDVMetrics_snapshot(HContext * ctx, ContextEH ** eh);
+TDV_PUBLIC char* TDVMetrics_prometheus(ContextEH ** eh);
+
 TDV_PUBLIC const char* TDVException_getMessage(ContextEH * eh);
 TDV_PUBLIC unsigned int TDVException_getErrorCode(ContextEH * eh);
 TDV_PUBLIC void TDVException_deleteException(ContextEH * eh);
@@ -1,6 +1,9 @@
 #ifndef TDV_DATA_CONTEXT_V2_CONTEXTUTILS_H_
 #define TDV_DATA_CONTEXT_V2_CONTEXTUTILS_H_
 
+#include <functional>
+#include <string>
+
 #include <opencv2/core/mat.hpp>
 
 #include <tdv/data/Context.h>
@@ -12,9 +15,29 @@ namespace data
 {
 
 void keypointsBasedCrop(cv::Mat& image, const Context& data);
+// view of the bbox of data["objects"][data["objects@current_id"]] clipped to the image
+void simpleCrop(cv::Mat& image, const Context& data);
 void cvMatToBsm(Context& bsmCtx, const cv::Mat& img, bool copy=false);
 cv::Mat bsmToCvMat(const Context& bsmCtx, bool copy=false);
 
+// Crop of the object data["objects"][data["objects@current_id"]] cached in data["@crop_cache"]
+// under "<object id>:<crop type>:<width>x<height>", so blocks using the same crop of an object
+// compute it once per frame, also when the blocks are called one by one on the same frame.
+// On a miss makeCrop gets data["image"] (must not modify it) and returns the crop.
+// The cache is dropped when data["image"] is replaced, an entry - when the object bbox or the named points
+// of its keypoints (left_eye, right_eye, mouth) change.
+// The returned crop shares the cached buffer and must not be modified in place.
+cv::Mat cachedCrop(Context& data, const std::string& cropType, const cv::Size& size,
+	const std::function<cv::Mat(const cv::Mat&)>& makeCrop);
+
+// Frame of the image, the object ids and their cached crops without the bbox and keypoints they were made of:
+// blocks take the crops from its cache as hits, so it is cheap to copy for every block of a frame run concurrently.
+// The crops of data must be cached beforehand, the objects of the frame are in the order of data["objects"]
+Context cachedCropsFrame(const Context& data);
+
+// Removes the crop cache of the frame (or of every frame of an array), e.g. before it is serialized
+void dropCropCache(Context& data);
+
 } // namespace utils
 } // namespace tdv
 
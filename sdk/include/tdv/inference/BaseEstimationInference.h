@@ -8,6 +8,7 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <tdv/data/ContextUtils.h>
+#include <tdv/modules/BaseEstimationModule.h>
 #include <tdv/modules/ONNXModule.h>
 #include <tdv/utils/rassert/RAssert.h>
 
@@ -15,11 +16,6 @@
 #undef min
 
 namespace{
-template <typename T>
-T clip(const T& n, const T& lower, const T& upper) {
-	return std::max(lower, std::min(n, upper));
-}
-
 void parseRoiBoxFromBboxAndGetCrop(cv::Mat &image, tdv::data::Context &data){
 	tdv::data::Context& obj = data["objects"][data["objects@current_id"].get<int>()];
 	tdv::data::Context& rectCtx = obj["bbox"];
@@ -74,15 +70,6 @@ void parseRoiBoxFromBboxAndGetCrop(cv::Mat &image, tdv::data::Context &data){
 	image = std::move(res);
 }
 
-void getSimpleCrop(cv::Mat &image, const tdv::data::Context &data){
-	const tdv::data::Context& obj = data["objects"][data["objects@current_id"].get<int>()];
-
-	const tdv::data::Context& rectCtx = obj["bbox"];
-	cv::Point bbox_top_left = {clip(static_cast<int>(rectCtx[0].get<double>() * image.cols), 0, image.cols), clip(static_cast<int>(rectCtx[1].get<double>() * image.rows), 0 , image.rows)}; //TODO add border of image
-	cv::Point bbox_bottom_right = {clip(static_cast<int>(rectCtx[2].get<double>() * image.cols), 0, image.cols), clip(static_cast<int>(rectCtx[3].get<double>() * image.rows), 0 , image.rows)}; //TODO add border of image
-	image = image(cv::Rect(bbox_top_left,bbox_bottom_right));
-}
-
 }
 
 namespace tdv {
@@ -98,10 +85,11 @@ enum TypeCrop
 
 
 template <typename Impl, TypeCrop typeCrop = SIMPLE_CROP>
-class BaseEstimationInference : public ONNXModule<Impl>
+class BaseEstimationInference : public ONNXModule<Impl>, public CropPreprocessor
 {
 public:
 	BaseEstimationInference(const tdv::data::Context& config);
+	virtual void cacheCrops(tdv::data::Context& data) override;
 private:
 	friend class ONNXModule<Impl>;
 	void virtual preprocess(tdv::data::Context& data) override;
@@ -116,25 +104,72 @@ protected:
 
 	int nchannel_index = 1;
 	int input_size_index = 2;
+
+	// number of rows of the current batch
+	size_t batchRows(const tdv::data::Context& data) const;
+	// index of the object of the batch row in data["objects"]
+	int batchObject(const tdv::data::Context& data, size_t row) const;
+
+private:
+	static const char* cropTypeName();
+	// crop of data["objects"][data["objects@current_id"]] (or the whole image without objects) resized to the model input
+	cv::Mat makeCrop(const cv::Mat& input, tdv::data::Context& data) const;
+	cv::Mat getCrop(tdv::data::Context& data) const;
+
+	// reuse crops of other estimators, see tdv::data::cachedCrop
+	const bool useCropCache;
 };
 
 
 template <typename Impl, TypeCrop typeCrop>
 BaseEstimationInference<Impl, typeCrop>::BaseEstimationInference(const tdv::data::Context& config):
-	ONNXModule<Impl>(config)
+	ONNXModule<Impl>(config),
+	useCropCache(config.get<bool>("use_crop_cache", true))
 {
 	module_version_ = config.get<int64_t>("model_version", 1);
+
+	// uint8 models take NHWC images
+	if (this->isUint8Input())
+	{
+		nchannel_index = 3;
+		input_size_index = 1;
+	}
 }
 
 template <typename Impl, TypeCrop typeCrop>
-void BaseEstimationInference<Impl, typeCrop>::preprocess(tdv::data::Context& data) {
+const char* BaseEstimationInference<Impl, typeCrop>::cropTypeName() {
+	switch (typeCrop)
+	{
+	case KEYPOINTS_BASED_CROP:
+		return "keypoints";
+	case FDA_ROI_CROP:
+		return "fda_roi";
+	default:
+		return "simple";
+	}
+}
+
+template <typename Impl, TypeCrop typeCrop>
+size_t BaseEstimationInference<Impl, typeCrop>::batchRows(const tdv::data::Context& data) const {
+	return data.at("objects@input")[0].get<size_t>("batch_size", 1);
+}
+
+template <typename Impl, TypeCrop typeCrop>
+int BaseEstimationInference<Impl, typeCrop>::batchObject(const tdv::data::Context& data, size_t row) const {
+	if (data.contains("objects@current_id"))
+		return data.at("objects@current_id").get<int>();
+	return static_cast<int>(data.at("objects@offset").get<int64_t>() - batchRows(data) + row);
+}
 
-	Context& firstInput = data["image"];
-	cv::Mat image = tdv::data::bsmToCvMat(firstInput, true);
+template <typename Impl, TypeCrop typeCrop>
+cv::Mat BaseEstimationInference<Impl, typeCrop>::makeCrop(const cv::Mat& input, tdv::data::Context& data) const {
+	const auto& INPUT_SIZE = this->getInputShapes().front()[input_size_index];
 
+	// crops below are views or copies, the input image is not modified
+	cv::Mat image = input;
 	if (data.contains("objects")){
 		if (typeCrop == SIMPLE_CROP){
-			getSimpleCrop(image, data);
+			tdv::data::simpleCrop(image, data);
 		}else if(typeCrop == KEYPOINTS_BASED_CROP){
 			tdv::data::keypointsBasedCrop(image, data);
 		}else if (typeCrop == FDA_ROI_CROP){
@@ -144,23 +179,96 @@ void BaseEstimationInference<Impl, typeCrop>::preprocess(tdv::data::Context& dat
 
 	RHAssert2(0x7a11d233,  image.depth() == CV_8U ||  image.depth() == CV_32F, "only 8U and 32F image types are suported");
 
+	cv::Mat resized;
+	cv::resize(image, resized, cv::Size(INPUT_SIZE, INPUT_SIZE), 0, 0);
+	return resized;
+}
+
+template <typename Impl, TypeCrop typeCrop>
+cv::Mat BaseEstimationInference<Impl, typeCrop>::getCrop(tdv::data::Context& data) const {
+	if (!useCropCache || !data.contains("objects"))
+		return makeCrop(tdv::data::bsmToCvMat(data["image"]), data);
+
+	const auto& INPUT_SIZE = this->getInputShapes().front()[input_size_index];
+	return tdv::data::cachedCrop(data, cropTypeName(), cv::Size(INPUT_SIZE, INPUT_SIZE),
+		[this, &data](const cv::Mat& input) { return makeCrop(input, data); });
+}
+
+template <typename Impl, TypeCrop typeCrop>
+void BaseEstimationInference<Impl, typeCrop>::cacheCrops(tdv::data::Context& data) {
+	if (!useCropCache || !data.contains("objects"))
+		return;
+
+	for (size_t i = 0; i < data["objects"].size(); ++i)
+	{
+		data["objects@current_id"] = static_cast<int>(i);
+		getCrop(data);
+	}
+	data.erase("objects@current_id");
+}
+
+// Processes data["objects"][data["objects@current_id"]], or all objects if the current one is not set:
+// as one batch if the model has a dynamic batch dimension, one by one otherwise ("objects@offset" is the cursor)
+template <typename Impl, TypeCrop typeCrop>
+void BaseEstimationInference<Impl, typeCrop>::preprocess(tdv::data::Context& data) {
+
 	const auto& shape = this->getInputShapes();
 	const auto& INPUT_SIZE = shape.front()[input_size_index];
 	const auto& N_CHANNEL = shape.front()[nchannel_index];
 
-	cv::resize(image, image, cv::Size(INPUT_SIZE, INPUT_SIZE), 0, 0);
+	const bool batchObjects = data.contains("objects") && !data.contains("objects@current_id");
+	int64_t first = 0;
+	int64_t batchSize = 1;
+	if (batchObjects)
+	{
+		first = data.get<int64_t>("objects@offset", 0);
+		const int64_t count = static_cast<int64_t>(data["objects"].size()) - first;
+		batchSize = this->getDynamicBatchEnabled().front() ? count : std::min<int64_t>(count, 1);
+		if (batchSize <= 0)
+			return;
+	}
 
-	size_t sizeInBytes = INPUT_SIZE * INPUT_SIZE * N_CHANNEL * sizeof(float);
-	unsigned char* input_ptr = static_cast<unsigned char*>(malloc(sizeInBytes));
+	const bool uint8Input = this->isUint8Input();
+	size_t sizeInBytes = INPUT_SIZE * INPUT_SIZE * N_CHANNEL * (uint8Input ? sizeof(uint8_t) : sizeof(float));
+	unsigned char* input_ptr = static_cast<unsigned char*>(malloc(sizeInBytes * batchSize));
 
 	if(!input_ptr)
 		throw std::bad_alloc();
-	cv::Mat img_blob = blobFromImage(image, N_CHANNEL);
+	std::shared_ptr<unsigned char> input(input_ptr, [](unsigned char* ptr){ free(ptr);});
+
+	for (int64_t i = 0; i < batchSize; ++i)
+	{
+		// crop functions take the object from "objects@current_id"
+		if (batchObjects)
+			data["objects@current_id"] = static_cast<int>(first + i);
+
+		// blobFromImage only reassigns the image, so the cached crop can be passed to it
+		cv::Mat image = getCrop(data);
+
+		if (uint8Input)
+		{
+			// the normalization is done by the model, the crop is copied as is
+			if (image.channels() == 1)
+				cv::cvtColor(image, image, cv::COLOR_GRAY2BGR);
+			RHAssert2(0x5d0c3e71, image.type() == CV_8UC3 && N_CHANNEL == 3, "uint8 model input needs 8U images with 1 or 3 channels");
+			image.copyTo(cv::Mat(INPUT_SIZE, INPUT_SIZE, CV_8UC3, input_ptr + i * sizeInBytes));
+			continue;
+		}
+
+		cv::Mat img_blob = blobFromImage(image, N_CHANNEL);
+
+		memcpy(input_ptr + i * sizeInBytes, img_blob.data, sizeInBytes);
+	}
 
-	memcpy(input_ptr, img_blob.data, sizeInBytes);
+	if (batchObjects)
+	{
+		data.erase("objects@current_id");
+		data["objects@offset"] = first + batchSize;
+	}
 
 	Context& inputData = data["objects@input"][0];
-	inputData["input_ptr"] = std::shared_ptr<unsigned char>(input_ptr, [](unsigned char* ptr){ free(ptr);});
+	inputData["input_ptr"] = input;
+	inputData["batch_size"] = static_cast<size_t>(batchSize);
 }
 
 template <typename Impl, TypeCrop typeCrop>
@@ -35,7 +35,7 @@ public:
 private:
 	friend class ONNXModule<Impl>;
 	void virtual postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) override;
-	std::vector<std::vector<float>> getOutputData(std::shared_ptr<uint8_t> buff) const;
+	std::vector<std::vector<float>> getOutputData(std::shared_ptr<uint8_t> buff, size_t row) const;
 
 	int module_version_;
 };
@@ -46,14 +46,14 @@ EmotionsEstimationInference<Impl, typeCrop>::EmotionsEstimationInference(const t
 {};
 
 template <typename Impl, TypeCrop typeCrop>
-std::vector<std::vector<float>> EmotionsEstimationInference<Impl, typeCrop>::getOutputData(std::shared_ptr<uint8_t> buff) const
+std::vector<std::vector<float>> EmotionsEstimationInference<Impl, typeCrop>::getOutputData(std::shared_ptr<uint8_t> buff, size_t row) const
 {
 	std::vector<std::vector<float>> output;
 	const auto& shapes = this->getOutputShapes();
-	RHAssert2(0x7b64809c, shapes.front()[0] == 1, "batch output not supported yet");
+	RHAssert2(0x7b64809c, static_cast<int64_t>(row) < shapes.front()[0], "batch row is out of range");
 
 	size_t predict_shape{static_cast<size_t>(shapes.front()[1])};
-	float* blob_data = reinterpret_cast<float*>(buff.get());
+	float* blob_data = reinterpret_cast<float*>(buff.get()) + row * predict_shape;
 	output.emplace_back(blob_data, blob_data + predict_shape);
 	return output;
 }
@@ -64,26 +64,30 @@ template <typename Impl, TypeCrop typeCrop>
 void EmotionsEstimationInference<Impl, typeCrop>::postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) {
 	if(buffer)
 	{
-		std::vector<std::vector<float>> predict = getOutputData(buffer);
 		tdv::data::Context& objects = data["objects"];
 
 		if(objects.size())
 		{
-			Context& obj = objects[data["objects@current_id"].get<int>()];
-			for(size_t i = 0; i < predict.size(); ++i)
+			for(size_t row = 0; row < this->batchRows(data); ++row)
 			{
-				std::vector<double> softmax_predict = softmaxFunction(predict[i]);
-				for(size_t j = 0; j < softmax_predict.size(); ++j)
+				std::vector<std::vector<float>> predict = getOutputData(buffer, row);
+				Context& obj = objects[this->batchObject(data, row)];
+				for(size_t i = 0; i < predict.size(); ++i)
 				{
-					Context emotion;
-					emotion["emotion"] = class_name[j];
-					emotion["confidence"] = softmax_predict[j];
-					obj["emotions"].push_back(std::move(emotion));
+					std::vector<double> softmax_predict = softmaxFunction(predict[i]);
+					for(size_t j = 0; j < softmax_predict.size(); ++j)
+					{
+						Context emotion;
+						emotion["emotion"] = class_name[j];
+						emotion["confidence"] = softmax_predict[j];
+						obj["emotions"].push_back(std::move(emotion));
+					}
 				}
 			}
 		}
 		else
 		{
+			std::vector<std::vector<float>> predict = getOutputData(buffer, 0);
 			objects.clear();
 			for(size_t i = 0; i < predict.size(); ++i)
 			{
@@ -16,7 +16,7 @@ public:
 private:
 	friend class ONNXModule<Impl>;
 	void virtual postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) override;
-	std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff) const;
+	std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff, size_t row) const;
 
 	const double CONF_THRESH;
 	int module_version_;
@@ -30,14 +30,14 @@ MaskEstimationInference<Impl, typeCrop>::MaskEstimationInference(const tdv::data
 
 
 template <typename Impl, TypeCrop typeCrop>
-std::vector<float> MaskEstimationInference<Impl, typeCrop>::getOutputData(std::shared_ptr<uint8_t> buff) const
+std::vector<float> MaskEstimationInference<Impl, typeCrop>::getOutputData(std::shared_ptr<uint8_t> buff, size_t row) const
 {
 	const auto& shapes = this->getOutputShapes();
 
-	RHAssert2(0xcb64809c, shapes.front()[0] == 1, "batch output not supported yet");
+	RHAssert2(0xcb64809c, static_cast<int64_t>(row) < shapes.front()[0], "batch row is out of range");
 
 	size_t predict_shape{static_cast<size_t>(shapes.front()[1])};
-	float* blob_data = reinterpret_cast<float*>(buff.get());
+	float* blob_data = reinterpret_cast<float*>(buff.get()) + row * predict_shape;
 
 	std::vector<float> result_predict{blob_data, blob_data + predict_shape};
 
@@ -49,18 +49,22 @@ template <typename Impl, TypeCrop typeCrop>
 void MaskEstimationInference<Impl, typeCrop>::postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) {
 	if(buffer)
 	{
-		std::vector<float> predict = getOutputData(buffer);
 		tdv::data::Context& objects = data["objects"];
 		if(objects.size())
 		{
-			Context& obj = objects[data["objects@current_id"].get<int>()];
-			for(size_t i = 0; i < predict.size(); ++i){
-				obj["has_medical_mask"]["value"] = (predict[i] > CONF_THRESH);
-				obj["has_medical_mask"]["confidence"] = static_cast<double>(predict[i]);
+			for(size_t row = 0; row < this->batchRows(data); ++row)
+			{
+				std::vector<float> predict = getOutputData(buffer, row);
+				Context& obj = objects[this->batchObject(data, row)];
+				for(size_t i = 0; i < predict.size(); ++i){
+					obj["has_medical_mask"]["value"] = (predict[i] > CONF_THRESH);
+					obj["has_medical_mask"]["confidence"] = static_cast<double>(predict[i]);
+				}
 			}
 		}
 		else
 		{
+			std::vector<float> predict = getOutputData(buffer, 0);
 			objects.clear();
 			for(size_t i = 0; i < predict.size(); ++i)
 			{
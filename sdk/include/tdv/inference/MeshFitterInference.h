@@ -17,33 +17,38 @@ public:
 private:
 	friend class ONNXModule<Impl>;
 	void virtual postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) override;
-	std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff) const;
+	std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff, size_t row) const;
 
 	void objectFromPredict(std::vector<float> &predict, tdv::data::Context& obj, const int INPUT_SIZE, cv::Size2i frameSize);
 
 	int module_version_;
+	const tdv::utils::recognizer_utils::LandmarksOutput landmarksOutput;
 };
 
 
 template <typename Impl, TypeCrop typeCrop>
 MeshFitterInference<Impl, typeCrop>::MeshFitterInference(const tdv::data::Context& config):
-	BaseEstimationInference<Impl, typeCrop>(config)
+	BaseEstimationInference<Impl, typeCrop>(config),
+	landmarksOutput(tdv::utils::recognizer_utils::landmarksOutputFromString(config.get<std::string>("landmarks_output", "verbose")))
 {
 	this->isNormaliseImage = false;
 }
 
 
 template <typename Impl, TypeCrop typeCrop>
-std::vector<float> MeshFitterInference<Impl, typeCrop>::getOutputData(std::shared_ptr<uint8_t> buff) const
+std::vector<float> MeshFitterInference<Impl, typeCrop>::getOutputData(std::shared_ptr<uint8_t> buff, size_t row) const
 {
 	const auto& shapes = this->getOutputShapes();
 
-	RHAssert2(0xcb64809c, shapes.front()[0] == 1, "batch output not supported yet");
+	RHAssert2(0xcb64809c, static_cast<int64_t>(row) < shapes.front()[0], "batch row is out of range");
 
-	size_t predict_shape{static_cast<size_t>(shapes.front()[1] + 1)};
+	// outputs follow each other in the buffer: landmarks of the whole batch, then the face scores
+	const int64_t batch = shapes.front()[0];
+	size_t predict_shape{static_cast<size_t>(shapes.front()[1])};
 	float* blob_data = reinterpret_cast<float*>(buff.get());
 
-	std::vector<float> result_predict{blob_data, blob_data + predict_shape};
+	std::vector<float> result_predict{blob_data + row * predict_shape, blob_data + (row + 1) * predict_shape};
+	result_predict.push_back(shapes.size() > 1 ? blob_data[batch * predict_shape + row] : 0.f);
 
 	return result_predict;
 }
@@ -68,18 +73,48 @@ void MeshFitterInference<Impl, typeCrop>::objectFromPredict(std::vector<float> &
 		ci_h = obj["bbox"][3].get<double>() * i_h - o_y * i_h ;
 	}
 
-	tdv::data::Context& points = key_points["points"];
-	for (int i = 0; i < predict.size() - 1; i += 3){
-		tdv::data::Context point;
-		point["x"] = static_cast<double>(o_x + (predict[i] / INPUT_SIZE) * (ci_w / i_w));
-		point["y"] = static_cast<double>(o_y + (predict[i + 1] / INPUT_SIZE) * (ci_h / i_h));
-		point["z"] = static_cast<double>(predict[i + 2] / INPUT_SIZE);
-		points.push_back(std::move(point));
-	}
+	using tdv::utils::recognizer_utils::LandmarksOutput;
 
 	key_points["fitter_type"] = "mesh";
 
-	tdv::utils::recognizer_utils::constructFdaPonints2Context(key_points);
+	if (landmarksOutput == LandmarksOutput::VERBOSE)
+	{
+		tdv::data::Context& points = key_points["points"];
+		for (int i = 0; i < predict.size() - 1; i += 3){
+			tdv::data::Context point;
+			point["x"] = static_cast<double>(o_x + (predict[i] / INPUT_SIZE) * (ci_w / i_w));
+			point["y"] = static_cast<double>(o_y + (predict[i + 1] / INPUT_SIZE) * (ci_h / i_h));
+			point["z"] = static_cast<double>(predict[i + 2] / INPUT_SIZE);
+			points.push_back(std::move(point));
+		}
+
+		tdv::utils::recognizer_utils::constructFdaPonints2Context(key_points);
+		return;
+	}
+
+	// compact and fda outputs skip the per point contexts, the points are kept in a flat [N, 3] buffer
+	const size_t count = (predict.size() - 1) / 3;
+	std::shared_ptr<unsigned char> blob(reinterpret_cast<unsigned char*>(new float[count * 3]),
+		[](unsigned char* ptr){ delete[] reinterpret_cast<float*>(ptr); });
+	float* points = reinterpret_cast<float*>(blob.get());
+	for (size_t i = 0; i < count * 3; i += 3){
+		points[i] = static_cast<float>(o_x + (predict[i] / INPUT_SIZE) * (ci_w / i_w));
+		points[i + 1] = static_cast<float>(o_y + (predict[i + 1] / INPUT_SIZE) * (ci_h / i_h));
+		points[i + 2] = predict[i + 2] / INPUT_SIZE;
+	}
+
+	tdv::utils::recognizer_utils::constructFdaPonints2Context(key_points, points);
+
+	if (landmarksOutput == LandmarksOutput::COMPACT)
+	{
+		tdv::data::Context& pointsCtx = key_points["points"];
+		pointsCtx["format"] = "NDARRAY";
+		pointsCtx["blob"] = blob;
+		pointsCtx["dtype"] = "float";
+		pointsCtx.erase("shape");
+		pointsCtx["shape"].push_back(static_cast<int64_t>(count));
+		pointsCtx["shape"].push_back(static_cast<int64_t>(3));
+	}
 }
 
 
@@ -87,22 +122,27 @@ template <typename Impl, TypeCrop typeCrop>
 void MeshFitterInference<Impl, typeCrop>::postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) {
 	if(buffer)
 	{
-		std::vector<float> predict = getOutputData(buffer);
-		const auto INPUT_SIZE = this->getInputShapes().front()[2];
+		const auto INPUT_SIZE = this->getInputShapes().front()[this->input_size_index];
 		tdv::data::Context& objects = data["objects"];
 		tdv::data::Context& imgShape = data["image"]["shape"];
+		const cv::Size2i frameSize(imgShape[1].get<int64_t>(), imgShape[0].get<int64_t>());
 		if(objects.size())
 		{
-			Context& obj = objects[data["objects@current_id"].get<int>()];
-			objectFromPredict(predict, obj, INPUT_SIZE, cv::Size2i(imgShape[1].get<int64_t>(), imgShape[0].get<int64_t>()));
+			for(size_t row = 0; row < this->batchRows(data); ++row)
+			{
+				std::vector<float> predict = getOutputData(buffer, row);
+				Context& obj = objects[this->batchObject(data, row)];
+				objectFromPredict(predict, obj, INPUT_SIZE, frameSize);
+			}
 		}
 		else
 		{
+			std::vector<float> predict = getOutputData(buffer, 0);
 			objects.clear();
 			tdv::data::Context face;
 			face["id"] = 0l;
 			face["class"] = "face";
-			objectFromPredict(predict, face, INPUT_SIZE, cv::Size2i(imgShape[1].get<int64_t>(), imgShape[0].get<int64_t>()));
+			objectFromPredict(predict, face, INPUT_SIZE, frameSize);
 			objects.push_back(std::move(face));
 		}
 	}
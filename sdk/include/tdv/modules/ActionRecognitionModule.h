@@ -0,0 +1,75 @@
+#ifndef ACTION_RECOGNITION_MODULE_H
+#define ACTION_RECOGNITION_MODULE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <tdv/modules/ONNXModule.h>
+
+namespace tdv {
+namespace modules {
+
+// Skeleton based action recognition over tracks: POSE_ESTIMATOR keypoints of the tracked persons (obj["keypoints"],
+// normalized by pose_vector2normalizedCtx) are accumulated in per track ring buffers, every "stride" frames
+// the model is run once on the sequences of all the tracks with a full buffer.
+// Model input is [batch, persons (1), frames, joints, channels] with (x, y, score) channels, output - [batch, classes].
+// Config:
+//   "label_map" - action labels, "joints_label_map" - joint names in the model order (POSE_ESTIMATOR label map)
+//   "stride" - frames between the inferences of a stream
+//   "max_missing_frames" - tracks not seen for longer are dropped
+//   "centered" - coordinates are mapped from [0, 1] to [-1, 1]
+//   "softmax" - output are logits
+// Input: data["objects"] with "track_id" and "keypoints", optional data["stream_id"].
+// Output: obj["action"] - {"label", "class_id", "confidence"}, the last recognized action of the track.
+class ActionRecognitionModule : public ONNXModule<ActionRecognitionModule>
+{
+public:
+	ActionRecognitionModule(const tdv::data::Context& config);
+	virtual void operator ()(tdv::data::Context& data) override;
+
+private:
+	friend class ONNXModule<ActionRecognitionModule>;
+
+	// (x, y, score) of the joints of the last frames
+	struct Track
+	{
+		std::vector<float> frames;
+		size_t head = 0;
+		size_t count = 0;
+		int64_t lastFrame = 0;
+		tdv::data::Context action;
+	};
+
+	struct Stream
+	{
+		std::mutex mutex;
+		int64_t frame = 0;
+		std::map<int64_t, Track> tracks;
+	};
+
+	Stream& getStream(const tdv::data::Context& data);
+	void addFrame(Stream& stream, tdv::data::Context& objects);
+
+	void preprocess(tdv::data::Context& data) override;
+	void postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) override;
+
+	std::map<int, std::string> labelMap;
+	std::vector<std::string> joints;
+	size_t sequenceLength;
+	size_t channels;
+	const int64_t stride;
+	const int64_t maxMissingFrames;
+	const bool centered;
+	const bool useSoftmax;
+
+	std::mutex mutex;
+	std::map<std::string, std::unique_ptr<Stream>> streams;
+};
+
+}
+}
+
+#endif // ACTION_RECOGNITION_MODULE_H
@@ -5,23 +5,38 @@
 
 #include <tdv/data/Context.h>
 #include <tdv/modules/ProcessingBlock.h>
+#include <tdv/utils/profiler/Profiler.h>
 
 
 namespace tdv {
 
 namespace modules {
 
-class BaseEstimationModule : public ProcessingBlock
+// Blocks taking their input from crops of the objects of data["image"]
+class CropPreprocessor
 {
 public:
-	BaseEstimationModule(const tdv::data::Context& config);
+	virtual ~CropPreprocessor() = default;
+	// puts the crops of all objects to data["@crop_cache"] (see tdv::data::cachedCrop) if the block uses the cache
+	virtual void cacheCrops(tdv::data::Context& data) = 0;
+};
+
+class BaseEstimationModule : public ProcessingBlock, public CropPreprocessor
+{
+public:
+	BaseEstimationModule(const tdv::data::Context& config, bool batchObjectsByDefault = false);
 	virtual void operator ()(tdv::data::Context& data) override;
+	virtual void cacheCrops(tdv::data::Context& data) override;
 
 protected:
 	virtual void process(tdv::data::Context& data) {return;}
 	std::unique_ptr<ProcessingBlock> block;
 
 	int module_version = 0;
+	// "batch_objects" - process all objects with one call of the block instead of one by one,
+	// enabled by default for blocks passing batchObjectsByDefault
+	const bool batchObjects;
+	tdv::utils::profiler::BlockProfiler profiler;
 };
 
 
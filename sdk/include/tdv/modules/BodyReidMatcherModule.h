@@ -0,0 +1,72 @@
+#ifndef BODY_REID_MATCHER_MODULE_H
+#define BODY_REID_MATCHER_MODULE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <tdv/modules/ProcessingBlock.h>
+#include <tdv/utils/profiler/Profiler.h>
+
+
+namespace tdv {
+
+namespace modules {
+
+// Matches body templates (BODY_RE_IDENTIFICATION output) by cosine similarity against galleries
+// kept between calls, one per camera group, and associates the objects with gallery identities.
+// Config:
+//   "threshold" - minimal similarity of a match
+//   "top_k" - number of best gallery entries written to obj["matches"]
+//   "gallery_window_ms" - entries not matched for longer are dropped, 0 - never
+//   "max_gallery_size" - per camera group, the least recently matched entries are dropped first
+//   "update_momentum" - weight of the stored template when a match updates it
+// Input: data["objects"] with "template"; optional data["camera_group"], data["camera_id"],
+// data["timestamp_ms"] (steady clock by default) and data["gallery_update"] (true by default).
+// Output: obj["matches"] - [{"reid_id", "similarity", "camera_id", "timestamp_ms"}] in descending similarity,
+// obj["reid_id"] - matched identity, a new one if nothing matched (only with gallery update).
+class BodyReidMatcherModule : public ProcessingBlock
+{
+public:
+	BodyReidMatcherModule(const tdv::data::Context& config);
+	virtual void operator ()(tdv::data::Context& data) override;
+
+private:
+	// unit length templates stored row by row
+	struct Gallery
+	{
+		size_t dimension = 0;
+		std::vector<float> templates;
+		std::vector<int64_t> ids;
+		std::vector<double> timestamps;
+		std::vector<std::string> cameras;
+
+		size_t size() const { return ids.size(); }
+		void push_back(int64_t id, const float* data, double timestamp, const std::string& camera);
+		void remove(size_t row);
+	};
+
+	void expire(Gallery& gallery, double now) const;
+	void match(Gallery& gallery, tdv::data::Context& data, double now, bool update);
+
+	const double threshold;
+	const size_t topK;
+	const double windowMs;
+	const size_t maxGallerySize;
+	const float momentum;
+
+	std::mutex mutex;
+	std::map<std::string, Gallery> galleries;
+	int64_t nextId = 0;
+
+	tdv::utils::profiler::BlockProfiler profiler;
+};
+
+
+}
+
+}
+
+#endif // BODY_REID_MATCHER_MODULE_H
@@ -7,6 +7,9 @@ namespace tdv {
 
 namespace modules {
 
+// Body embeddings. With data["objects"] (e.g. HUMAN_BODY_DETECTOR output) every body object gets
+// "template" (std::vector<float>) and "template_size", the crops are run as one batch if the model has
+// a dynamic batch dimension. Without objects the whole image is embedded to data["output_data"].
 class BodyReidentificationModule : public ONNXModule<BodyReidentificationModule>
 {
 public:
@@ -15,8 +18,11 @@ private:
 	friend class ONNXModule<BodyReidentificationModule>;
 	void virtual preprocess(tdv::data::Context& data) override;
 	void virtual postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) override;
-	std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff);
+	const float* getOutputData(std::shared_ptr<uint8_t> buff, size_t row) const;
 	static void getEncriptionKey(int64_t &key_data_len, unsigned char const* &key_data, int model_version=1);
+
+	// reuse crops of other blocks, see tdv::data::cachedCrop
+	const bool useCropCache;
 };
 
 
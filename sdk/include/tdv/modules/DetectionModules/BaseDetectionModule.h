@@ -9,6 +9,7 @@
 
 #include <tdv/data/ContextUtils.h>
 #include <tdv/modules/ONNXModule.h>
+#include <tdv/utils/nms_utils/NMSUtils.h>
 #include <tdv/utils/rassert/RAssert.h>
 
 namespace{
@@ -68,91 +69,8 @@ cv::Mat blobFromImage(cv::Mat& image, int nchannel = 3, bool needBGR=false, cons
 	return output;
 }
 
-inline float area(const std::vector<float>& v) {
-	if (v.size()!=4)
-		return 0;
-	float area = (v[2]-v[0])*(v[3]-v[1]);
-	return (area > 0) ? area : 0;
-}
-
-inline std::vector<float> intersection(const std::vector<float>& v1, const std::vector<float>& v2) {
-
-	if (!(v1.size()==4 && v2.size()==4 && (v1[0]<v1[2]) && (v1[1]<v1[3]) && (v2[0]<v2[2]) && (v2[1]<v2[3])))
-		return {0, 0, 0, 0};
-
-	float x1_max = (v1[0] < v2[0]) ? v2[0] : v1[0];
-	float y1_max = (v1[1] < v2[1]) ? v2[1] : v1[1];
-	float x2_min = (v1[2] < v2[2]) ? v1[2] : v2[2];
-	float y2_min = (v1[3] < v2[3]) ? v1[3] : v2[3];
-
-	if ((x1_max >= x2_min) || (y1_max >= y2_min)) {
-		return {0, 0, 0, 0};
-	}
-	return {x1_max, y1_max, x2_min, y2_min};
-}
-
-template <typename T>
-inline bool SortScorePairDescend(const std::pair<float, T>& pair1,
-						  const std::pair<float, T>& pair2)
-{
-	return pair1.first > pair2.first;
-}
-
-void GetMaxScoreIndex(const std::vector<float>& scores, const float threshold, const int top_k,
-					  std::vector<std::pair<float, int> >& score_index_vec)
-{
-	// Generate index score pairs.
-	for (size_t i = 0; i < scores.size(); ++i)
-	{
-		if (scores[i] > threshold)
-		{
-			score_index_vec.push_back(std::make_pair(scores[i], i));
-		}
-	}
-
-	// Sort the score pair according to the scores in descending order
-	std::stable_sort(score_index_vec.begin(), score_index_vec.end(),
-					 SortScorePairDescend<int>);
-
-	// Keep top_k scores if needed.
-	if (top_k > 0 && top_k < (int)score_index_vec.size())
-	{
-		score_index_vec.resize(top_k);
-	}
-}
-
-
-void NMSFast_(const std::vector<std::vector<float>>& bboxes,
-	  const std::vector<float>& scores, const float score_threshold,
-	  const float nms_threshold,
-	  std::vector<int>& indices, const float eta=1.f, const int top_k=0)
-{
-	RHAssert(0x000000, bboxes.size() == scores.size());
-
-	// Get top_k scores (with corresponding indices).
-	std::vector<std::pair<float, int> > score_index_vec;
-	GetMaxScoreIndex(scores, score_threshold, top_k, score_index_vec);
-
-	// Do nms.
-	float adaptive_threshold = nms_threshold;
-	indices.clear();
-	for (size_t i = 0; i < score_index_vec.size(); ++i) {
-		const int idx = score_index_vec[i].second;
-		bool keep = true;
-		for (int k = 0; k < (int)indices.size() && keep; ++k) {
-			const int kept_idx = indices[k];
-			float intArea = static_cast<float>(area(intersection(bboxes[idx], bboxes[kept_idx])));
-			float unionArea = area(bboxes[idx]) + area(bboxes[kept_idx]) - intArea;
-			float overlap = intArea / unionArea;
-			keep = overlap <= adaptive_threshold;
-		}
-		if (keep)
-			indices.push_back(idx);
-		if (keep && eta < 1 && adaptive_threshold > 0.5) {
-		  adaptive_threshold *= eta;
-		}
-	}
-}
+// images or views of a frame per inference of a dynamic batch model
+const size_t DEFAULT_DETECTION_BATCH_SIZE = 8;
 
 float clip_value(float x, float min, float max)
 {
@@ -178,30 +96,54 @@ private:
 	friend class ONNXModule<Impl>;
 	void virtual preprocess(tdv::data::Context& data) override;
 	void virtual postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) override;
-	std::vector<std::vector<float>> getOutputData(std::shared_ptr<uint8_t> buff) const;
-	tdv::data::Context processOutputData(std::vector<std::vector<float>> predictions,
-									  const tdv::data::Context& metadata);
+	std::vector<std::vector<float>> getOutputData(std::shared_ptr<uint8_t> buff, size_t batch_index) const;
+	std::vector<cv::Rect> getViews(int width, int height) const;
+	void appendCandidates(const std::vector<std::vector<float>>& predictions, const std::tuple<int, int, double>& offset,
+						  const cv::Point& origin, tdv::utils::nms_utils::Boxes& candidates) const;
+	tdv::data::Context processOutputData(const tdv::utils::nms_utils::Boxes& candidates, const tdv::data::Context& image_shape) const;
 	const double IOU_THRESH;
 	const double CONF_THRESH;
 	const bool RAW_OUTPUT;
+	const int64_t BATCH_SIZE;
+	const int TILE_SIZE;
+	const double TILE_OVERLAP;
+	const bool TILE_FULL_FRAME;
+	tdv::utils::nms_utils::NMSParameters nmsParameters;
 protected:
 	bool needBGR = false;
 };
 
 
+// Accepts a single image context or an array of them (see MultiInputAdapter),
+// images are letterboxed into [N,3,H,W] tensors of at most batch_size images.
+// With tile_size set, frames larger than a tile are split into overlapping tiles (plus the whole
+// frame if tile_full_frame), which are batched together and merged back with NMS
 template<typename Impl>
 BaseDetectionModule<Impl>::BaseDetectionModule(const tdv::data::Context& config) :
-	ONNXModule<Impl>(config),
+	ONNXModule<Impl>(config, std::make_shared<MultiInputAdapter>(), DEFAULT_DETECTION_BATCH_SIZE),
 	IOU_THRESH(config.get<double>("iou_threshold", 0.5)),
 	CONF_THRESH(config.get<double>("confidence_threshold", 0.5)),
-	RAW_OUTPUT(config.get<bool>("raw_output", false))
-	{}
+	RAW_OUTPUT(config.get<bool>("raw_output", false)),
+	BATCH_SIZE(std::max<int64_t>(config.get_as<int64_t>("batch_size", static_cast<int64_t>(DEFAULT_DETECTION_BATCH_SIZE)), 1)),
+	TILE_SIZE(config.get_as<int64_t>("tile_size", 0)),
+	TILE_OVERLAP(config.get_as<double>("tile_overlap", 0.2)),
+	TILE_FULL_FRAME(config.get<bool>("tile_full_frame", true))
+{
+	RHAssert2(0x5bba522f, TILE_SIZE >= 0 && TILE_OVERLAP >= 0 && TILE_OVERLAP < 1, "invalid tiling parameters");
+	RHAssert2(0x5cc84e89, !(TILE_SIZE && RAW_OUTPUT), "tiling is not supported with raw output");
+	nmsParameters.iouThreshold = IOU_THRESH;
+	nmsParameters.method = tdv::utils::nms_utils::nmsMethodFromString(config.get<std::string>("nms_method", "hard"));
+	nmsParameters.sigma = config.get_as<double>("soft_nms_sigma", 0.5);
+	// decayed scores of soft-NMS are compared with the confidence threshold
+	if (nmsParameters.method != tdv::utils::nms_utils::NMSMethod::HARD)
+		nmsParameters.scoreThreshold = CONF_THRESH;
+}
 
 template<typename Impl>
-std::vector<std::vector<float>> BaseDetectionModule<Impl>::getOutputData(std::shared_ptr<uint8_t> buff) const
+std::vector<std::vector<float>> BaseDetectionModule<Impl>::getOutputData(std::shared_ptr<uint8_t> buff, size_t batch_index) const
 {
 	const auto& shapes = this->getOutputShapes();
-	RHAssert2(0x7b64809c, shapes.front()[0] == 1, "batch output not supported yet");
+	RHAssert2(0x7b64809c, static_cast<int64_t>(batch_index) < shapes.front()[0], "batch index is out of range");
 
 	size_t predict_count{static_cast<size_t>(shapes.front()[1])}, predict_shape{static_cast<size_t>(shapes.front()[2])};
 
@@ -212,12 +154,15 @@ std::vector<std::vector<float>> BaseDetectionModule<Impl>::getOutputData(std::sh
 	auto types = this->getOutputTypes();
 	switch (types.front()) { // ONNXTensorElementDataType
 	case 1:	// maps to c type float
+	{
+		const float* batch_data = reinterpret_cast<const float*>(buff.get()) + batch_index * predict_count * predict_shape;
 		for(size_t i=0; i < predict_count; ++i)
 		{
-			float* blob_data = reinterpret_cast<float*>(buff.get()+sizeof(float)*i*predict_shape);
+			const float* blob_data = batch_data + i * predict_shape;
 			bboxes.emplace_back(blob_data, blob_data + predict_shape);
 		}
 		break;
+	}
 	default:
 		throw	tdv::utils::rassert::tdv_error(0xed26ca12, "unsupported output type");
 	}
@@ -225,31 +170,115 @@ std::vector<std::vector<float>> BaseDetectionModule<Impl>::getOutputData(std::sh
 }
 
 template<typename Impl>
-void BaseDetectionModule<Impl>::preprocess(tdv::data::Context& data) {
-	Context& imageInput = data.at("image");
+std::vector<cv::Rect> BaseDetectionModule<Impl>::getViews(int width, int height) const
+{
+	std::vector<cv::Rect> views;
+	if (!TILE_SIZE || (width <= TILE_SIZE && height <= TILE_SIZE))
+	{
+		views.emplace_back(0, 0, width, height);
+		return views;
+	}
 
-	cv::Mat image = tdv::data::bsmToCvMat(imageInput, true);
+	// tiles are spread evenly so that the last one ends at the frame border
+	auto positions = [this](int length) {
+		const int tile = std::min(TILE_SIZE, length);
+		const int stride = std::max(1, static_cast<int>(tile * (1 - TILE_OVERLAP)));
+		const int count = (length - tile + stride - 1) / stride + 1;
+		std::vector<int> result;
+		for (int i = 0; i < count; ++i)
+			result.push_back(count > 1 ? static_cast<int>(static_cast<int64_t>(length - tile) * i / (count - 1)) : 0);
+		return result;
+	};
+
+	for (int y : positions(height))
+		for (int x : positions(width))
+			views.emplace_back(x, y, std::min(TILE_SIZE, width), std::min(TILE_SIZE, height));
+
+	if (TILE_FULL_FRAME)
+		views.emplace_back(0, 0, width, height);
+	return views;
+}
 
-	RHAssert2(0x11113333, image.depth() == CV_8U || image.depth() == CV_32F, "only 8U and 32F image types are suported");
+template<typename Impl>
+void BaseDetectionModule<Impl>::preprocess(tdv::data::Context& data) {
+	Context& images = data.at("input");
+	int64_t imageIndex = data.get<int64_t>("input@offset", 0);
+	int64_t viewIndex = data.get<int64_t>("input@view", 0);
+	const int64_t maxBatchSize = this->getDynamicBatchEnabled().front() ? BATCH_SIZE : 1;
+
+	// views of the next images (a frame may be split between consecutive batches)
+	std::vector<std::pair<int64_t, cv::Rect>> batch;
+	while (static_cast<int64_t>(batch.size()) < maxBatchSize && imageIndex < static_cast<int64_t>(images.size()))
+	{
+		const Context& imageShape = images[imageIndex].at("image").at("shape");
+		const std::vector<cv::Rect> views = getViews(imageShape[1].get<int64_t>(), imageShape[0].get<int64_t>());
+		while (viewIndex < static_cast<int64_t>(views.size()) && static_cast<int64_t>(batch.size()) < maxBatchSize)
+			batch.emplace_back(imageIndex, views[viewIndex++]);
+		if (viewIndex == static_cast<int64_t>(views.size()))
+		{
+			++imageIndex;
+			viewIndex = 0;
+		}
+	}
+	if (batch.empty())
+		return;
 
+	// uint8 models take NHWC images
+	const bool uint8Input = this->isUint8Input();
 	const auto& shape = this->getInputShapes();
-	const auto& INPUT_HEIGHT = shape.front()[2];
-	const auto& INPUT_WIDTH = shape.front()[3];
-	const auto& N_CHANNEL = shape.front()[1];
+	const auto& INPUT_HEIGHT = shape.front()[uint8Input ? 1 : 2];
+	const auto& INPUT_WIDTH = shape.front()[uint8Input ? 2 : 3];
+	const auto& N_CHANNEL = shape.front()[uint8Input ? 3 : 1];
 
-	auto offset = resizeWithPad(image, INPUT_WIDTH, INPUT_HEIGHT);
-	size_t sizeInBytes = INPUT_WIDTH * INPUT_HEIGHT * N_CHANNEL * sizeof(float);
+	size_t sizeInBytes = INPUT_WIDTH * INPUT_HEIGHT * N_CHANNEL * (uint8Input ? sizeof(uint8_t) : sizeof(float));
 
-	unsigned char* input_ptr = static_cast<unsigned char*>(malloc(sizeInBytes));
+	unsigned char* input_ptr = static_cast<unsigned char*>(malloc(sizeInBytes * batch.size()));
 	if(!input_ptr)
 		throw std::bad_alloc();
-	cv::Mat img_blob = blobFromImage(image, N_CHANNEL, needBGR);
-	memcpy(input_ptr, img_blob.data, sizeInBytes);
+	std::shared_ptr<unsigned char> input(input_ptr, [](unsigned char* ptr){ free(ptr);});
 
 	Context& inputData = data["objects@input"][0];
-	inputData["input_ptr"] = std::shared_ptr<unsigned char>(input_ptr, [](unsigned char* ptr){ free(ptr);});
-	inputData["resize_offset"] = offset;
-	inputData["image_shape"] = data.at("image").at("shape");
+	cv::Mat image;
+	int64_t decodedIndex = -1;
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		if (batch[i].first != decodedIndex)
+		{
+			decodedIndex = batch[i].first;
+			image = tdv::data::bsmToCvMat(images[decodedIndex].at("image"));
+			RHAssert2(0x11113333, image.depth() == CV_8U || image.depth() == CV_32F, "only 8U and 32F image types are suported");
+		}
+
+		const cv::Rect& view = batch[i].second;
+		cv::Mat viewImage = image(view).clone();
+
+		auto offset = resizeWithPad(viewImage, INPUT_WIDTH, INPUT_HEIGHT);
+		if (uint8Input)
+		{
+			// the normalization is done by the model, only the channel order is set here
+			if (viewImage.channels() == 1)
+				cv::cvtColor(viewImage, viewImage, cv::COLOR_GRAY2RGB);
+			if (needBGR)
+				cv::cvtColor(viewImage, viewImage, cv::COLOR_RGB2BGR);
+			RHAssert2(0x9e48f8eb, viewImage.type() == CV_8UC3 && N_CHANNEL == 3, "uint8 model input needs 8U images with 1 or 3 channels");
+			viewImage.copyTo(cv::Mat(INPUT_HEIGHT, INPUT_WIDTH, CV_8UC3, input_ptr + i * sizeInBytes));
+		}
+		else
+		{
+			cv::Mat img_blob = blobFromImage(viewImage, N_CHANNEL, needBGR);
+			memcpy(input_ptr + i * sizeInBytes, img_blob.data, sizeInBytes);
+		}
+
+		inputData["resize_offset"].push_back(offset);
+		inputData["view"].push_back(std::make_tuple(decodedIndex, view.x, view.y));
+	}
+
+	inputData["input_ptr"] = input;
+	inputData["batch_size"] = batch.size();
+	data["input@offset"] = imageIndex;
+	data["input@view"] = viewIndex;
+	// views of a frame may not fit into one batch, also for a single image input
+	data["@pending"] = imageIndex < static_cast<int64_t>(images.size());
 	return;
 }
 
@@ -257,23 +286,51 @@ template<typename Impl>
 void BaseDetectionModule<Impl>::postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) {
 	if(buffer)
 	{
-		std::vector<std::vector<float>> bboxes = getOutputData(buffer);
-		if(!RAW_OUTPUT)
+		using ViewType = std::tuple<int64_t, int, int>;
+		const Context& inputData = data.at("objects@input")[0];
+		const Context& views = inputData.at("view");
+		const int64_t nextImage = data.at("input@offset").get<int64_t>();
+
+		for (size_t i = 0; i < views.size(); ++i)
 		{
-			data["objects"] = processOutputData(bboxes, data);
+			const ViewType view = views[i].get<ViewType>();
+			const int64_t imageIndex = std::get<0>(view);
+			Context& item = data.at("input")[imageIndex];
+			std::vector<std::vector<float>> bboxes = getOutputData(buffer, i);
+			if(RAW_OUTPUT)
+			{
+				item["body_boxes"] = std::move(bboxes);
+				continue;
+			}
+
+			// boxes of a tiled frame are collected until its last view is processed
+			Context& candidatesCtx = item["objects@candidates"];
+			if (candidatesCtx.isNone())
+				candidatesCtx = std::make_shared<tdv::utils::nms_utils::Boxes>();
+			auto candidates = candidatesCtx.get<std::shared_ptr<tdv::utils::nms_utils::Boxes>>();
+
+			appendCandidates(bboxes, inputData.at("resize_offset")[i].get<std::tuple<int, int, double>>(),
+				cv::Point(std::get<1>(view), std::get<2>(view)), *candidates);
+
+			const bool lastView = imageIndex < nextImage &&
+				(i + 1 == views.size() || std::get<0>(views[i + 1].get<ViewType>()) != imageIndex);
+			if (lastView)
+			{
+				item["objects"] = processOutputData(*candidates, item.at("image").at("shape"));
+				item.erase("objects@candidates");
+			}
 		}
-		else
-			data["body_boxes"] = std::move(bboxes);
 	}
 }
 
 template<typename Impl>
-tdv::data::Context BaseDetectionModule<Impl>::processOutputData(std::vector<std::vector<float>> predictions,
-									  const tdv::data::Context& metadata)
+void BaseDetectionModule<Impl>::appendCandidates(const std::vector<std::vector<float>>& predictions,
+									  const std::tuple<int, int, double>& offset, const cv::Point& origin,
+									  tdv::utils::nms_utils::Boxes& candidates) const
 {
-	std::vector<std::vector<float>> localBoxes;
-	std::vector<float> localConfidences;
-	std::vector<int> indices;
+	const float scale = std::get<2>(offset);
+	const float dx = origin.x - std::get<0>(offset);
+	const float dy = origin.y - std::get<1>(offset);
 
 	for (const auto& cur_pred : predictions)
 	{
@@ -281,42 +338,41 @@ tdv::data::Context BaseDetectionModule<Impl>::processOutputData(std::vector<std:
 		if (obj_conf < CONF_THRESH)
 			continue;
 
-		// convert box from xywh to xyxy
+		// convert box from xywh to xyxy in the frame pixel coordinates
 		float xc = cur_pred[0];
 		float yc = cur_pred[1];
 		float w = cur_pred[2];
 		float h = cur_pred[3];
-		float x1 = xc - w / 2;
-		float y1 = yc - h / 2;
-		float x2 = xc + w / 2;
-		float y2 = yc + h / 2;
-		localBoxes.push_back({x1, y1, x2, y2});
-		localConfidences.push_back(obj_conf);
+		candidates.push_back((xc - w / 2) * scale + dx, (yc - h / 2) * scale + dy,
+			(xc + w / 2) * scale + dx, (yc + h / 2) * scale + dy, obj_conf);
 	}
+}
 
-	NMSFast_(localBoxes, localConfidences, 0.0, IOU_THRESH, indices);
-	const auto offset = metadata.at("objects@input")[0].at("resize_offset").get<std::tuple<int, int, double>>();
-	const auto img_height = metadata.at("objects@input")[0].at("image_shape")[0].get<int64_t>();
-	const auto img_width = metadata.at("objects@input")[0].at("image_shape")[1].get<int64_t>();
-
-	const Context& imageInput = metadata.at("image");
-	std::shared_ptr<cv::Mat> image = std::shared_ptr<cv::Mat>(new cv::Mat(tdv::data::bsmToCvMat(imageInput, true)));
+template<typename Impl>
+tdv::data::Context BaseDetectionModule<Impl>::processOutputData(const tdv::utils::nms_utils::Boxes& candidates,
+									  const tdv::data::Context& image_shape) const
+{
+	std::vector<float> localConfidences;
+	std::vector<int> indices = tdv::utils::nms_utils::nms(candidates, nmsParameters, &localConfidences);
+	const auto img_height = image_shape[0].get<int64_t>();
+	const auto img_width = image_shape[1].get<int64_t>();
 
 	tdv::data::Context objects;
 	for (size_t i = 0; i < indices.size(); i++) {
 		tdv::data::Context object;
 		object["id"] = static_cast<int64_t>(i);
 		object["class"] = Impl::CLASS_NAME;
-		object["confidence"] = (double)localConfidences[indices[i]];
-		object["score"] = (double)localConfidences[indices[i]];
-		std::vector<float>& lbox = localBoxes[indices[i]];
+		object["confidence"] = (double)localConfidences[i];
+		object["score"] = (double)localConfidences[i];
+		const int index = indices[i];
 		// convert to original image normalized coordinates
-		lbox[0] = (lbox[0] * std::get<2>(offset) - std::get<0>(offset)) / img_width;
-		lbox[1] = (lbox[1] * std::get<2>(offset) - std::get<1>(offset)) / img_height;
-		lbox[2] = (lbox[2] * std::get<2>(offset) - std::get<0>(offset)) / img_width;
-		lbox[3] = (lbox[3] * std::get<2>(offset) - std::get<1>(offset)) / img_height;
+		const float lbox[] = {
+			candidates.x1[index] / img_width,
+			candidates.y1[index] / img_height,
+			candidates.x2[index] / img_width,
+			candidates.y2[index] / img_height};
 
-		for(auto coord : localBoxes[indices[i]])
+		for(auto coord : lbox)
 		{
 			coord = clip_value(coord, 0.0, 1.0);
 			object["bbox"].push_back(static_cast<double>(coord));
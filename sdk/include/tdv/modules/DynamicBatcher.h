@@ -0,0 +1,70 @@
+#ifndef DYNAMIC_BATCHER_H
+#define DYNAMIC_BATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tdv/utils/metrics/Metrics.h>
+
+
+namespace tdv {
+
+namespace modules {
+
+// Collects inference requests coming from different threads (e.g. one per camera stream)
+// for up to window_ms milliseconds since the oldest one or until max_batch_size samples are queued,
+// runs them as a single dynamic batch inference and scatters the outputs back to the callers.
+// Requests are merged if their input shapes differ in the batch dimension only.
+// The queue depth and the batch sizes are recorded to the metrics of the block.
+class DynamicBatcher
+{
+public:
+	using Shapes = std::vector<std::vector<int64_t>>;
+	using InferFunction = std::function<std::shared_ptr<uint8_t>(const std::vector<void*>&, const Shapes&, Shapes&)>;
+
+	// input_element_sizes, output_element_sizes - size in bytes of a single tensor element
+	DynamicBatcher(InferFunction infer, const std::vector<size_t>& input_element_sizes,
+		const std::vector<size_t>& output_element_sizes, int64_t max_batch_size, double window_ms,
+		tdv::utils::metrics::BlockMetrics& metrics);
+
+	DynamicBatcher(const DynamicBatcher&) = delete;
+	DynamicBatcher& operator=(const DynamicBatcher&) = delete;
+
+	~DynamicBatcher();
+
+	// Same data layout as ONNXRuntimeEnvironment::infer, blocks until the batch containing the request is processed
+	std::shared_ptr<uint8_t> infer(const std::vector<void*>& input_data, const Shapes& input_shapes, Shapes& output_shapes);
+
+private:
+	struct Request;
+
+	void run();
+	void process(const std::vector<Request*>& batch, int64_t total_batch_size);
+
+	const InferFunction inferFunction;
+	const std::vector<size_t> inputElementSizes;
+	const std::vector<size_t> outputElementSizes;
+	const int64_t maxBatchSize;
+	const std::chrono::microseconds window;
+	tdv::utils::metrics::BlockMetrics& metrics;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<Request*> queue;
+	int64_t queuedSamples = 0;
+	bool stopped = false;
+
+	std::thread worker;
+};
+
+}
+}
+
+#endif // DYNAMIC_BATCHER_H
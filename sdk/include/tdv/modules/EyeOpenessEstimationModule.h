@@ -11,14 +11,12 @@ class EyeOpenessEstimationModule : public ONNXModule<EyeOpenessEstimationModule>
 {
 public:
     EyeOpenessEstimationModule(const tdv::data::Context& config);
-    void operator()(tdv::data::Context& data);
+    void operator()(tdv::data::Context& data) override;
 private:
     friend class ONNXModule<EyeOpenessEstimationModule>;
     void virtual preprocess(tdv::data::Context& data) override;
     void virtual postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) override;
-    void process(tdv::data::Context& data);
-    std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff) const;
-    int eye_flag = 0; // 0 == left eye, 1 == right eye
+    std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff, size_t batch_index) const;
 
 
     const double OPNS_THRESH; //0.5693
@@ -27,6 +25,6 @@ private:
 }
 }
 
-std::vector<cv::Mat> get_crops_of_eyes(cv::Mat face, cv::Point2f left_eye, cv::Point2f right_eye);
+std::vector<cv::Mat> get_crops_of_eyes(const cv::Mat& face, cv::Point2f left_eye, cv::Point2f right_eye);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef FACE_ATTRIBUTES_MODULE_H
+#define FACE_ATTRIBUTES_MODULE_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tdv/modules/BaseEstimationModule.h>
+#include <tdv/modules/ProcessingBlock.h>
+#include <tdv/utils/profiler/Profiler.h>
+
+namespace tdv {
+
+namespace modules {
+
+// Runs a set of face attribute estimators as one block:
+// crops of every distinct (crop type, input size) are computed once per face,
+// the estimators process all faces in batches concurrently and their results are written in one pass over the objects.
+// "attributes" - array of the estimator configs, each with "unit_type" and "model_path",
+// the rest of the block config (e.g. "use_cuda", "ONNXRuntime") is shared by all of them.
+class FaceAttributesModule : public ProcessingBlock
+{
+public:
+	FaceAttributesModule(const tdv::data::Context& config);
+	~FaceAttributesModule();
+	virtual void operator ()(tdv::data::Context& data) override;
+
+private:
+	// persistent thread running the tasks of one estimator while the calling thread runs the first estimator
+	struct Worker
+	{
+		// returns an invalid future if the worker is busy with another call
+		std::future<void> run(std::function<void()> task);
+		void loop();
+
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::packaged_task<void()> task;
+		bool busy = false;
+		bool stopped = false;
+		std::thread thread;
+	};
+
+	std::vector<std::unique_ptr<BaseEstimationModule>> estimators;
+	// for the estimators but the first one
+	std::vector<std::unique_ptr<Worker>> workers;
+	tdv::utils::profiler::BlockProfiler profiler;
+};
+
+}
+}
+
+#endif // FACE_ATTRIBUTES_MODULE_H
@@ -2,6 +2,7 @@
 #define FACEREIDENTIFICATOR_H
 
 #include <tdv/modules/ONNXModule.h>
+#include <tdv/utils/alignment/Alignment.h>
 
 namespace tdv {
 
@@ -17,6 +18,11 @@ private:
 	void virtual postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) override;
 	virtual void operator ()(tdv::data::Context& data) override;
 	std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff);
+
+	// reuse crops of other blocks, see tdv::data::cachedCrop
+	const bool useCropCache;
+	// "alignment_method" - "closed_form" or "robust", see tdv::utils::alignment
+	const tdv::utils::alignment::AlignmentMethod alignmentMethod;
 };
 
 
@@ -2,6 +2,7 @@
 #define HPERESNETV1D_H
 
 #include <tdv/modules/ONNXModule.h>
+#include <tdv/utils/heatmap_utils/HeatmapUtils.h>
 
 namespace tdv {
 namespace modules {
@@ -16,12 +17,15 @@ private:
 
 	const bool RAW_OUTPUT;
 	std::map<int, std::string> LABEL_MAP;
+	// "heatmap_refinement" - "none", "quadratic" or "dark"
+	tdv::utils::heatmap_utils::HeatmapParameters heatmapParameters;
 
 	static void getEncriptionKey(int64_t &key_data_len, unsigned char const *&key_data, int model_version=1);
 
 	void preprocess(tdv::data::Context& data) override;
 	void postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) override;
-	std::map<int, std::vector<std::vector<float>>> getOutputData(std::shared_ptr<uint8_t> buff, const tdv::data::Context& meta);
+	// keypoints of all persons as (x, y, score) triplets in image pixels, [persons * joints * 3]
+	std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff, const tdv::data::Context& meta);
 
 };
 
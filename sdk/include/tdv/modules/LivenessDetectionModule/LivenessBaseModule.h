@@ -15,7 +15,7 @@ private:
 	friend class ONNXModule<LivenessBaseModule>;
 	void virtual preprocess(tdv::data::Context& data) override;
 	void virtual postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) override;
-	std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff) const;
+	std::vector<float> getOutputData(std::shared_ptr<uint8_t> buff, size_t batch_index) const;
 
 
 };
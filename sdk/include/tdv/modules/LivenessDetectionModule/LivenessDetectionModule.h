@@ -1,8 +1,15 @@
 #ifndef LIVENESSDETECTOR_H
 #define LIVENESSDETECTOR_H
 
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
 #include <tdv/modules/ONNXModule.h>
 #include <tdv/modules/LivenessDetectionModule/LivenessBaseModule.h>
+#include <tdv/utils/profiler/Profiler.h>
 
 namespace tdv {
 
@@ -12,10 +19,17 @@ class LivenessDetectionModule: public ProcessingBlock
 {
 public:
 	LivenessDetectionModule(const tdv::data::Context& config);
+	~LivenessDetectionModule();
 	void operator()(tdv::data::Context& data);
 private:
 
-	void process(tdv::data::Context& data);
+	void process(tdv::data::Context& data, tdv::utils::profiler::Profile& profile);
+
+	// the second scale model runs on a persistent worker thread while the calling one runs the first,
+	// returns an invalid future if the worker is busy with another call
+	std::future<void> runOnWorker(std::function<void()> task);
+	void runWorker();
+
 	std::shared_ptr<tdv::modules::LivenessBaseModule> model1;
 	std::shared_ptr<tdv::modules::LivenessBaseModule> model2;
 	const float scales[2] = {2.7, 4.0};
@@ -23,6 +37,14 @@ private:
 
 	int curr_face_id;
 	const double LIVENESS_THRESH; //0.9
+	tdv::utils::profiler::BlockProfiler profiler;
+
+	std::mutex workerMutex;
+	std::condition_variable workerCondition;
+	std::packaged_task<void()> workerTask;
+	bool workerBusy = false;
+	bool workerStopped = false;
+	std::thread worker;
 
 };
 
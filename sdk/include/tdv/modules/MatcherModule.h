@@ -11,6 +11,7 @@
 
 
 #include <tdv/modules/ProcessingBlock.h>
+#include <tdv/utils/profiler/Profiler.h>
 
 
 namespace tdv {
@@ -27,6 +28,7 @@ class MatcherModule : public ProcessingBlock
 	private:
 
 		double threshold;
+		tdv::utils::profiler::BlockProfiler profiler;
 		virtual void verifyMatch(tdv::data::Context& data);
 };
 
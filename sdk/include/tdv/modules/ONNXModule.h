@@ -4,9 +4,12 @@
 #include <sys/stat.h>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
+#include <tdv/modules/DynamicBatcher.h>
 #include <tdv/modules/ONNXRuntimeEnvironment.h>
 #include <tdv/modules/ProcessingBlock.h>
+#include <tdv/utils/profiler/Profiler.h>
 
 
 namespace tdv {
@@ -80,8 +83,9 @@ template<typename Derived>
 class ONNXModule : public ProcessingBlock {
 
 public:
+	// defaultBatchSize - batch size of the dynamic batch models if the config has no "batch_size"
 	ONNXModule(const tdv::data::Context& config, 
-		std::shared_ptr<InputAdapter> inputAdapter = std::make_shared<DefaultInputAdapter>());
+		std::shared_ptr<InputAdapter> inputAdapter = std::make_shared<DefaultInputAdapter>(), size_t defaultBatchSize = 1);
 
 	virtual void operator ()(tdv::data::Context& data) override;
 
@@ -90,8 +94,19 @@ protected:
 		return ort_env->getInputShapes();
 	}
 
+	// shapes of the outputs passed to the current postprocess call
 	const std::vector<std::vector<int64_t>>& getOutputShapes() const {
-		return ort_env->getOutputShapes();
+		return callOutputShapes ? *callOutputShapes : ort_env->getOutputShapes();
+	}
+
+	const std::vector<bool>& getDynamicBatchEnabled() const {
+		return ort_env->getDynamicBatchEnabled();
+	}
+
+	// the first input takes uint8 NHWC images, the normalization is a part of the model
+	// (see scripts/quantization/fold_normalization.py), so the resized image is passed as is
+	bool isUint8Input() const {
+		return ort_env->getInputTypes().front() == ONNXTensorElementDataType::ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8;
 	}
 
 	std::vector<int> getOutputTypes() const {
@@ -117,15 +132,23 @@ private:
 	}
 
 	std::unique_ptr<ONNXRuntimeEnvironment> ort_env;
+	std::unique_ptr<DynamicBatcher> batcher;
+	tdv::utils::profiler::BlockProfiler profiler;
 	std::shared_ptr<char> model_buffer;
 	std::shared_ptr<InputAdapter> _inputAdapter;
+
+	static thread_local const std::vector<std::vector<int64_t>>* callOutputShapes;
 };
 
 template<typename Derived>
-ONNXModule<Derived>::ONNXModule(const tdv::data::Context& config, std::shared_ptr<InputAdapter> inputAdapter)
-	: _inputAdapter(inputAdapter)
+thread_local const std::vector<std::vector<int64_t>>* ONNXModule<Derived>::callOutputShapes = nullptr;
+
+template<typename Derived>
+ONNXModule<Derived>::ONNXModule(const tdv::data::Context& config, std::shared_ptr<InputAdapter> inputAdapter, size_t defaultBatchSize)
+	: profiler(config, "ONNX_MODULE"), _inputAdapter(inputAdapter)
 {
-	const std::string filePath = config.at("model_path").get<std::string>();
+	const std::string filePath = ONNXRuntimeEnvironment::getModelPath(config.at("model_path").get<std::string>(),
+		config.get<std::string>("precision", "fp32"), config.get<bool>("uint8_input", false));
 	struct stat sb{};
 	if (!stat(filePath.c_str(), &sb)) {
 		model_buffer = std::shared_ptr<char>(static_cast<char*>(malloc(sb.st_size)), [](void* ptr){free(ptr);});
@@ -149,15 +172,53 @@ ONNXModule<Derived>::ONNXModule(const tdv::data::Context& config, std::shared_pt
 #if defined( ANDROID )
 	modelConfig["use_nnapi"] = config.get<bool>("use_nnapi", false);
 #endif
-	modelConfig["batch_size"] = config.get<size_t>("batch_size", 1UL);
+	modelConfig["batch_size"] = static_cast<size_t>(config.get_as<int64_t>("batch_size", static_cast<int64_t>(defaultBatchSize)));
+	modelConfig["calibration_dir"] = config.get<std::string>("calibration_dir", "");
 
 	ort_env = std::unique_ptr<ONNXRuntimeEnvironment>(new ONNXRuntimeEnvironment(modelConfig));
+
+	// Requests from concurrent calls (e.g. different camera streams) are merged into one inference
+	// when a batching window is set, the queue depth and the batch sizes are reported by the block metrics
+	const double batchingWindow = config.get_as<double>("batching_window_ms", 0.);
+	if (batchingWindow > 0)
+	{
+		const auto &dynamicBatchEnabled = ort_env->getDynamicBatchEnabled();
+		if (std::find(dynamicBatchEnabled.begin(), dynamicBatchEnabled.end(), false) != dynamicBatchEnabled.end())
+			throw std::runtime_error("model input type is static but dynamic batching requested");
+
+		std::vector<size_t> inputElementSizes, outputElementSizes;
+		for (auto type : ort_env->getInputTypes())
+			inputElementSizes.push_back(OrtTypeTraits::tSize(type));
+		for (auto type : ort_env->getOutputTypes())
+			outputElementSizes.push_back(OrtTypeTraits::tSize(type));
+
+		const ONNXRuntimeEnvironment* env = ort_env.get();
+		batcher = std::unique_ptr<DynamicBatcher>(new DynamicBatcher(
+			[env](const std::vector<void*>& input_data, const DynamicBatcher::Shapes& input_shapes, DynamicBatcher::Shapes& output_shapes)
+			{
+				return env->infer(input_data, input_shapes, output_shapes);
+			},
+			inputElementSizes, outputElementSizes,
+			config.get_as<int64_t>("max_batch_size", 32), batchingWindow, profiler.getMetrics()));
+	}
 }
 
 template<typename Derived>
 void ONNXModule<Derived>::operator ()(tdv::data::Context& data) {
+	using tdv::utils::profiler::StageTimer;
+
+	// without own profiling the stages are attributed to the enclosing profiled block, if any
+	tdv::utils::profiler::Profile profile;
+	tdv::utils::profiler::ProfileScope profileScope(profiler.isEnabled() ? &profile : tdv::utils::profiler::Profile::current());
+	tdv::utils::profiler::BlockScope blockScope(profiler, data);
+	if (profiler.isEnabled() && data.isObject())
+		profile.setObject(data.get_as<int64_t>("objects@current_id", -1));
+
 	tdv::data::Context workData;
-	_inputAdapter->convertInput(data, workData);
+	{
+		StageTimer timer("input_adapter");
+		_inputAdapter->convertInput(data, workData);
+	}
 
 	size_t inputShapesSize = getInputShapes().size();
 	const auto &dynamicBatchEnabled = ort_env->getDynamicBatchEnabled();
@@ -166,7 +227,10 @@ void ONNXModule<Derived>::operator ()(tdv::data::Context& data) {
 
 	do
 	{
-		preprocess(workData);
+		{
+			StageTimer timer("preprocess");
+			preprocess(workData);
+		}
 
 		if (workData.find("objects@input") == workData.end())
 			break;
@@ -174,27 +238,62 @@ void ONNXModule<Derived>::operator ()(tdv::data::Context& data) {
 		Context& input_array = workData.at("objects@input");
 
 		std::vector<void*> input_data;
+		std::vector<std::vector<int64_t>> input_shapes = getInputShapes();
+		int64_t requestBatchSize = 1;
 		auto inputsCount = std::min<size_t>(inputShapesSize, input_array.size());
 		for (size_t i = 0; i < inputsCount; ++i)
 		{
 			auto batchSize = input_array[i].get<size_t>("batch_size", 1);
 
 			if (dynamicBatchEnabled[i])
-				ort_env->adjust_batch_size(i, batchSize);
+				input_shapes[i][0] = batchSize;
 			else
 				if (batchSize > 1)
 					throw std::runtime_error("model input type is static but requested dynamic batch");
 
+			requestBatchSize = batchSize;
 			input_data.push_back(input_array[i].at("input_ptr").get<std::shared_ptr<unsigned char>>().get());
 		}
 
-		std::shared_ptr<uint8_t> out_ptr = ort_env->infer(input_data);
+		std::vector<std::vector<int64_t>> output_shapes;
+		std::shared_ptr<uint8_t> out_ptr;
+		{
+			StageTimer timer("inference");
+			out_ptr = batcher ?
+				batcher->infer(input_data, input_shapes, output_shapes) :
+				ort_env->infer(input_data, input_shapes, output_shapes);
+		}
+		// the batcher counts the merged inferences itself
+		if (!batcher)
+			tdv::utils::metrics::BlockMetrics::recordInference(requestBatchSize);
+
+		const auto* previousOutputShapes = callOutputShapes;
+		callOutputShapes = &output_shapes;
+		try
+		{
+			StageTimer timer("postprocess");
+			postprocess(out_ptr, workData);
+		}
+		catch (...)
+		{
+			callOutputShapes = previousOutputShapes;
+			throw;
+		}
+		callOutputShapes = previousOutputShapes;
 
-		postprocess(out_ptr, workData);
 		workData.erase("objects@input");
-	} while (inputTypeIsMultiple);	
+		// a single input may also be split into chunks of objects ("objects@offset" cursor)
+		// or into several batches otherwise, then preprocess sets "@pending" until the last one
+	} while (inputTypeIsMultiple || workData.contains("objects@offset") || workData.get<bool>("@pending", false));
+	workData.erase("objects@offset");
+	workData.erase("@pending");
+
+	{
+		StageTimer timer("output_adapter");
+		_inputAdapter->convertOutput(workData, data);
+	}
 
-	_inputAdapter->convertOutput(workData, data);
+	profiler.write(profile, data);
 }
 
 
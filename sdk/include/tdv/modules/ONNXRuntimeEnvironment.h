@@ -1,6 +1,9 @@
 #ifndef ONNXRuntimeEnvironment_H
 #define ONNXRuntimeEnvironment_H
 
+#include <atomic>
+#include <string>
+
 #include <tdv/modules/ONNXRuntimeAdapter.h>
 
 #include <tdv/data/Context.h>
@@ -55,14 +58,33 @@ public:
 	std::shared_ptr<uint8_t> infer(std::vector<void*> input_data);
 	bool adjust_batch_size(size_t input, int64_t batch_size);
 
+	// Stateless variant: input shapes are passed explicitly and the shapes of the produced outputs
+	// are returned through output_shapes, so it can be called from several threads at once.
+	std::shared_ptr<uint8_t> infer(const std::vector<void*>& input_data,
+		const std::vector<std::vector<int64_t>>& input_shapes,
+		std::vector<std::vector<int64_t>>& output_shapes) const;
+
 	const std::vector<std::vector<int64_t>>& getInputShapes() const;
 	const std::vector<std::vector<int64_t>>& getOutputShapes() const;
+	const std::vector<ONNXTensorElementDataType>& getInputTypes() const;
 	const std::vector<ONNXTensorElementDataType>& getOutputTypes() const;
 	const std::vector<bool>& getDynamicBatchEnabled() const;
 
+	// Path of the model variant by the "precision" config value:
+	// "fp32" - the model itself, "int8" - statically quantized <model>_int8.onnx (see scripts/quantization);
+	// with uint8Input - the variant taking uint8 NHWC images with the normalization in the graph, <model>[_int8]_uint8.onnx
+	static std::string getModelPath(const std::string& modelPath, const std::string& precision, bool uint8Input = false);
+
+	// Ends the onnxruntime profiling ("enable_trace") of every live environment, so their profiles are written
+	// and merged into the following trace dumps without destroying the blocks. The profiling is not resumed,
+	// it must not be called while the blocks infer
+	static void endAllProfiling();
 
 private:
-	void OrtCheckStatus(OrtStatus* status);
+	void endProfiling();
+
+	void OrtCheckStatus(OrtStatus* status) const;
+	void dumpInputs(const std::vector<void*>& input_data, const std::vector<std::vector<int64_t>>& input_shapes) const;
 
 	const OrtApi* ort_api;
 	OrtSessionOptions* session_options;
@@ -82,6 +104,14 @@ private:
 	std::vector<size_t> outputSizes;
 
 	std::vector<bool> dynamic_batch;
+
+	// start of the onnxruntime profiling ("enable_trace") on the trace recorder timeline, -1 if disabled
+	int64_t profilingStartUs = -1;
+
+	// inputs of every inference are written to <calibrationDir>/<call>_<input>.npy ("calibration_dir"),
+	// they are the calibration data of the quantization
+	std::string calibrationDir;
+	mutable std::atomic<uint64_t> calibrationCalls{0};
 };
 
 }  // modules namespace
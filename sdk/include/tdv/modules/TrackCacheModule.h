@@ -0,0 +1,82 @@
+#ifndef TRACK_CACHE_MODULE_H
+#define TRACK_CACHE_MODULE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <tdv/modules/ProcessingBlock.h>
+#include <tdv/utils/profiler/Profiler.h>
+
+
+namespace tdv {
+
+namespace modules {
+
+// Caches the results of per-object blocks (estimators, recognizer, liveness) by obj["track_id"] (TRACKER output),
+// so that the blocks run only on the frames a track needs a refresh. The results of the last samples are
+// aggregated weighted by quality: templates and numbers are averaged, booleans and strings are voted,
+// the rest is taken from the latest sample. Objects without a track id are always processed and not cached.
+// Config:
+//   "blocks" - array of the block configs, created by the API together with the cache and run in order
+//   "refresh_interval_ms" - a track is refreshed at least this often, 0 - never by time
+//   "quality_key" - numeric object value used as the sample quality, "confidence" by default
+//   "quality_gain" - refresh if the quality exceeds the best sample one by this fraction
+//   "pose_threshold" - refresh if the head pose estimated from the eyes and nose keypoints changed more, 0 - never
+//   "max_samples" - number of the latest samples aggregated per track
+//   "max_track_age_ms" - tracks not seen for longer are dropped
+// Input: data["objects"] with "track_id", optional data["stream_id"] and data["timestamp_ms"] (steady clock by default).
+// Output: the aggregated block outputs in the tracked objects, obj["cached"] - whether the blocks were skipped for the object.
+class TrackCacheModule : public ProcessingBlock
+{
+public:
+	TrackCacheModule(const tdv::data::Context& config, std::vector<std::unique_ptr<ProcessingBlock>> blocks);
+	virtual void operator ()(tdv::data::Context& data) override;
+
+private:
+	struct Sample
+	{
+		tdv::data::Context outputs;
+		double quality;
+	};
+
+	struct Entry
+	{
+		std::vector<Sample> samples;
+		tdv::data::Context aggregated;
+		double bestQuality = 0;
+		double lastRefresh = 0;
+		double lastSeen = 0;
+		bool hasPose = false;
+		float pose[2] = {0, 0};
+	};
+
+	using Cache = std::map<int64_t, Entry>;
+
+	bool needsRefresh(const Entry& entry, const tdv::data::Context& obj, double now) const;
+	void addSample(Entry& entry, tdv::data::Context&& outputs, const tdv::data::Context& obj, double now) const;
+	double quality(const tdv::data::Context& obj) const;
+
+	std::vector<std::unique_ptr<ProcessingBlock>> blocks;
+	const double refreshIntervalMs;
+	const std::string qualityKey;
+	const double qualityGain;
+	const float poseThreshold;
+	const size_t maxSamples;
+	const double maxTrackAgeMs;
+
+	std::mutex mutex;
+	std::map<std::string, Cache> caches;
+
+	tdv::utils::profiler::BlockProfiler profiler;
+};
+
+
+}
+
+}
+
+#endif // TRACK_CACHE_MODULE_H
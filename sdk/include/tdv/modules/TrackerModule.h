@@ -0,0 +1,72 @@
+#ifndef TRACKER_MODULE_H
+#define TRACKER_MODULE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <tdv/modules/ProcessingBlock.h>
+#include <tdv/utils/profiler/Profiler.h>
+#include <tdv/utils/tracker_utils/Tracker.h>
+
+
+namespace tdv {
+
+namespace modules {
+
+// Assigns stable track ids to the detected objects of video frames (SORT/ByteTrack style, see tracker_utils::Tracker),
+// one tracker per data["stream_id"]. With a detector block the detection is run only every "detection_interval" frame,
+// on the frames in between the objects are predicted from the tracks.
+// Config:
+//   "detector" - optional detector config, created by the API together with the tracker
+//   "detection_interval" - detection is run at least every N frames
+//   "redetect_confidence" - earlier detection if a track confidence decays below it
+//   "confidence_decay" - factor of a track confidence per predicted frame
+//   "high_threshold", "low_threshold" - score thresholds of the two association stages
+//   "iou_threshold" - minimal similarity of a match
+//   "embedding_weight" - weight of the obj["template"] cosine similarity in the association, 0 - IoU only
+//   "max_lost_frames" - detection frames a track is kept without a match
+// Output: obj["track_id"] for the detections assigned to a track,
+// on the predicted frames data["objects"] are the active tracks with obj["predicted"] = true,
+// data["detection_required"] - whether the next frame of the stream should be detected (for external detectors).
+class TrackerModule : public ProcessingBlock
+{
+public:
+	TrackerModule(const tdv::data::Context& config, std::unique_ptr<ProcessingBlock> detector = nullptr);
+	virtual void operator ()(tdv::data::Context& data) override;
+
+private:
+	struct Stream
+	{
+		explicit Stream(const tdv::utils::tracker_utils::TrackerParameters& parameters) : tracker(parameters) {}
+
+		std::mutex mutex;
+		tdv::utils::tracker_utils::Tracker tracker;
+		int64_t framesSinceDetection = 0;
+		bool detectionRequired = true;
+	};
+
+	Stream& getStream(const std::string& id);
+	void associate(Stream& stream, tdv::data::Context& data) const;
+	void predict(const Stream& stream, tdv::data::Context& data) const;
+	bool isDetectionRequired(const Stream& stream) const;
+
+	std::unique_ptr<ProcessingBlock> detector;
+	tdv::utils::tracker_utils::TrackerParameters parameters;
+	const int64_t detectionInterval;
+	const float redetectConfidence;
+
+	std::mutex mutex;
+	std::map<std::string, std::unique_ptr<Stream>> streams;
+
+	tdv::utils::profiler::BlockProfiler profiler;
+};
+
+
+}
+
+}
+
+#endif // TRACKER_MODULE_H
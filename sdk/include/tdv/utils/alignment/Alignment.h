@@ -0,0 +1,48 @@
+#ifndef TDV_UTILS_ALIGNMENT_H_
+#define TDV_UTILS_ALIGNMENT_H_
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace alignment
+{
+
+enum class AlignmentMethod
+{
+	CLOSED_FORM,	// least squares solution
+	ROBUST			// least squares with reweighting of point pairs by their residuals
+};
+
+AlignmentMethod alignmentMethodFromString(const std::string& method);
+
+struct RobustParameters
+{
+	int maxIterations = 10;		// reweighting iterations
+	float tolerance = 1e-3f;	// stop when the transformed points move less than this, 0 - run all iterations
+};
+
+// Similarity transform (rotation, uniform scale and shift) mapping src points to dst in the least squares sense:
+//    a  b  c
+//   -b  a  d
+// The solution is closed-form (Umeyama), weights are optional per point weights.
+cv::Matx23f estimateSimilarity(const std::vector<cv::Point2f>& src, const std::vector<cv::Point2f>& dst,
+	const std::vector<float>* weights = nullptr);
+
+// Iteratively reweighted least squares, pairs are weighted by 1 / (median residual + residual)
+cv::Matx23f estimateSimilarityRobust(const std::vector<cv::Point2f>& src, const std::vector<cv::Point2f>& dst,
+	const RobustParameters& parameters = RobustParameters());
+
+cv::Matx23f estimateSimilarity(const std::vector<cv::Point2f>& src, const std::vector<cv::Point2f>& dst, AlignmentMethod method);
+
+} // alignment
+} // namespace utils
+} // namespace tdv
+
+#endif // TDV_UTILS_ALIGNMENT_H_
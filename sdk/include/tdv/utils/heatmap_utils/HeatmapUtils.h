@@ -0,0 +1,39 @@
+#ifndef TDV_UTILS_HEATMAP_UTILS_H_
+#define TDV_UTILS_HEATMAP_UTILS_H_
+
+#include <cstddef>
+#include <string>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace heatmap_utils
+{
+
+enum class HeatmapRefinement
+{
+	NONE,		// integer argmax
+	QUADRATIC,	// parabola through the maximum and its neighbours, per axis
+	DARK		// second order Taylor expansion of the log heatmap around the maximum
+};
+
+HeatmapRefinement heatmapRefinementFromString(const std::string& refinement);
+
+struct HeatmapParameters
+{
+	HeatmapRefinement refinement = HeatmapRefinement::DARK;
+};
+
+// Decodes heatmaps of shape [count, height, width] (count = persons * joints) to keypoints:
+// (x, y, score) triplets in heatmap pixel coordinates, the score is the maximum of the heatmap.
+// Decoding is done on the calling thread, a 64x48 heatmap takes a couple of microseconds.
+void decodeHeatmaps(const float* heatmaps, size_t count, size_t height, size_t width,
+	const HeatmapParameters& parameters, float* keypoints);
+
+} // heatmap_utils
+} // namespace utils
+} // namespace tdv
+
+#endif // TDV_UTILS_HEATMAP_UTILS_H_
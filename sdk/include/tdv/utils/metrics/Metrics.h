@@ -0,0 +1,132 @@
+#ifndef TDV_UTILS_METRICS_H_
+#define TDV_UTILS_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <api/Histogram.h>
+#include <tdv/data/Context.h>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace metrics
+{
+
+class Counter
+{
+public:
+	void add(uint64_t value = 1) { count.fetch_add(value, std::memory_order_relaxed); }
+	uint64_t get() const { return count.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> count{0};
+};
+
+// Lock-free log-linear histogram, shared with the public Pipeline statistics (see api::Histogram)
+class Histogram : public api::Histogram
+{
+public:
+	// {"count", "mean", "max", "p50", "p90", "p99", "p999"} with the values multiplied by scale
+	tdv::data::Context toContext(double scale = 1) const;
+};
+
+// Telemetry of a processing block (by unit type), durations are in microseconds
+class BlockMetrics
+{
+public:
+	static const size_t MAX_STAGES = 32;
+
+	explicit BlockMetrics(const std::string& name) : name(name) {}
+
+	const std::string& getName() const { return name; }
+
+	Counter calls;
+	Counter errors;
+	Counter frames;
+	Counter objects;
+	Counter inferences;
+	Histogram latency;
+	Histogram batchSize;
+	// requests in the batching queue after enqueueing, blocks with "batching_window_ms" only (see DynamicBatcher)
+	Histogram queueDepth;
+
+	// stage names are string literals, stages over MAX_STAGES are not recorded
+	void recordStage(const char* stage, uint64_t us);
+
+	tdv::data::Context toContext() const;
+
+	template<typename Function>
+	void forEachStage(Function function) const
+	{
+		for (const Stage& stage : stages)
+		{
+			const char* stageName = stage.name.load(std::memory_order_acquire);
+			if (!stageName)
+				break;
+			function(stageName, stage.latency);
+		}
+	}
+
+	// metrics of the innermost block running on the calling thread, null outside blocks
+	static BlockMetrics* current();
+	static void setCurrent(BlockMetrics* metrics);
+
+	// counts an inference of the given batch size for the current block
+	static void recordInference(int64_t batchSize);
+
+private:
+	struct Stage
+	{
+		std::atomic<const char*> name{nullptr};
+		Histogram latency;
+	};
+
+	const std::string name;
+	std::array<Stage, MAX_STAGES> stages;
+};
+
+// Process wide registry, registration is locked while counting is lock-free
+class MetricsRegistry
+{
+public:
+	static MetricsRegistry& instance();
+
+	// metrics of all blocks of the unit type, the reference is valid until the process exit
+	BlockMetrics& block(const std::string& name);
+
+	// errors by block name and tdv_error code, 0 for other exceptions
+	void recordError(const std::string& block, unsigned int code);
+
+	// {"blocks": {<unit_type>: {"calls", "errors", "frames", "objects", "inferences", "latency_ms", "batch_size", ["queue_depth"], "stages": {...}}},
+	//  "errors": [{"unit_type", "code", "count"}]}
+	tdv::data::Context toContext() const;
+
+	// Prometheus text exposition format
+	std::string toPrometheus() const;
+
+private:
+	MetricsRegistry() = default;
+
+	mutable std::mutex mutex;
+	std::map<std::string, std::unique_ptr<BlockMetrics>> blocks;
+	std::map<std::pair<std::string, unsigned int>, uint64_t> errors;
+};
+
+// Name of the outermost block left by an exception on the calling thread
+const std::string& lastFailedBlock();
+void setLastFailedBlock(const std::string& name);
+
+} // metrics
+} // namespace utils
+} // namespace tdv
+
+#endif // TDV_UTILS_METRICS_H_
@@ -0,0 +1,60 @@
+#ifndef TDV_UTILS_NMS_UTILS_H_
+#define TDV_UTILS_NMS_UTILS_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace nms_utils
+{
+
+// Boxes in (x1, y1, x2, y2) format stored as structure of arrays
+struct Boxes
+{
+	std::vector<float> x1;
+	std::vector<float> y1;
+	std::vector<float> x2;
+	std::vector<float> y2;
+	std::vector<float> scores;
+	std::vector<int> classes;
+
+	void reserve(size_t count);
+	void clear();
+	void push_back(float box_x1, float box_y1, float box_x2, float box_y2, float score, int class_id = 0);
+	size_t size() const { return scores.size(); }
+};
+
+enum class NMSMethod
+{
+	HARD,
+	SOFT_LINEAR,
+	SOFT_GAUSSIAN
+};
+
+NMSMethod nmsMethodFromString(const std::string& method);
+
+struct NMSParameters
+{
+	float iouThreshold = 0.5f;
+	float scoreThreshold = 0.f;	// boxes with lower (decayed for soft-NMS) score are dropped
+	int topK = 0;				// number of best candidates taken into account, 0 - all
+	bool classAware = false;	// suppress only boxes of the same class
+	NMSMethod method = NMSMethod::HARD;
+	float sigma = 0.5f;			// soft gaussian NMS parameter
+};
+
+// Returns indices of the kept boxes in descending score order.
+// For soft-NMS the decayed scores of the kept boxes are written to scores (if not null),
+// for the hard method scores are copied from the input.
+std::vector<int> nms(const Boxes& boxes, const NMSParameters& parameters, std::vector<float>* scores = nullptr);
+
+} // nms_utils
+} // namespace utils
+} // namespace tdv
+
+#endif // TDV_UTILS_NMS_UTILS_H_
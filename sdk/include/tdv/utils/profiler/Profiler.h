@@ -0,0 +1,171 @@
+#ifndef TDV_UTILS_PROFILER_H_
+#define TDV_UTILS_PROFILER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tdv/data/Context.h>
+#include <tdv/utils/metrics/Metrics.h>
+#include <tdv/utils/profiler/Trace.h>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace profiler
+{
+
+// Stage timings of a single block call
+class Profile
+{
+public:
+	using Stages = std::vector<std::pair<std::string, double>>;
+
+	void add(const std::string& stage, double ms);
+
+	// adds the stages of another profile, its totals are also attributed to the current object
+	void merge(const Profile& other);
+
+	// following stages are also attributed to the object with the given id, -1 - to none
+	void setObject(int64_t id) { object = id; }
+
+	const Stages& getStages() const { return stages; }
+	const std::map<int64_t, Stages>& getObjects() const { return objects; }
+
+	// Profile active on the current thread, null if profiling is disabled
+	static Profile* current();
+
+private:
+	friend class ProfileScope;
+
+	Stages stages;
+	std::map<int64_t, Stages> objects;
+	int64_t object = -1;
+};
+
+// Makes the profile current for the calling thread, the previous one is restored on destruction
+class ProfileScope
+{
+public:
+	explicit ProfileScope(Profile* profile);
+	~ProfileScope();
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	Profile* previous;
+};
+
+// Profile and metrics of the calling block carried to a task run on another thread (e.g. a persistent worker):
+// Scope makes them current on the task thread, merge() adds the task stages to the caller profile once the task is done
+class TaskProfile
+{
+public:
+	TaskProfile();
+
+	class Scope
+	{
+	public:
+		explicit Scope(TaskProfile& task);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		ProfileScope profileScope;
+		tdv::utils::metrics::BlockMetrics* const previous;
+	};
+
+	void merge();
+
+	TaskProfile(const TaskProfile&) = delete;
+	TaskProfile& operator=(const TaskProfile&) = delete;
+
+private:
+	Profile* const parent;
+	tdv::utils::metrics::BlockMetrics* const metrics;
+	Profile profile;
+};
+
+// Adds the time elapsed until destruction to the current profile and the stage metrics of the current block,
+// records it as a trace span (see Trace.h). Does nothing outside blocks without a profile while the trace recorder is stopped
+class StageTimer
+{
+public:
+	explicit StageTimer(const char* stage);
+	~StageTimer();
+
+	// records the stage before the end of the scope
+	void stop();
+
+	StageTimer(const StageTimer&) = delete;
+	StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+	Profile* profile;
+	tdv::utils::metrics::BlockMetrics* metrics;
+	const char* stage;
+	bool traced;
+	std::chrono::steady_clock::time_point start;
+};
+
+// Profiling of a processing block configured by
+// "enable_profiling" - record stage timings to data["@profile"][<unit_type>]
+// "profiling_histograms" - also output the stage histograms of the block metrics (see BlockMetrics::recordStage)
+// to data["@profile"][<unit_type>]["histograms"], in the format of the metrics snapshot in milliseconds
+class BlockProfiler
+{
+public:
+	BlockProfiler(const tdv::data::Context& config, const std::string& defaultName);
+
+	bool isEnabled() const { return enabled; }
+
+	// block name for trace spans
+	const char* getTraceName() const { return traceName; }
+
+	// metrics shared by all blocks of the unit type
+	tdv::utils::metrics::BlockMetrics& getMetrics() const { return metrics; }
+
+	// Accumulates the profile into data["@profile"][name]: totals in "stages", per object timings in "objects"
+	void write(const Profile& profile, tdv::data::Context& data);
+
+private:
+	const bool enabled;
+	const bool histogramsEnabled;
+	const std::string name;
+	const char* const traceName;
+	tdv::utils::metrics::BlockMetrics& metrics;
+};
+
+// Block call: trace span, makes the block metrics current for the calling thread and counts the call,
+// its latency, frames and objects of the data or the failure on destruction.
+// Calls nested into a block of the same unit type (e.g. inference of an estimator) are not counted twice
+class BlockScope
+{
+public:
+	BlockScope(const BlockProfiler& profiler, const tdv::data::Context& data);
+	~BlockScope();
+
+	BlockScope(const BlockScope&) = delete;
+	BlockScope& operator=(const BlockScope&) = delete;
+
+private:
+	TraceSpan traceSpan;
+	const tdv::data::Context& data;
+	tdv::utils::metrics::BlockMetrics& metrics;
+	tdv::utils::metrics::BlockMetrics* const previous;
+	const std::chrono::steady_clock::time_point start;
+};
+
+} // profiler
+} // namespace utils
+} // namespace tdv
+
+#endif // TDV_UTILS_PROFILER_H_
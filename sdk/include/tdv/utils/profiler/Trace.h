@@ -0,0 +1,80 @@
+#ifndef TDV_UTILS_TRACE_H_
+#define TDV_UTILS_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace profiler
+{
+
+// Process wide timeline of spans in Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+// Every thread records into its own ring buffer keeping the last spans, the buffers of exited threads
+// are taken over by new ones. While stopped a span costs one relaxed atomic load.
+class TraceRecorder
+{
+public:
+	static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	// clears the recorded spans and starts recording, every thread keeps the last eventsPerThread spans
+	static void start(size_t eventsPerThread = 65536);
+	static void stop();
+
+	// microseconds since the process start
+	static int64_t now();
+	static int64_t toMicroseconds(std::chrono::steady_clock::time_point time);
+
+	// name and category must outlive the recorder: string literals or intern() results
+	static void record(const char* name, const char* category, int64_t startUs, int64_t endUs, int64_t object = -1);
+	static const char* intern(const std::string& name);
+
+	// events of another chrome trace file (e.g. onnxruntime profile) with timestamps relative to offsetUs,
+	// they are added to the following dumps
+	static void addExternalTrace(const std::string& path, int64_t offsetUs);
+
+	// {"traceEvents": [...]} with the spans of all threads and the external traces
+	static std::string toChromeTrace();
+	static void dump(const std::string& path);
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+// Records the time until destruction as a span if the recorder is started
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char* name, const char* category = "sdk", int64_t object = -1) :
+		name(TraceRecorder::isEnabled() ? name : nullptr),
+		category(category),
+		object(object),
+		start(this->name ? TraceRecorder::now() : 0)
+	{}
+
+	~TraceSpan()
+	{
+		if (name)
+			TraceRecorder::record(name, category, start, TraceRecorder::now(), object);
+	}
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+	const char* name;
+	const char* category;
+	const int64_t object;
+	const int64_t start;
+};
+
+} // profiler
+} // namespace utils
+} // namespace tdv
+
+#endif // TDV_UTILS_TRACE_H_
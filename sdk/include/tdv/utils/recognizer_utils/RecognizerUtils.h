@@ -1,8 +1,11 @@
 #ifndef TDV_DATA_RECOGNIZER_UTILS_H_
 #define TDV_DATA_RECOGNIZER_UTILS_H_
 
+#include <string>
+
 #include <opencv2/core/mat.hpp>
 #include <tdv/data/Context.h>
+#include <tdv/utils/alignment/Alignment.h>
 
 
 namespace tdv
@@ -12,10 +15,24 @@ namespace utils
 namespace recognizer_utils
 {
 
-cv::Matx23f makeCrop2ImageByPoints(const tdv::data::Context& fitter, cv::Mat& image, const int base_crop_size);
+// Form of the fitter landmarks in obj["keypoints"], configured by "landmarks_output"
+enum class LandmarksOutput
+{
+	VERBOSE,	// "verbose": "points" as an array of {"x", "y", "z"} and the named FDA points
+	COMPACT,	// "compact": "points" as a float NDARRAY of shape [N, 3] and the named FDA points
+	FDA			// "fda": only the named FDA points
+};
+
+LandmarksOutput landmarksOutputFromString(const std::string& output);
+
+// fitter["points"] may be in any of the forms above, without them the named FDA points are used
+cv::Matx23f makeCrop2ImageByPoints(const tdv::data::Context& fitter, const cv::Mat& image, const int base_crop_size,
+	alignment::AlignmentMethod method = alignment::AlignmentMethod::CLOSED_FORM);
 
-void warpAffine(cv::Mat &src, cv::Mat &dst, const cv::Matx23f &transform_m_input_, const cv::Size &dsize);
+void warpAffine(const cv::Mat &src, cv::Mat &dst, const cv::Matx23f &transform_m_input_, const cv::Size &dsize);
 void constructFdaPonints2Context(tdv::data::Context& fitter);
+// same, but the points are read from x, y, z triplets instead of fitter["points"]
+void constructFdaPonints2Context(tdv::data::Context& fitter, const float* points);
 
 } // recognizer_utils
 } // namespace utils
@@ -0,0 +1,93 @@
+#ifndef TDV_UTILS_TRACKER_UTILS_H_
+#define TDV_UTILS_TRACKER_UTILS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace tracker_utils
+{
+
+// Constant velocity Kalman filter of one box coordinate, the noise is relative to the box height as in SORT/ByteTrack
+class KalmanFilter1D
+{
+public:
+	void init(float position, float height);
+	void predict(float height);
+	void update(float position, float height);
+
+	float position() const { return x[0]; }
+
+private:
+	float x[2] = {0, 0};			// position, velocity
+	float p[2][2] = {{0, 0}, {0, 0}};	// covariance
+};
+
+struct Detection
+{
+	float x1, y1, x2, y2;
+	float score;
+	std::string label;
+	const std::vector<float>* embedding = nullptr;	// optional appearance template
+};
+
+struct Track
+{
+	int64_t id;
+	std::string label;
+	KalmanFilter1D filters[4];	// center x, center y, width, height
+	float score;				// score of the last matched detection
+	float confidence;			// score decayed on every frame without detection
+	int hits = 1;
+	int lostFrames = 0;			// detection frames without a match
+	bool active = true;			// matched on the last detection frame
+	std::vector<float> embedding;	// unit length, averaged over the matches
+
+	void box(float& x1, float& y1, float& x2, float& y2) const;
+};
+
+struct TrackerParameters
+{
+	float highThreshold = 0.5f;		// detections starting tracks and matched first
+	float lowThreshold = 0.1f;		// lower scored detections are dropped, the rest only continue tracks
+	float matchThreshold = 0.3f;	// minimal similarity (IoU, mixed with the template one) of a match
+	float embeddingWeight = 0.f;	// weight of the template cosine similarity, 0 - IoU only
+	float embeddingMomentum = 0.9f;
+	int maxLostFrames = 30;			// detection frames a track is kept without a match
+	float confidenceDecay = 0.9f;	// factor of the track confidence per predicted frame
+};
+
+// SORT/ByteTrack style multi-object tracker: Kalman filtered boxes, two stage greedy association
+// (high score detections first, then the low score ones with the remaining tracks) on IoU and optionally templates
+class Tracker
+{
+public:
+	explicit Tracker(const TrackerParameters& parameters);
+
+	// moves the tracks to the next frame, call once per frame before update
+	void predict();
+	// associates the detections of the current frame, returns the track id per detection, -1 for dropped ones
+	std::vector<int64_t> update(const std::vector<Detection>& detections);
+
+	const std::vector<Track>& getTracks() const { return tracks; }
+
+private:
+	void match(const std::vector<Detection>& detections, const std::vector<size_t>& candidates,
+		std::vector<bool>& trackMatched, std::vector<int64_t>& result);
+
+	const TrackerParameters parameters;
+	std::vector<Track> tracks;
+	int64_t nextId = 0;
+};
+
+} // tracker_utils
+} // namespace utils
+} // namespace tdv
+
+#endif // TDV_UTILS_TRACKER_UTILS_H_
@@ -180,13 +180,19 @@ void demoBody(api::Service& service, const std::string& input_image_path, const
 
 		api::ProcessingBlock bodyReidentification = service.createProcessingBlock(bodyReidCtx);
 
+		// the template of the whole image, with objects every body gets its own "template"
+		Context reidData = service.createContext();
+		reidData["image"] = imgCtx;
+
 		///////////Reidentification////////////////
 		{
 			Timer timer("BODY_RE_IDENTIFICATION");
 
-			bodyReidentification(ioData);
+			bodyReidentification(reidData);
 		}
 		///////////////////////////////////////////
+
+		ioData["output_data"] = reidData["output_data"];
 	}
 	else if (mode == "pose") {
 		Context poseCtx = service.createContext(); // create config Context for PoseEstimator ProcessingBlock
@@ -0,0 +1,156 @@
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include <api/FrameSource.h>
+#include <api/Pipeline.h>
+#include <api/Service.h>
+
+#include "ConsoleArgumentsParser.h"
+
+using Context = api::Context;
+
+/**
+ * @brief Parse backpressure name
+ * 
+ * @param name One of block, drop_oldest, drop_newest
+ * @return api::Backpressure 
+ */
+api::Backpressure backpressureFromString(const std::string& name);
+
+/**
+ * @brief Demonstration function: face detection with tracking, fitting and age/gender estimation once per track
+ * on the images of the folder as video frames
+ * 
+ * @param service Service from api::Service::createService(sdk_dir)
+ * @param input_folder Path to the folder with frames
+ * @param parser Console arguments
+ */
+void demoVideo(api::Service& service, const std::string& input_folder, ConsoleArgumentsParser& parser);
+
+/**
+ * @brief Print pipeline statistics
+ * 
+ * @param statistics Result of api::Pipeline::getStatistics
+ */
+void printStatistics(Context& statistics);
+
+int main(int argc, char** argv)
+{
+	std::cout << "usage: " << argv[0] <<
+		" [--input_folder <path to folder with frames>]"
+		" [--sdk_path ..]"
+		" [--detection_interval 5]"
+		" [--backpressure block | drop_oldest | drop_newest]"
+		" [--queue_size 4]"
+		" [--fps 25]"
+		" [--output <yes/no>]"
+		<< std::endl;
+
+	ConsoleArgumentsParser parser(argc, argv);
+
+	const std::string input_folder	= parser.get<std::string>("--input_folder");
+	const std::string sdk_dir		= parser.get<std::string>("--sdk_path", "..");
+
+	api::Service service = api::Service::createService(sdk_dir);
+
+	try {
+		demoVideo(service, input_folder, parser);
+	}
+	catch (const std::exception& e) {
+		std::cout << "! exception catched: '" << e.what() << "' ... exiting" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+api::Backpressure backpressureFromString(const std::string& name)
+{
+	if (name == "block")
+		return api::Backpressure::BLOCK;
+	if (name == "drop_oldest")
+		return api::Backpressure::DROP_OLDEST;
+	if (name == "drop_newest")
+		return api::Backpressure::DROP_NEWEST;
+	throw std::invalid_argument("Incorrect backpressure: " + name);
+}
+
+void demoVideo(api::Service& service, const std::string& input_folder, ConsoleArgumentsParser& parser)
+{
+	const int detection_interval		= parser.get<int>("--detection_interval", 5);
+	const std::string backpressure		= parser.get<std::string>("--backpressure", "block");
+	const int queue_size				= parser.get<int>("--queue_size", 4);
+	const double fps					= parser.get<double>("--fps", 25);
+	const bool output					= parser.get<std::string>("--output", "yes") == "yes";
+
+	// the tracker runs the detector every detection_interval frames and predicts the faces in between
+	Context trackerCtx = service.createContext();
+	trackerCtx["unit_type"] = "TRACKER";
+	trackerCtx["detection_interval"] = static_cast<int64_t>(detection_interval);
+	trackerCtx["detector"]["unit_type"] = "FACE_DETECTOR";
+	api::ProcessingBlock tracker = service.createProcessingBlock(trackerCtx);
+
+	Context fitterCtx = service.createContext();
+	fitterCtx["unit_type"] = "FITTER";
+	api::ProcessingBlock fitter = service.createProcessingBlock(fitterCtx);
+
+	// estimators run once per track refresh instead of every frame
+	Context cacheCtx = service.createContext();
+	cacheCtx["unit_type"] = "TRACK_CACHE";
+	for (const std::string unit_type : {"AGE_ESTIMATOR", "GENDER_ESTIMATOR"})
+	{
+		Context estimatorCtx = service.createContext();
+		estimatorCtx["unit_type"] = unit_type;
+		cacheCtx["blocks"].push_back(estimatorCtx);
+	}
+	api::ProcessingBlock estimators = service.createProcessingBlock(cacheCtx);
+
+	api::Pipeline pipeline(service, queue_size, backpressureFromString(backpressure));
+	pipeline
+		.addStage("TRACKER", [&tracker](Context& data) { tracker(data); })
+		.addStage("FITTER", [&fitter](Context& data) { fitter(data); })
+		.addStage("TRACK_CACHE", [&estimators](Context& data) { estimators(data); })
+		.setSink([output](Context& data)
+		{
+			if (!output)
+				return;
+			std::cout << "frame " << data["frame"].getLong() << ":";
+			for (const Context& obj : data["objects"])
+			{
+				// low score detections not continuing a track are left without id
+				if (!obj.contains("track_id"))
+					continue;
+				std::cout << " [track " << obj["track_id"].getLong();
+				if (obj.contains("age"))
+					std::cout << ", age " << obj["age"].getLong() << ", " << obj["gender"].getString();
+				if (obj.contains("predicted"))
+					std::cout << ", predicted";
+				std::cout << "]";
+			}
+			std::cout << std::endl;
+		});
+
+	api::ImageFolderSource source(input_folder, fps);
+	pipeline.run(source);
+
+	Context statistics = pipeline.getStatistics();
+	printStatistics(statistics);
+}
+
+void printStatistics(Context& statistics)
+{
+	std::cout << "delivered frames: " << statistics["delivered"].getLong()
+		<< ", end to end p50 " << statistics["end_to_end_ms"]["p50"].getDouble() << " ms"
+		<< ", p99 " << statistics["end_to_end_ms"]["p99"].getDouble() << " ms" << std::endl;
+	for (const Context& stage : statistics["stages"])
+	{
+		std::cout << stage["name"].getString()
+			<< ": processed " << stage["processed"].getLong()
+			<< ", dropped " << stage["dropped"].getLong()
+			<< ", errors " << stage["errors"].getLong()
+			<< ", max queue depth " << stage["max_queue_depth"].getLong()
+			<< ", mean latency " << stage["latency_ms"]["mean"].getDouble() << " ms"
+			<< ", p95 wait " << stage["wait_ms"]["p95"].getDouble() << " ms" << std::endl;
+	}
+}
@@ -139,6 +139,7 @@ namespace ApiTest
             Dictionary<object, object> imgCtx = new Dictionary<object, object>();
             MatToBsm(ref imgCtx, input_image);
             Context ioData = service.CreateContext(new Dictionary<object, object> { { "image", imgCtx } });
+            Context reidData = null;
             
             ///////////Detector////////////////
             bodyDetector.Invoke(ioData);
@@ -151,8 +152,11 @@ namespace ApiTest
 
                 ProcessingBlock bodyReidentification = service.CreateProcessingBlock(bodyReidCtx);
                 
+                // the template of the whole image, with objects every body gets its own "template"
+                reidData = service.CreateContext(new Dictionary<object, object> { { "image", imgCtx } });
+
                 ///////////Reidentification////////////////
-                bodyReidentification.Invoke(ioData);
+                bodyReidentification.Invoke(reidData);
                 ///////////////////////////////////////////
             }
             else if (mode == "pose")
@@ -167,7 +171,7 @@ namespace ApiTest
                 ////////////////////////////////////
             }
 
-            DisplayResultInWindow(ioData, image, mode, output);
+            DisplayResultInWindow(ioData, reidData, image, mode, output);
         }
 
         /**
@@ -194,11 +198,12 @@ namespace ApiTest
          * Display results in separate window
          *
          * @param ioData ProcessingBlock infer data
+         * @param reidData BODY_RE_IDENTIFICATION output for the whole image, null in other modes
          * @param image Source image
          * @param mode One of reidentification, pose
          * @param output Print results in standard output
         */
-        static void DisplayResultInWindow(Context ioData, Mat image, string mode, string output)
+        static void DisplayResultInWindow(Context ioData, Context reidData, Mat image, string mode, string output)
         {
             for (int i = 0; i < (int)ioData["objects"].GetLength(); i++)
             {
@@ -230,7 +235,7 @@ namespace ApiTest
 
             if (mode == "reidentification")
             {
-                Context outputData = ioData["output_data"];
+                Context outputData = reidData["output_data"];
                 Context templateData = outputData["template"];
                 ulong templateSize = outputData["template_size"].GetUnsignedLong();
                 string resultFileName = Path.GetFileNameWithoutExtension(inputImagePath) + ".txt";
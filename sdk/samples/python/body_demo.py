@@ -97,8 +97,11 @@ def detector_demo(sdk_path, img_path, mode, output):
         # create processing block
         reidentification_detector = service.create_processing_block({"unit_type": "BODY_RE_IDENTIFICATION"})
 
+        # the template of the whole image, with objects every body gets its own "template"
+        reid_data = service.create_context({"image": imgCtx})
+
         ###########Reidentification################
-        reidentification_detector(ioData)
+        reidentification_detector(reid_data)
         ###########################################
 
     color = (0, 255, 0)
@@ -125,7 +128,7 @@ def detector_demo(sdk_path, img_path, mode, output):
                 cv2.circle(img, (x, y), 3, (0, 0, 255), -1, 0)
 
     if mode == "reidentification":
-        output_data = ioData["output_data"]
+        output_data = reid_data["output_data"]
         template_data = output_data["template"]
         template_size = int(output_data["template_size"].get_value())
         template_name = os.path.splitext(os.path.basename(img_path))[0] + ".txt"
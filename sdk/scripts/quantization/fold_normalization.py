@@ -0,0 +1,152 @@
+"""
+uint8 input variants of the SDK models
+
+Prepends the preprocessing of the SDK blocks (cast to float, NHWC -> NCHW, scale, mean and std) to the model graph,
+so the model takes the resized uint8 NHWC image and the SDK skips the float conversion and normalization on the host:
+<model>.onnx -> <model>_uint8.onnx, with --int8 <model>_int8.onnx -> <model>_int8_uint8.onnx.
+Blocks load them with {"uint8_input": true} in the config.
+"""
+import argparse
+import os
+from typing import List, Tuple
+
+import numpy as np
+import onnx
+import onnxruntime
+from onnx import TensorProto, helper, numpy_helper
+
+import face_sdk
+from face_sdk.modules.models import make_model_paths
+
+# scale, mean and std of the SDK preprocessing: (image * scale - mean) / std
+NORMALIZATION = {
+    "FACE_DETECTOR": (1 / 255, 0.0, 1.0),
+    "HUMAN_BODY_DETECTOR": (1 / 255, 0.0, 1.0),
+    "FITTER": (1 / 255, 0.0, 1.0),
+    "FACE_RECOGNIZER": (1.0, 0.0, 1.0),
+    "AGE_ESTIMATOR": (1 / 255, 0.5, 0.5),
+    "GENDER_ESTIMATOR": (1 / 255, 0.5, 0.5),
+    "EMOTION_ESTIMATOR": (1 / 255, 0.5, 0.5),
+    "MASK_ESTIMATOR": (1 / 255, 0.5, 0.5),
+}
+
+
+def variant_path(model_path: str, int8: bool) -> Tuple[str, str]:
+    base = os.path.splitext(model_path)[0] + ("_int8" if int8 else "")
+
+    return base + ".onnx", base + "_uint8.onnx"
+
+
+def rename_input(graph: onnx.GraphProto, old: str, new: str):
+    for node in graph.node:
+        node.input[:] = [new if name == old else name for name in node.input]
+
+        for attribute in node.attribute:
+            if attribute.HasField("g"):
+                rename_input(attribute.g, old, new)
+
+            for subgraph in attribute.graphs:
+                rename_input(subgraph, old, new)
+
+    for output in graph.output:
+        if output.name == old:
+            raise Exception(f"input {old} is a graph output")
+
+
+def dimension(dim: onnx.TensorShapeProto.Dimension):
+    if dim.HasField("dim_value"):
+        return dim.dim_value
+
+    return dim.dim_param if dim.HasField("dim_param") else None
+
+
+def fold(input_path: str, output_path: str, scale: float, mean: float, std: float):
+    model = onnx.load(input_path)
+    graph = model.graph
+
+    initializers = {initializer.name for initializer in graph.initializer}
+    graph_input = [value for value in graph.input if value.name not in initializers][0]
+    if graph_input.type.tensor_type.elem_type != TensorProto.FLOAT:
+        raise Exception(f"{input_path}: the first input is not float")
+
+    batch, channels, height, width = [dimension(dim) for dim in graph_input.type.tensor_type.shape.dim]
+    if not all(isinstance(value, int) for value in (channels, height, width)):
+        raise Exception(f"{input_path}: channels and image size of the input must be static")
+
+    name = graph_input.name
+    normalized = name + "_normalized"
+    rename_input(graph, name, normalized)
+
+    nodes = [
+        helper.make_node("Cast", [name], [name + "_float"], to=TensorProto.FLOAT),
+        helper.make_node("Transpose", [name + "_float"], [name + "_nchw"], perm=[0, 3, 1, 2]),
+    ]
+    current = name + "_nchw"
+
+    if scale / std != 1:
+        graph.initializer.append(numpy_helper.from_array(np.array(scale / std, dtype=np.float32), name + "_scale"))
+        nodes.append(helper.make_node("Mul", [current, name + "_scale"], [name + "_scaled"]))
+        current = name + "_scaled"
+
+    if mean != 0:
+        graph.initializer.append(numpy_helper.from_array(np.array(-mean / std, dtype=np.float32), name + "_shift"))
+        nodes.append(helper.make_node("Add", [current, name + "_shift"], [name + "_shifted"]))
+        current = name + "_shifted"
+
+    nodes[-1].output[0] = normalized
+
+    for node in reversed(nodes):
+        graph.node.insert(0, node)
+
+    graph_input.CopyFrom(helper.make_tensor_value_info(name, TensorProto.UINT8, [batch, height, width, channels]))
+
+    onnx.checker.check_model(model)
+    onnx.save(model, output_path)
+
+
+def check(input_path: str, output_path: str, scale: float, mean: float, std: float) -> List[float]:
+    """
+    Max absolute differences of the outputs on a random image, the reference gets the SDK preprocessing
+    """
+    reference = onnxruntime.InferenceSession(input_path, providers=["CPUExecutionProvider"])
+    folded = onnxruntime.InferenceSession(output_path, providers=["CPUExecutionProvider"])
+
+    shape = folded.get_inputs()[0].shape
+    image = np.random.default_rng(0).integers(0, 256, size=[1] + shape[1:], dtype=np.uint8)
+    blob = ((image.astype(np.float32) * scale - mean) / std).transpose(0, 3, 1, 2)
+
+    reference_outputs = reference.run(None, {reference.get_inputs()[0].name: blob})
+    folded_outputs = folded.run(None, {folded.get_inputs()[0].name: image})
+
+    return [float(np.abs(first.astype(np.float64) - second.astype(np.float64)).max(initial=0))
+            for first, second in zip(reference_outputs, folded_outputs)]
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description="uint8 input variants of the SDK models")
+    parser.add_argument("--sdk_path", default="", help="Path to directory with data/models, the package folder by default")
+    parser.add_argument("--unit_types", nargs="+", default=list(NORMALIZATION.keys()), choices=list(NORMALIZATION.keys()))
+    parser.add_argument("--int8", action="store_true", help="Fold the quantized <model>_int8.onnx models")
+
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+    sdk_path = args.sdk_path or os.path.dirname(os.path.abspath(face_sdk.__file__))
+
+    for unit_type in args.unit_types:
+        input_path, output_path = variant_path(make_model_paths(sdk_path, unit_type)[0], args.int8)
+        if not os.path.exists(input_path):
+            print(f"{unit_type}: {input_path} not found")
+
+            continue
+
+        fold(input_path, output_path, *NORMALIZATION[unit_type])
+        deviations = check(input_path, output_path, *NORMALIZATION[unit_type])
+
+        print(f"{unit_type}: {output_path}, max output deviation {max(deviations):.3g}")
+
+
+if __name__ == "__main__":
+    main()
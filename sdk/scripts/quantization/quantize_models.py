@@ -0,0 +1,354 @@
+"""
+Static int8 quantization of the SDK models
+
+calibrate - runs the SDK blocks over a folder of calibration images with "calibration_dir" set, so the model
+            inputs are produced by the SDK preprocessing itself, and builds QDQ <model>_int8.onnx next to
+            the fp32 models. Blocks load them with {"precision": "int8"} in the config.
+report    - runs the fp32 and int8 variants of the blocks on the same detections of the test images
+            and reports the output deviations and the inference speed
+"""
+import argparse
+import glob
+import json
+import os
+import shutil
+import sys
+import tempfile
+import time
+from typing import Dict, List
+
+import cv2
+import numpy as np
+import onnxruntime
+from onnxruntime.quantization import CalibrationDataReader, CalibrationMethod, QuantFormat, QuantType, quantize_static
+
+from face_sdk import Service
+from face_sdk.modules.context import Context
+from face_sdk.modules.models import make_model_paths
+
+# blocks producing the input of the quantized block
+PIPELINES = {
+    "FACE_DETECTOR": [],
+    "FITTER": ["FACE_DETECTOR"],
+    "FACE_RECOGNIZER": ["FACE_DETECTOR", "FITTER"],
+    "AGE_ESTIMATOR": ["FACE_DETECTOR", "FITTER"],
+    "GENDER_ESTIMATOR": ["FACE_DETECTOR", "FITTER"],
+    "EMOTION_ESTIMATOR": ["FACE_DETECTOR", "FITTER"],
+    "MASK_ESTIMATOR": ["FACE_DETECTOR", "FITTER"],
+    "GLASSES_ESTIMATOR": ["FACE_DETECTOR", "FITTER"],
+    "EYE_OPENNESS_ESTIMATOR": ["FACE_DETECTOR", "FITTER"],
+    "HUMAN_BODY_DETECTOR": [],
+    "BODY_RE_IDENTIFICATION": ["HUMAN_BODY_DETECTOR"],
+}
+
+IMAGE_EXTENSIONS = (".jpg", ".jpeg", ".png", ".bmp")
+
+# numeric arrays of at least this length are compared as vectors (templates, embeddings)
+VECTOR_LENGTH = 64
+
+
+class NpyCalibrationReader(CalibrationDataReader):
+    """
+    Inputs dumped by ONNXRuntimeEnvironment: <call>_<input index>.npy
+    """
+    def __init__(self, directory: str, input_names: List[str]):
+        calls: Dict[str, Dict[str, str]] = dict()
+
+        for path in sorted(glob.glob(os.path.join(directory, "*.npy"))):
+            call, index = os.path.splitext(os.path.basename(path))[0].split("_")
+            calls.setdefault(call, dict())[input_names[int(index)]] = path
+
+        self.calls = list(calls.values())
+        self.position = 0
+
+    def __len__(self):
+        return len(self.calls)
+
+    def get_next(self):
+        if self.position >= len(self.calls):
+            return None
+
+        call = self.calls[self.position]
+        self.position += 1
+
+        return {name: np.load(path) for name, path in call.items()}
+
+    def rewind(self):
+        self.position = 0
+
+
+def list_images(path: str, limit: int) -> List[str]:
+    images = sorted(image for image in glob.glob(os.path.join(path, "**", "*"), recursive=True)
+                    if image.lower().endswith(IMAGE_EXTENSIONS))
+    if not images:
+        raise Exception(f"no images in {path}")
+
+    return images[:limit] if limit > 0 else images
+
+
+def image_to_sdk_form(service: Service, path: str) -> Context:
+    image = cv2.cvtColor(cv2.imread(path, cv2.IMREAD_COLOR), cv2.COLOR_BGR2RGB)
+    image_context = {"blob": image.tobytes(), "dtype": "uint8_t", "format": "NDARRAY",
+                     "shape": [dim for dim in image.shape]}
+
+    return service.create_context({"image": image_context})
+
+
+def int8_model_path(model_path: str) -> str:
+    return os.path.splitext(model_path)[0] + "_int8.onnx"
+
+
+def calibrate(service: Service, sdk_path: str, unit_type: str, images: List[str], args):
+    model_path = make_model_paths(sdk_path, unit_type)[0]
+    output_path = int8_model_path(model_path)
+    dump_dir = tempfile.mkdtemp(prefix="calibration_")
+
+    try:
+        blocks = [service.create_processing_block({"unit_type": block}) for block in PIPELINES[unit_type]]
+        blocks.append(service.create_processing_block({"unit_type": unit_type, "calibration_dir": dump_dir}))
+
+        for image in images:
+            data = image_to_sdk_form(service, image)
+
+            for block in blocks:
+                block(data)
+
+        input_names = [model_input.name for model_input in onnxruntime.InferenceSession(
+            model_path, providers=["CPUExecutionProvider"]).get_inputs()]
+        reader = NpyCalibrationReader(dump_dir, input_names)
+        if not len(reader):
+            raise Exception("no model inputs on the calibration images")
+
+        print(f"{unit_type}: {len(reader)} calibration batches from {len(images)} images")
+
+        quantize_static(
+            model_path,
+            output_path,
+            reader,
+            quant_format=QuantFormat.QDQ,
+            activation_type=QuantType.QUInt8,
+            weight_type=QuantType.QInt8,
+            per_channel=not args.per_tensor,
+            calibrate_method=CalibrationMethod.Percentile if args.percentile else CalibrationMethod.MinMax,
+        )
+    finally:
+        shutil.rmtree(dump_dir, ignore_errors=True)
+
+    print(f"{unit_type}: {output_path}")
+
+
+def to_python(ctx: Context):
+    if ctx.is_array():
+        return [to_python(item) for item in ctx]
+    if ctx.is_object():
+        return {key: to_python(ctx[key]) for key in ctx.keys()}
+
+    return ctx.get_value()
+
+
+def flatten(value, prefix: str, result: Dict[str, list]):
+    """
+    Leaves of the object by paths with array indices dropped, numeric arrays are kept as vectors
+    """
+    if isinstance(value, dict):
+        for key, item in value.items():
+            flatten(item, f"{prefix}.{key}" if prefix else key, result)
+    elif isinstance(value, list) and len(value) >= VECTOR_LENGTH and \
+            all(isinstance(item, (int, float)) and not isinstance(item, bool) for item in value):
+        result.setdefault(prefix, []).append(np.asarray(value, dtype=np.float64))
+    elif isinstance(value, list):
+        for item in value:
+            flatten(item, f"{prefix}[]", result)
+    elif isinstance(value, bytes):
+        if len(value) % 4 == 0 and len(value) // 4 >= VECTOR_LENGTH:
+            result.setdefault(prefix, []).append(np.frombuffer(value, dtype=np.float32).astype(np.float64))
+    else:
+        result.setdefault(prefix, []).append(value)
+
+
+def iou(first: list, second: list) -> float:
+    width = min(first[2], second[2]) - max(first[0], second[0])
+    height = min(first[3], second[3]) - max(first[1], second[1])
+    if width <= 0 or height <= 0:
+        return 0.
+
+    intersection = width * height
+    union = (first[2] - first[0]) * (first[3] - first[1]) + (second[2] - second[0]) * (second[3] - second[1]) - intersection
+
+    return intersection / union
+
+
+def match_objects(reference: list, tested: list) -> List[tuple]:
+    """
+    Greedy matching by the bbox IoU over 0.5, objects without bbox are matched by position
+    """
+    if not all("bbox" in obj for obj in reference + tested):
+        return list(zip(reference, tested))
+
+    pairs = sorted(((iou(first["bbox"], second["bbox"]), i, j) for i, first in enumerate(reference)
+                    for j, second in enumerate(tested)), reverse=True)
+    used_reference, used_tested, result = set(), set(), []
+    for overlap, i, j in pairs:
+        if overlap < 0.5:
+            break
+        if i not in used_reference and j not in used_tested:
+            used_reference.add(i)
+            used_tested.add(j)
+            result.append((reference[i], tested[j]))
+
+    return result
+
+
+class Deviations:
+    def __init__(self):
+        self.reference_objects = 0
+        self.tested_objects = 0
+        self.matched_objects = 0
+        self.values: Dict[str, list] = dict()
+
+    def add(self, reference: list, tested: list):
+        self.reference_objects += len(reference)
+        self.tested_objects += len(tested)
+
+        for first, second in match_objects(reference, tested):
+            self.matched_objects += 1
+            first_leaves, second_leaves = dict(), dict()
+            flatten(first, "", first_leaves)
+            flatten(second, "", second_leaves)
+
+            for key, first_values in first_leaves.items():
+                for a, b in zip(first_values, second_leaves.get(key, [])):
+                    self.values.setdefault(key, []).append((a, b))
+
+    def to_dict(self) -> dict:
+        result = {
+            "reference_objects": self.reference_objects,
+            "tested_objects": self.tested_objects,
+            "matched_objects": self.matched_objects,
+            "outputs": dict(),
+        }
+
+        for key, pairs in sorted(self.values.items()):
+            first, second = pairs[0]
+            if isinstance(first, np.ndarray):
+                similarities = [float(np.dot(a, b) / max(np.linalg.norm(a) * np.linalg.norm(b), 1e-12)) for a, b in pairs]
+                result["outputs"][key] = {"min_cosine": min(similarities), "mean_cosine": float(np.mean(similarities))}
+            elif isinstance(first, (int, float)) and not isinstance(first, bool):
+                differences = [abs(float(a) - float(b)) for a, b in pairs]
+                if max(differences) > 0:
+                    result["outputs"][key] = {"max_abs_diff": max(differences), "mean_abs_diff": float(np.mean(differences))}
+            else:
+                agreement = float(np.mean([a == b for a, b in pairs]))
+                if agreement < 1:
+                    result["outputs"][key] = {"agreement": agreement}
+
+        return result
+
+
+def measure(block, data: Context, repeats: int):
+    """
+    Runs the block on copies of the data, returns the last result and the mean time in ms
+    """
+    elapsed = 0.
+    result = None
+    for _ in range(repeats):
+        result = data.clone()
+        start = time.perf_counter()
+        block(result)
+        elapsed += time.perf_counter() - start
+
+    return result, elapsed * 1000 / repeats
+
+
+def report(service: Service, sdk_path: str, unit_type: str, images: List[str], args) -> dict:
+    prerequisites = [service.create_processing_block({"unit_type": block}) for block in PIPELINES[unit_type]]
+    variants = {precision: service.create_processing_block({"unit_type": unit_type, "precision": precision})
+                for precision in ("fp32", "int8")}
+
+    deviations = Deviations()
+    times = {precision: 0. for precision in variants}
+    for image in images:
+        data = image_to_sdk_form(service, image)
+        for block in prerequisites:
+            block(data)
+
+        results = dict()
+        for precision, block in variants.items():
+            result, elapsed = measure(block, data, args.repeats)
+            results[precision] = to_python(result["objects"]) if "objects" in result.keys() else []
+            times[precision] += elapsed
+
+        deviations.add(results["fp32"], results["int8"])
+
+    model_path = make_model_paths(sdk_path, unit_type)[0]
+    result = deviations.to_dict()
+    result["fp32_ms"] = times["fp32"] / len(images)
+    result["int8_ms"] = times["int8"] / len(images)
+    result["speedup"] = times["fp32"] / max(times["int8"], 1e-9)
+    result["fp32_size_mb"] = os.path.getsize(model_path) / 2 ** 20
+    result["int8_size_mb"] = os.path.getsize(int8_model_path(model_path)) / 2 ** 20
+
+    return result
+
+
+def print_report(results: Dict[str, dict]):
+    print(f"{'unit_type':<24}{'fp32, ms':>10}{'int8, ms':>10}{'speedup':>9}{'objects':>12}  worst output")
+    for unit_type, result in results.items():
+        worst = ""
+        for key, value in result["outputs"].items():
+            if "min_cosine" in value:
+                worst = f"{key}: cosine {value['min_cosine']:.4f}"
+                break
+            if "agreement" in value:
+                worst = f"{key}: agreement {value['agreement']:.3f}"
+                break
+            worst = worst or f"{key}: max diff {value['max_abs_diff']:.4f}"
+
+        objects = f"{result['matched_objects']}/{result['reference_objects']}"
+        print(f"{unit_type:<24}{result['fp32_ms']:>10.2f}{result['int8_ms']:>10.2f}{result['speedup']:>9.2f}"
+              f"{objects:>12}  {worst}")
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description="Static int8 quantization of the SDK models")
+    parser.add_argument("command", choices=["calibrate", "report"])
+    parser.add_argument("--sdk_path", default="", help="Path to directory with data/models, the package folder by default")
+    parser.add_argument("--images", help="Folder with images: calibration images for calibrate, "
+                                         "test images for report (sdk test_images by default)")
+    parser.add_argument("--unit_types", nargs="+", default=list(PIPELINES.keys()), choices=list(PIPELINES.keys()))
+    parser.add_argument("--max_images", type=int, default=500)
+    parser.add_argument("--per_tensor", action="store_true", help="Per tensor weight scales instead of per channel")
+    parser.add_argument("--percentile", action="store_true", help="Percentile calibration instead of min-max")
+    parser.add_argument("--repeats", type=int, default=10, help="Runs of every block per image for report")
+    parser.add_argument("--output", help="Path to json report")
+
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+    service = Service.create_service(args.sdk_path)
+    sdk_path = service.path_to_dir
+
+    if args.command == "calibrate":
+        if not args.images:
+            sys.exit("--images with calibration images is required")
+
+        images = list_images(args.images, args.max_images)
+        for unit_type in args.unit_types:
+            calibrate(service, sdk_path, unit_type, images, args)
+
+        return
+
+    images_path = args.images or os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "test_images")
+    images = list_images(images_path, args.max_images)
+    results = {unit_type: report(service, sdk_path, unit_type, images, args) for unit_type in args.unit_types}
+
+    print_report(results)
+    if args.output:
+        with open(args.output, "w") as file:
+            json.dump(results, file, indent=4)
+
+
+if __name__ == "__main__":
+    main()
@@ -6,18 +6,26 @@
 #include <tdv/modules/FitterModule.h>
 #include <tdv/modules/FaceIdentificationModule.h>
 #include <tdv/modules/BodyReidentificationModule.h>
+#include <tdv/modules/BodyReidMatcherModule.h>
+#include <tdv/modules/TrackerModule.h>
+#include <tdv/modules/TrackCacheModule.h>
 #include <tdv/modules/MatcherModule.h>
 #include <tdv/modules/AgeEstimationModule.h>
 #include <tdv/modules/EmotionsEstimationModule.h>
 #include <tdv/modules/EyeOpenessEstimationModule.h>
+#include <tdv/modules/FaceAttributesModule.h>
 #include <tdv/modules/GenderEstimationModule.h>
 #include <tdv/modules/GlassesEstimationModule.h>
 #include <tdv/modules/MaskEstimationModule.h>
 #include <tdv/modules/LivenessDetectionModule/LivenessDetectionModule.h>
 #include <tdv/modules/HpeResnetV1DModule.h>
+#include <tdv/modules/ActionRecognitionModule.h>
 #include <tdv/modules/DetectionModules/BodyDetectionModule.h>
+#include <tdv/modules/ONNXRuntimeEnvironment.h>
 #include <api/c_api.h>
 #include <tdv/utils/rassert/RAssert.h>
+#include <tdv/utils/profiler/Trace.h>
+#include <tdv/utils/metrics/Metrics.h>
 
 
 #define CreatePB(x) \
@@ -49,8 +57,13 @@ const std::map<std::string, std::string> unitTypes {
 	{"MATCHER_MODULE", ""},
 	{"HUMAN_BODY_DETECTOR", "/data/models/body_detector/body.onnx"},
 	{"BODY_RE_IDENTIFICATION", "/data/models/body_reidentification/re_id_heavy_model.onnx"},
+	{"BODY_REID_MATCHER", ""},
+	{"TRACKER", ""},
+	{"TRACK_CACHE", ""},
 	{"POSE_ESTIMATOR", "/data/models/top_down_hpe/hpe-td.onnx"},
 	{"POSE_ESTIMATOR_LABEL", "/data/models/top_down_hpe/label_map_keypoints.txt"},
+	{"ACTION_RECOGNIZER", "/data/models/action_recognizer/action_recognizer.onnx"},
+	{"ACTION_RECOGNIZER_LABEL", "/data/models/action_recognizer/label_map_actions.txt"},
 };
 
 namespace api {
@@ -60,6 +73,16 @@ namespace internal
 	using Context = ::tdv::data::Context;
 	using Error = ::tdv::utils::rassert::tdv_error;
 	using namespace tdv::modules;
+
+	// blocks owned by another block, the sdk path, runtime settings and the model variant are inherited from the parent config
+	std::unique_ptr<ProcessingBlock> createChildBlock(const Context& parent, Context config)
+	{
+		for (const std::string key : {"@sdk_path", "ONNXRuntime", "precision", "uint8_input"})
+			if (!config.contains(key) && parent.contains(key))
+				config[key] = parent[key];
+		return std::unique_ptr<ProcessingBlock>(reinterpret_cast<ProcessingBlock*>(
+			TDVProcessingBlock_createProcessingBlock(reinterpret_cast<const HContext*>(&config), nullptr)));
+	}
 }
 
 struct ContextEH {
@@ -133,6 +156,7 @@ TDV_PUBLIC HContext* TDVContext_getByKey(HContext * ctx, const char* key, Contex
 TDV_PUBLIC HContext* TDVContext_clone(HContext * ctx, ContextEH ** eh)
 {
 	try {
+		tdv::utils::profiler::TraceSpan traceSpan("TDVContext_clone", "c_api");
 		return reinterpret_cast<HContext*>(new internal::Context(*reinterpret_cast<internal::Context*>(ctx)));
 	} catch (std::exception& e ) {
 		if(!eh) throw;
@@ -145,6 +169,7 @@ TDV_PUBLIC HContext* TDVContext_clone(HContext * ctx, ContextEH ** eh)
 TDV_PUBLIC void TDVContext_copy(HContext * src, HContext * dst, ContextEH ** eh)
 {
 	try {
+		tdv::utils::profiler::TraceSpan traceSpan("TDVContext_copy", "c_api");
 		*reinterpret_cast<internal::Context*>(dst) = *reinterpret_cast<internal::Context*>(src);
 	} catch (std::exception& e ) {
 		if(!eh) throw;
@@ -557,6 +582,7 @@ TDV_PUBLIC void TDVContext_pushBack(HContext * handle_, HContext * data, bool co
 
 TDV_PUBLIC HPBlock* TDVProcessingBlock_createProcessingBlock(const HContext * config, ContextEH ** eh) {
 	try {
+		tdv::utils::profiler::TraceSpan traceSpan("TDVProcessingBlock_createProcessingBlock", "c_api");
 		const internal::Context &ctx = *reinterpret_cast<const internal::Context*>(config);
 		internal::Context new_ctx = ctx;
 		internal::ProcessingBlock* handle_;
@@ -584,12 +610,56 @@ TDV_PUBLIC HPBlock* TDVProcessingBlock_createProcessingBlock(const HContext * co
 			CreatePB(MaskEstimationModule);
 		}else if(unit_type == "EYE_OPENNESS_ESTIMATOR"){
 			CreatePB(EyeOpenessEstimationModule);
+		}else if(unit_type == "FACE_ATTRIBUTES"){
+			// attributes are given by unit types or configs, default models are taken as for standalone estimators
+			const std::vector<std::string> defaultAttributes = {"AGE_ESTIMATOR", "GENDER_ESTIMATOR", "EMOTION_ESTIMATOR", "MASK_ESTIMATOR", "GLASSES_ESTIMATOR"};
+			internal::Context attributes;
+			if (ctx.contains("attributes")){
+				for (const internal::Context& attribute : ctx["attributes"]){
+					internal::Context attributeCtx;
+					if (attribute.is<std::string>())
+						attributeCtx["unit_type"] = attribute.get<std::string>();
+					else
+						attributeCtx = attribute;
+					attributes.push_back(std::move(attributeCtx));
+				}
+			}else{
+				for (const std::string& attribute : defaultAttributes){
+					internal::Context attributeCtx;
+					attributeCtx["unit_type"] = attribute;
+					attributes.push_back(std::move(attributeCtx));
+				}
+			}
+			for (internal::Context& attribute : attributes){
+				if (!attribute.get<std::string>("model_path", "").compare(""))
+					attribute["model_path"] = ctx["@sdk_path"].get<std::string>() + unitTypes.at(attribute["unit_type"].get<std::string>());
+			}
+			new_ctx["attributes"] = std::move(attributes);
+			handle_ = new internal::FaceAttributesModule(new_ctx);
+			return reinterpret_cast<HPBlock*>(handle_);
 		}else if(unit_type == "LIVENESS_ESTIMATOR"){
 			CreatePBLiveness(LivenessDetectionModule);
 		}else if(unit_type == "HUMAN_BODY_DETECTOR"){
 			CreatePB(BodyDetectionModule);}
 		else if(unit_type == "BODY_RE_IDENTIFICATION"){
 			CreatePB(BodyReidentificationModule);
+		}else if(unit_type == "BODY_REID_MATCHER"){
+			CreatePB(BodyReidMatcherModule);
+		}else if(unit_type == "TRACKER"){
+			// the detector is owned by the tracker and run on the detection frames only
+			std::unique_ptr<internal::ProcessingBlock> detector;
+			if (ctx.contains("detector"))
+				detector = internal::createChildBlock(ctx, ctx["detector"]);
+			handle_ = new internal::TrackerModule(new_ctx, std::move(detector));
+			return reinterpret_cast<HPBlock*>(handle_);
+		}else if(unit_type == "TRACK_CACHE"){
+			std::vector<std::unique_ptr<internal::ProcessingBlock>> blocks;
+			if (ctx.contains("blocks")){
+				for (const internal::Context& block : ctx["blocks"])
+					blocks.push_back(internal::createChildBlock(ctx, block));
+			}
+			handle_ = new internal::TrackCacheModule(new_ctx, std::move(blocks));
+			return reinterpret_cast<HPBlock*>(handle_);
 		}else if (unit_type == "POSE_ESTIMATOR"){
 			if (!ctx.get<std::string>("model_path", "").compare(""))
 				new_ctx["model_path"] = ctx["@sdk_path"].get<std::string>() + unitTypes.at(ctx["unit_type"].get<std::string>());
@@ -597,6 +667,15 @@ TDV_PUBLIC HPBlock* TDVProcessingBlock_createProcessingBlock(const HContext * co
 				new_ctx["label_map"] = ctx["@sdk_path"].get<std::string>() + unitTypes.at(ctx["unit_type"].get<std::string>() + "_LABEL");
 			handle_ = new internal::HpeResnetV1DModule(new_ctx);
 			return reinterpret_cast<HPBlock*>(handle_);
+		}else if (unit_type == "ACTION_RECOGNIZER"){
+			// joints of the sequences are in the order of the pose estimator label map
+			const std::pair<const char*, const char*> paths[] = {
+				{"model_path", "ACTION_RECOGNIZER"}, {"label_map", "ACTION_RECOGNIZER_LABEL"}, {"joints_label_map", "POSE_ESTIMATOR_LABEL"}};
+			for (const auto& path : paths)
+				if (!ctx.get<std::string>(path.first, "").compare(""))
+					new_ctx[path.first] = ctx["@sdk_path"].get<std::string>() + unitTypes.at(path.second);
+			handle_ = new internal::ActionRecognitionModule(new_ctx);
+			return reinterpret_cast<HPBlock*>(handle_);
 		}else{
 			throw std::invalid_argument("not correct unit_type");
 		}
@@ -609,6 +688,7 @@ TDV_PUBLIC HPBlock* TDVProcessingBlock_createProcessingBlock(const HContext * co
 
 TDV_PUBLIC void TDVProcessingBlock_destroyBlock(HPBlock * handle_, ContextEH ** eh) {
 	try {
+		tdv::utils::profiler::TraceSpan traceSpan("TDVProcessingBlock_destroyBlock", "c_api");
 		delete reinterpret_cast<internal::ProcessingBlock*>(handle_);
 	} catch (std::exception& e) {
 		if(!eh) throw;
@@ -618,15 +698,86 @@ TDV_PUBLIC void TDVProcessingBlock_destroyBlock(HPBlock * handle_, ContextEH **
 }
 
 TDV_PUBLIC void TDVProcessingBlock_processContext(HPBlock * handle_, HContext * ctx, ContextEH ** eh) {
+	internal::Context& data = *reinterpret_cast<internal::Context*>(ctx);
 	try {
-		reinterpret_cast<internal::ProcessingBlock*>(handle_)->operator()(*reinterpret_cast<internal::Context*>(ctx));
+		tdv::utils::profiler::TraceSpan traceSpan("TDVProcessingBlock_processContext", "c_api");
+		reinterpret_cast<internal::ProcessingBlock*>(handle_)->operator()(data);
 	} catch (std::exception& e ) {
+		// the failed block is left by the block scope, the error may be thrown before it by the input checks
+		const tdv::utils::rassert::tdv_error* error = dynamic_cast<const tdv::utils::rassert::tdv_error*>(&e);
+		const std::string& block = tdv::utils::metrics::lastFailedBlock();
+		tdv::utils::metrics::MetricsRegistry::instance().recordError(block.empty() ? "UNKNOWN" : block, error ? error->code() : 0);
+		tdv::utils::metrics::setLastFailedBlock("");
 		if(!eh) throw;
 		*eh = new ContextEH(new internal::Error(0x9398017a, e.what()),
 							nullptr);
 	}
 }
 
+TDV_PUBLIC void TDVTrace_start(uint64_t eventsPerThread, ContextEH ** eh) {
+	try {
+		tdv::utils::profiler::TraceRecorder::start(eventsPerThread);
+	} catch (std::exception& e) {
+		if(!eh) throw;
+		*eh = new ContextEH(new internal::Error(0x5120a369, e.what()),
+							nullptr);
+	}
+}
+
+TDV_PUBLIC void TDVTrace_stop(ContextEH ** eh) {
+	try {
+		tdv::utils::profiler::TraceRecorder::stop();
+	} catch (std::exception& e) {
+		if(!eh) throw;
+		*eh = new ContextEH(new internal::Error(0x5c186d0e, e.what()),
+							nullptr);
+	}
+}
+
+TDV_PUBLIC void TDVTrace_dump(const char* path, ContextEH ** eh) {
+	try {
+		tdv::utils::profiler::TraceRecorder::dump(path);
+	} catch (std::exception& e) {
+		if(!eh) throw;
+		*eh = new ContextEH(new internal::Error(0x433fd2cf, e.what()),
+							nullptr);
+	}
+}
+
+TDV_PUBLIC void TDVTrace_endModelProfiling(ContextEH ** eh) {
+	try {
+		tdv::modules::ONNXRuntimeEnvironment::endAllProfiling();
+	} catch (std::exception& e) {
+		if(!eh) throw;
+		*eh = new ContextEH(new internal::Error(0xa3c98ef, e.what()),
+							nullptr);
+	}
+}
+
+TDV_PUBLIC void TDVMetrics_snapshot(HContext * ctx, ContextEH ** eh) {
+	try {
+		*reinterpret_cast<internal::Context*>(ctx) = tdv::utils::metrics::MetricsRegistry::instance().toContext();
+	} catch (std::exception& e) {
+		if(!eh) throw;
+		*eh = new ContextEH(new internal::Error(0xa6e4625e, e.what()),
+							nullptr);
+	}
+}
+
+TDV_PUBLIC char* TDVMetrics_prometheus(ContextEH ** eh) {
+	try {
+		const std::string text = tdv::utils::metrics::MetricsRegistry::instance().toPrometheus();
+		char* result = (char*)malloc(text.length() + 1);
+		strcpy(result, text.c_str());
+		return result;
+	} catch (std::exception& e) {
+		if(!eh) throw;
+		*eh = new ContextEH(new internal::Error(0x7d514d88, e.what()),
+							nullptr);
+		return nullptr;
+	}
+}
+
 TDV_PUBLIC const char* TDVException_getMessage(ContextEH * eh) {
 	if (eh && eh->ptr)
 		return eh->ptr->what();
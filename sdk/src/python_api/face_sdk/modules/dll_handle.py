@@ -186,3 +186,23 @@ class DllHandle:
 
     def TDVProcessingBlock_processContext(self, *args, **kwargs):
         self.__dll_handle['TDVProcessingBlock_processContext'](*args, **kwargs)
+
+    def TDVTrace_start(self, *args, **kwargs):
+        self.__dll_handle['TDVTrace_start'](*args, **kwargs)
+
+    def TDVTrace_stop(self, *args, **kwargs):
+        self.__dll_handle['TDVTrace_stop'](*args, **kwargs)
+
+    def TDVTrace_dump(self, *args, **kwargs):
+        self.__dll_handle['TDVTrace_dump'](*args, **kwargs)
+
+    def TDVTrace_endModelProfiling(self, *args, **kwargs):
+        self.__dll_handle['TDVTrace_endModelProfiling'](*args, **kwargs)
+
+    def TDVMetrics_snapshot(self, *args, **kwargs):
+        self.__dll_handle['TDVMetrics_snapshot'](*args, **kwargs)
+
+    def TDVMetrics_prometheus(self, *args, **kwargs):
+        func = self.__dll_handle['TDVMetrics_prometheus']
+        func.restype = c_void_p
+        return func(*args, **kwargs)
@@ -16,12 +16,21 @@ __UNIT_TYPES = {
     "GENDER_ESTIMATOR": ["data/models/gender_estimator/gender_heavy.onnx"],
     "MASK_ESTIMATOR": ["data/models/mask_estimator/mask.onnx"],
     "GLASSES_ESTIMATOR": ["data/models/glasses_estimator/glasses_v2.onnx"],
+    "FACE_ATTRIBUTES": ["data/models/age_estimator/age_heavy.onnx",
+                        "data/models/gender_estimator/gender_heavy.onnx",
+                        "data/models/emotion_estimator/emotion.onnx",
+                        "data/models/mask_estimator/mask.onnx",
+                        "data/models/glasses_estimator/glasses_v2.onnx"],
     "EYE_OPENNESS_ESTIMATOR": ["data/models/eye_openness_estimator/eye.onnx"],
     "LIVENESS_ESTIMATOR": ["data/models/liveness_estimator/liveness_2_7.onnx",
                            "data/models/liveness_estimator/liveness_4_0.onnx"],
     "BODY_RE_IDENTIFICATION": ["data/models/body_reidentification/re_id_heavy_model.onnx"],
+    "BODY_REID_MATCHER": [],
+    "TRACKER": [],
+    "TRACK_CACHE": [],
     "POSE_ESTIMATOR": ["data/models/top_down_hpe/hpe-td.onnx"],
     "POSE_ESTIMATOR_LABEL": ["data/models/top_down_hpe/label_map_keypoints.txt"],
+    "ACTION_RECOGNIZER": ["data/models/top_down_hpe/label_map_keypoints.txt"],
 }
 
 __BASE_URL = "https://download.3divi.com/facesdk/archives/artifacts/models/"
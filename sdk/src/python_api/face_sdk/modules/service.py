@@ -1,5 +1,5 @@
 import os
-from ctypes import CDLL
+from ctypes import CDLL, c_char_p, c_ulong, c_void_p, string_at
 from sys import platform
 from pathlib import Path
 
@@ -7,6 +7,7 @@ from .models import make_model_paths, download_models
 from .context import Context
 from .processing_block import ProcessingBlock
 from .dll_handle import DllHandle
+from .exception_check import check_exception, make_exception
 
 
 class Service:
@@ -62,12 +63,23 @@ class Service:
                 )
             }
 
-        if len(unit_type) != 0:
-            for model_path in make_model_paths(self.path_to_dir, unit_type):
-                if not os.path.exists(model_path):
-                    download_models(self.path_to_dir, unit_type)
+        unit_types = [unit_type]
 
-                    break
+        # tracker and track cache create their blocks themselves
+        children = [ctx["detector"]] if "detector" in ctx else []
+        children.extend(ctx.get("blocks", []))
+
+        for child in children:
+            if "unit_type" in child:
+                unit_types.append(str(child["unit_type"]))
+
+        for unit_type in unit_types:
+            if len(unit_type) != 0:
+                for model_path in make_model_paths(self.path_to_dir, unit_type):
+                    if not os.path.exists(model_path):
+                        download_models(self.path_to_dir, unit_type)
+
+                        break
 
         return ProcessingBlock(self.__dll_handle, ctx)
 
@@ -80,3 +92,63 @@ class Service:
         ctr = Context(self.__dll_handle)
         ctr(ctx)
         return ctr
+
+    def start_trace(self, events_per_thread: int = 65536):
+        """
+        Start recording of the processing timeline: blocks, their stages, per object loops and C API calls
+        :param events_per_thread: Number of the last spans kept for every thread
+        """
+        exception = make_exception()
+        self.__dll_handle.TDVTrace_start(c_ulong(events_per_thread), exception)
+        check_exception(exception, self.__dll_handle)
+
+    def stop_trace(self):
+        """
+        Stop recording of the processing timeline, the recorded spans are kept for dump_trace
+        """
+        exception = make_exception()
+        self.__dll_handle.TDVTrace_stop(exception)
+        check_exception(exception, self.__dll_handle)
+
+    def dump_trace(self, path: str):
+        """
+        Write the recorded timeline in Chrome trace format (chrome://tracing, ui.perfetto.dev)
+        :param path: Path to json file
+        """
+        exception = make_exception()
+        self.__dll_handle.TDVTrace_dump(c_char_p(bytes(path, "utf-8")), exception)
+        check_exception(exception, self.__dll_handle)
+
+    def end_model_profiling(self):
+        """
+        End the onnxruntime profiling of the live blocks created with "enable_trace",
+        their model events are added to the following dump_trace. The profiling is not resumed,
+        must not be called while the blocks are processing
+        """
+        exception = make_exception()
+        self.__dll_handle.TDVTrace_endModelProfiling(exception)
+        check_exception(exception, self.__dll_handle)
+
+    def get_metrics(self) -> Context:
+        """
+        Get the snapshot of the processing metrics: calls, frames, objects, inferences, batch sizes,
+        latency percentiles of the blocks and their stages, error counts by codes
+        :return: Context
+        """
+        result = Context(self.__dll_handle)
+        exception = make_exception()
+        self.__dll_handle.TDVMetrics_snapshot(result._impl, exception)
+        check_exception(exception, self.__dll_handle)
+        return result
+
+    def get_metrics_prometheus(self) -> str:
+        """
+        Get the processing metrics in Prometheus text exposition format
+        :return: str
+        """
+        exception = make_exception()
+        text = self.__dll_handle.TDVMetrics_prometheus(exception)
+        check_exception(exception, self.__dll_handle)
+        result = string_at(text).decode()
+        self.__dll_handle.freePtr(c_void_p(text))
+        return result
@@ -1,7 +1,10 @@
 #include <opencv2/core/cvdef.h>
 
 #include <tdv/data/ContextUtils.h>
+#include <tdv/utils/profiler/Profiler.h>
+#include <tdv/utils/rassert/RAssert.h>
 #include <iostream>
+#include <vector>
 
 
 namespace tdv
@@ -56,6 +59,7 @@ void cvMatToBsm(Context& bsmCtx, const cv::Mat& img, bool copy)
 
 cv::Mat bsmToCvMat(const Context& bsmCtx, bool copy)
 {
+	tdv::utils::profiler::StageTimer timer("bsm_to_mat");
 	auto buff = bsmCtx.at("blob").get<std::shared_ptr<unsigned char>>();
 	int type = StrToCvType.at(bsmCtx.at("dtype").get<std::string>());
 	int ndims = static_cast<int>(bsmCtx.at("shape").size());
@@ -67,8 +71,153 @@ cv::Mat bsmToCvMat(const Context& bsmCtx, bool copy)
 	return copy ? img.clone() : img;
 }
 
+namespace
+{
+
+// bbox and the named points of the aligned crop (see keypointsBasedCrop) with flags of their presence:
+// comparing them is much cheaper than comparing all keypoints of the object
+std::vector<double> cropFingerprint(const Context& obj)
+{
+	std::vector<double> fingerprint;
+	fingerprint.push_back(obj.contains("bbox"));
+	if (obj.contains("bbox"))
+		for (const Context& value : obj.at("bbox"))
+			fingerprint.push_back(value.get<double>());
+
+	fingerprint.push_back(obj.contains("keypoints"));
+	if (obj.contains("keypoints"))
+	{
+		const Context& keypoints = obj.at("keypoints");
+		for (const char* point : {"left_eye", "right_eye", "mouth"})
+		{
+			const bool present = keypoints.contains(point) && keypoints.at(point).contains("proj");
+			fingerprint.push_back(present);
+			if (present)
+				for (const Context& value : keypoints.at(point).at("proj"))
+					fingerprint.push_back(value.get<double>());
+		}
+	}
+	return fingerprint;
+}
+
+bool sameFingerprint(const Context& stored, const std::vector<double>& fingerprint)
+{
+	if (stored.size() != fingerprint.size())
+		return false;
+	for (size_t i = 0; i < fingerprint.size(); ++i)
+		if (stored.at(i).get<double>() != fingerprint[i])
+			return false;
+	return true;
+}
+
+Context fingerprintToContext(const std::vector<double>& fingerprint)
+{
+	Context result = Context::make_array();
+	for (double value : fingerprint)
+		result.push_back(value);
+	return result;
+}
+
+}
+
+cv::Mat cachedCrop(Context& data, const std::string& cropType, const cv::Size& size,
+	const std::function<cv::Mat(const cv::Mat&)>& makeCrop)
+{
+	const Context& imageCtx = data.at("image");
+	const auto blob = imageCtx.at("blob").get<std::shared_ptr<unsigned char>>();
+
+	// the cache lives on the frame between the calls of the blocks until the image is replaced:
+	// holding the image buffer keeps its address from being reused by the next frame,
+	// the ownership comparison tells a new blob wrapping the same (non-owned) buffer from the cached one
+	Context& cache = data["@crop_cache"];
+	std::shared_ptr<unsigned char> cached;
+	if (cache.contains("@image"))
+		cached = cache["@image"].get<std::shared_ptr<unsigned char>>();
+	if (!cached || cached != blob || cached.owner_before(blob) || blob.owner_before(cached) ||
+		!(cache["@shape"] == imageCtx.at("shape")))
+	{
+		cache.clear();
+		cache["@image"] = blob;
+		cache["@shape"] = imageCtx.at("shape");
+	}
+
+	const int index = data.at("objects@current_id").get<int>();
+	const Context& obj = data.at("objects").at(index);
+	const std::string key = std::to_string(obj.get<int64_t>("id", index)) + ":" + cropType + ":" +
+		std::to_string(size.width) + "x" + std::to_string(size.height);
+
+	// aligned crops depend on the keypoints, which the fitter may update after the crop is cached
+	const std::vector<double> fingerprint = cropFingerprint(obj);
+	if (cache.contains(key))
+	{
+		const Context& entry = cache[key];
+		if (sameFingerprint(entry["fingerprint"], fingerprint))
+			return bsmToCvMat(entry["crop"]);
+	}
+
+	tdv::utils::profiler::StageTimer timer("crop");
+	cv::Mat crop = makeCrop(bsmToCvMat(imageCtx));
+	RHAssert2(0x98942a87, crop.cols == size.width && crop.rows == size.height, "crop size differs from the requested one");
+	if (!crop.isContinuous())
+		crop = crop.clone();
+
+	Context entry;
+	cvMatToBsm(entry["crop"], crop);
+	// the buffer stays owned by the cv::Mat
+	entry["crop"]["blob"] = std::shared_ptr<unsigned char>(crop.data, [crop](unsigned char*){});
+	entry["fingerprint"] = fingerprintToContext(fingerprint);
+	cache[key] = std::move(entry);
+
+	return crop;
+}
+
+Context cachedCropsFrame(const Context& data)
+{
+	Context frame;
+	frame["image"] = data.at("image");
+
+	// the entries get the fingerprint of the objects without bbox and keypoints, so they are hits for them
+	Context& objects = frame["objects"];
+	for (const Context& obj : data.at("objects"))
+	{
+		Context object;
+		if (obj.contains("id"))
+			object["id"] = obj.at("id");
+		objects.push_back(std::move(object));
+	}
+
+	if (data.contains("@crop_cache"))
+	{
+		const Context& cache = data.at("@crop_cache");
+		Context& crops = frame["@crop_cache"];
+		const Context fingerprint = fingerprintToContext(cropFingerprint(Context::make_object()));
+		for (auto it = cache.kvbegin(); it != cache.kvend(); ++it)
+		{
+			if (it->first.front() == '@')
+				crops[it->first] = it->second;
+			else
+			{
+				crops[it->first]["crop"] = it->second.at("crop");
+				crops[it->first]["fingerprint"] = fingerprint;
+			}
+		}
+	}
+	return frame;
+}
+
+void dropCropCache(Context& data)
+{
+	if (data.isObject())
+		data.erase("@crop_cache");
+	else if (data.isArray())
+		for (size_t i = 0; i < data.size(); ++i)
+			dropCropCache(data[i]);
+}
+
 void keypointsBasedCrop(cv::Mat& image, const Context& data) {
-	const tdv::data::Context& obj = data["objects"][data["objects@current_id"].get<int>()];
+	const tdv::data::Context& object = data["objects"][data["objects@current_id"].get<int>()];
+	// the named points are present in every landmarks output of the fitters
+	const tdv::data::Context& obj = object.contains("keypoints") ? object["keypoints"] : object;
 	double left_eye_x = obj["left_eye"]["proj"][0].get<double>() * image.cols;
 	double left_eye_y = obj["left_eye"]["proj"][1].get<double>() * image.rows;
 
@@ -128,5 +277,13 @@ void keypointsBasedCrop(cv::Mat& image, const Context& data) {
 
 }
 
+void simpleCrop(cv::Mat& image, const Context& data) {
+	const tdv::data::Context& rectCtx = data["objects"][data["objects@current_id"].get<int>()]["bbox"];
+	auto clip = [](int value, int upper) { return std::max(0, std::min(value, upper)); };
+	cv::Point bbox_top_left = {clip(static_cast<int>(rectCtx[0].get<double>() * image.cols), image.cols), clip(static_cast<int>(rectCtx[1].get<double>() * image.rows), image.rows)}; //TODO add border of image
+	cv::Point bbox_bottom_right = {clip(static_cast<int>(rectCtx[2].get<double>() * image.cols), image.cols), clip(static_cast<int>(rectCtx[3].get<double>() * image.rows), image.rows)}; //TODO add border of image
+	image = image(cv::Rect(bbox_top_left, bbox_bottom_right));
+}
+
 } // namespace utils
 } // namespace tdv
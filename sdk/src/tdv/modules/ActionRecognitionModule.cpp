@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+#include <opencv2/core.hpp>
+
+#include <tdv/modules/ActionRecognitionModule.h>
+#include <tdv/utils/rassert/RAssert.h>
+#include <tdv/utils/har_utils/har_utils.h>
+
+
+namespace tdv {
+namespace modules {
+
+ActionRecognitionModule::ActionRecognitionModule(const tdv::data::Context& config) :
+	ONNXModule<ActionRecognitionModule>(config),
+	labelMap(read_label_map(config.at("label_map").get<std::string>())),
+	stride(config.get_as<int64_t>("stride", 8)),
+	maxMissingFrames(config.get_as<int64_t>("max_missing_frames", 30)),
+	centered(config.get<bool>("centered", false)),
+	useSoftmax(config.get<bool>("softmax", true))
+{
+	const auto& shape = getInputShapes().front();
+	RHAssert2(0xe334328c, shape.size() == 5 && shape[2] > 0 && shape[3] > 0 && shape[4] > 0,
+		"action recognition model input must be [batch, persons, frames, joints, channels] with static frames, joints and channels");
+	sequenceLength = shape[2];
+	channels = shape[4];
+	RHAssert2(0xf16fba9b, channels == 2 || channels == 3, "only (x, y) and (x, y, score) channels are supported");
+	RHAssert2(0x3cbb670d, stride > 0, "stride must be positive");
+
+	for (const auto& joint : read_label_map(config.at("joints_label_map").get<std::string>()))
+		joints.push_back(joint.second);
+	RHAssert2(0x92e86e2b, static_cast<int64_t>(joints.size()) == shape[3], "joints label map does not match the model input");
+}
+
+ActionRecognitionModule::Stream& ActionRecognitionModule::getStream(const tdv::data::Context& data)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<Stream>& stream = streams[data.get<std::string>("stream_id", "default")];
+	if (!stream)
+		stream.reset(new Stream());
+	return *stream;
+}
+
+void ActionRecognitionModule::operator ()(tdv::data::Context& data)
+{
+	// the stream state is used by the preprocess and postprocess of the call
+	std::lock_guard<std::mutex> lock(getStream(data).mutex);
+	ONNXModule<ActionRecognitionModule>::operator()(data);
+}
+
+void ActionRecognitionModule::addFrame(Stream& stream, tdv::data::Context& objects)
+{
+	const size_t frameSize = joints.size() * 3;
+	for (size_t i = 0; i < objects.size(); ++i)
+	{
+		tdv::data::Context& obj = objects[i];
+		if (!obj.contains("track_id") || !obj.contains("keypoints"))
+			continue;
+
+		Track& track = stream.tracks[obj["track_id"].get<int64_t>()];
+		if (track.frames.empty())
+			track.frames.resize(sequenceLength * frameSize);
+		track.lastFrame = stream.frame;
+
+		// missing joints are zero
+		const tdv::data::Context& keypoints = obj["keypoints"];
+		float* point = track.frames.data() + track.head * frameSize;
+		for (const std::string& joint : joints)
+		{
+			if (keypoints.contains(joint))
+			{
+				const tdv::data::Context& keypoint = keypoints[joint];
+				point[0] = keypoint["proj"][0].get_as<double>();
+				point[1] = keypoint["proj"][1].get_as<double>();
+				point[2] = keypoint.get_as<double>("confidence", 1.);
+				if (centered)
+				{
+					point[0] = 2 * point[0] - 1;
+					point[1] = 2 * point[1] - 1;
+				}
+			}
+			else
+			{
+				std::fill(point, point + 3, 0.f);
+			}
+			point += 3;
+		}
+		track.head = (track.head + 1) % sequenceLength;
+		track.count = std::min(track.count + 1, sequenceLength);
+
+		if (!track.action.empty())
+			obj["action"] = track.action;
+	}
+
+	for (auto it = stream.tracks.begin(); it != stream.tracks.end();)
+		it = stream.frame - it->second.lastFrame > maxMissingFrames ? stream.tracks.erase(it) : std::next(it);
+}
+
+// On the first call of a frame the keypoints are added to the tracks and the full tracks to infer are listed in
+// "objects@tracks", then they are taken from "objects@offset" on as one batch (one by one for a static batch model)
+void ActionRecognitionModule::preprocess(tdv::data::Context& data)
+{
+	Stream& stream = getStream(data);
+
+	if (!data.contains("objects@tracks"))
+	{
+		if (!data.contains("objects"))
+			return;
+
+		addFrame(stream, data["objects"]);
+		tdv::data::Context& tracks = data["objects@tracks"];
+		if (stream.frame++ % stride == 0)
+			for (const auto& track : stream.tracks)
+				if (track.second.count == sequenceLength && track.second.lastFrame == stream.frame - 1)
+					tracks.push_back(track.first);
+	}
+
+	const tdv::data::Context& tracks = data["objects@tracks"];
+	const int64_t count = static_cast<int64_t>(tracks.size());
+	int64_t offset = data.get<int64_t>("objects@offset", 0);
+	if (offset >= count)
+	{
+		data.erase("objects@tracks");
+		data.erase("objects@offset");
+		return;
+	}
+	const int64_t batchSize = getDynamicBatchEnabled().front() ? count - offset : 1;
+	data["objects@offset"] = offset + batchSize;
+
+	const size_t frameSize = joints.size() * 3;
+	const size_t sizeInFloats = sequenceLength * joints.size() * channels;
+	float* input_ptr = static_cast<float*>(malloc(sizeInFloats * batchSize * sizeof(float)));
+	if (!input_ptr)
+		throw std::bad_alloc();
+	std::shared_ptr<unsigned char> input(reinterpret_cast<unsigned char*>(input_ptr), [](unsigned char* ptr){ free(ptr); });
+
+	tdv::data::Context& batch = data["objects@batch"];
+	batch.clear();
+	float* output = input_ptr;
+	for (int64_t i = 0; i < batchSize; ++i)
+	{
+		const int64_t trackId = tracks[offset + i].get<int64_t>();
+		const Track& track = stream.tracks.at(trackId);
+		// the buffer is full, the oldest frame is at the head
+		for (size_t t = 0; t < sequenceLength; ++t)
+		{
+			const float* point = track.frames.data() + ((track.head + t) % sequenceLength) * frameSize;
+			for (size_t j = 0; j < joints.size(); ++j, point += 3)
+				for (size_t c = 0; c < channels; ++c)
+					*output++ = point[c];
+		}
+		batch.push_back(trackId);
+	}
+
+	tdv::data::Context& inputData = data["objects@input"][0];
+	inputData["input_ptr"] = input;
+	inputData["batch_size"] = static_cast<size_t>(batchSize);
+}
+
+void ActionRecognitionModule::postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data)
+{
+	if (!buffer)
+		return;
+
+	Stream& stream = getStream(data);
+	const size_t classes = getOutputShapes().front()[1];
+	const tdv::data::Context& batch = data["objects@batch"];
+	tdv::data::Context& objects = data["objects"];
+
+	for (size_t row = 0; row < batch.size(); ++row)
+	{
+		const float* scores = reinterpret_cast<const float*>(buffer.get()) + row * classes;
+		const size_t best = std::max_element(scores, scores + classes) - scores;
+		double confidence = scores[best];
+		if (useSoftmax)
+		{
+			double sum = 0;
+			for (size_t c = 0; c < classes; ++c)
+				sum += std::exp(static_cast<double>(scores[c]) - scores[best]);
+			confidence = 1. / sum;
+		}
+
+		const int64_t trackId = batch[row].get<int64_t>();
+		tdv::data::Context action;
+		const auto label = labelMap.find(static_cast<int>(best));
+		action["label"] = label != labelMap.end() ? label->second : std::to_string(best);
+		action["class_id"] = static_cast<int64_t>(best);
+		action["confidence"] = confidence;
+
+		for (size_t i = 0; i < objects.size(); ++i)
+			if (objects[i].contains("track_id") && objects[i]["track_id"].get<int64_t>() == trackId)
+				objects[i]["action"] = action;
+		stream.tracks.at(trackId).action = std::move(action);
+	}
+	data.erase("objects@batch");
+}
+
+}
+}
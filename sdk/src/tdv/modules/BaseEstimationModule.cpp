@@ -6,21 +6,41 @@ namespace tdv {
 namespace modules {
 
 
-BaseEstimationModule::BaseEstimationModule(const tdv::data::Context& config)
+BaseEstimationModule::BaseEstimationModule(const tdv::data::Context& config, bool batchObjectsByDefault) :
+	batchObjects(config.get<bool>("batch_objects", batchObjectsByDefault)),
+	profiler(config, "ESTIMATOR")
 {}
 
 void BaseEstimationModule::operator ()(tdv::data::Context& data) {
-	if (data.contains("objects")){
+	tdv::utils::profiler::Profile profile;
+	tdv::utils::profiler::ProfileScope profileScope(profiler.isEnabled() ? &profile : tdv::utils::profiler::Profile::current());
+	tdv::utils::profiler::BlockScope blockScope(profiler, data);
+
+	if (data.contains("objects") && batchObjects){
+		// all objects are processed in batches, see BaseEstimationInference::preprocess
+		tdv::utils::profiler::StageTimer timer("estimation");
+		(*block)(data);
+	}else if (data.contains("objects")){
 		for(int i = 0; i < data["objects"].size(); i++){
 			data["objects@current_id"] = i;
+			profile.setObject(i);
+			tdv::utils::profiler::TraceSpan objectSpan("object", "object", i);
+			tdv::utils::profiler::StageTimer timer("estimation");
 			(*block)(data);
 		}
 		data.erase("objects@current_id");
 	}else{
+		tdv::utils::profiler::StageTimer timer("estimation");
 		(*block)(data);
 	}
+
+	profiler.write(profile, data);
 }
 
+void BaseEstimationModule::cacheCrops(tdv::data::Context& data) {
+	if (auto preprocessor = dynamic_cast<CropPreprocessor*>(block.get()))
+		preprocessor->cacheCrops(data);
+}
 
 }
 }
@@ -0,0 +1,240 @@
+#include <tdv/modules/BodyReidMatcherModule.h>
+#include <tdv/utils/rassert/RAssert.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <tuple>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#endif
+
+
+namespace{
+
+float dot(const float* v1, const float* v2, const size_t n)
+{
+	size_t i = 0;
+	float d = 0;
+
+	#ifdef __SSE2__
+
+	__m128 sse_d0 = _mm_setzero_ps();
+	__m128 sse_d1 = _mm_setzero_ps();
+
+	for(; i + 8 <= n; i += 8)
+	{
+		sse_d0 = _mm_add_ps(sse_d0, _mm_mul_ps(_mm_loadu_ps(v1 + i), _mm_loadu_ps(v2 + i)));
+		sse_d1 = _mm_add_ps(sse_d1, _mm_mul_ps(_mm_loadu_ps(v1 + i + 4), _mm_loadu_ps(v2 + i + 4)));
+	}
+
+	float d_buf[4];
+	_mm_storeu_ps(d_buf, _mm_add_ps(sse_d0, sse_d1));
+
+	d = d_buf[0] + d_buf[1] + d_buf[2] + d_buf[3];
+
+	#endif
+
+	for(; i < n; ++i)
+		d += v1[i] * v2[i];
+
+	return d;
+}
+
+void l2Normalize(float* v, const size_t n)
+{
+	const float norm2 = dot(v, v, n);
+	if(norm2 > 0)
+	{
+		const float m = 1.0f / std::sqrt(norm2);
+		for(size_t i = 0; i < n; ++i)
+			v[i] *= m;
+	}
+}
+
+double steadyNowMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+
+namespace tdv {
+
+namespace modules {
+
+void BodyReidMatcherModule::Gallery::push_back(int64_t id, const float* data, double timestamp, const std::string& camera)
+{
+	templates.insert(templates.end(), data, data + dimension);
+	ids.push_back(id);
+	timestamps.push_back(timestamp);
+	cameras.push_back(camera);
+}
+
+void BodyReidMatcherModule::Gallery::remove(size_t row)
+{
+	// the last entry takes the place of the removed one
+	const size_t last = size() - 1;
+	if (row != last)
+	{
+		std::copy(templates.begin() + last * dimension, templates.end(), templates.begin() + row * dimension);
+		ids[row] = ids[last];
+		timestamps[row] = timestamps[last];
+		cameras[row] = std::move(cameras[last]);
+	}
+	templates.resize(last * dimension);
+	ids.pop_back();
+	timestamps.pop_back();
+	cameras.pop_back();
+}
+
+BodyReidMatcherModule::BodyReidMatcherModule(const tdv::data::Context& config):
+	threshold(config.get_as<double>("threshold", 0.6)),
+	topK(config.get_as<int64_t>("top_k", 5)),
+	windowMs(config.get_as<double>("gallery_window_ms", 60000.)),
+	maxGallerySize(config.get_as<int64_t>("max_gallery_size", 10000)),
+	momentum(config.get_as<double>("update_momentum", 0.9)),
+	profiler(config, "BODY_REID_MATCHER")
+{
+	RHAssert2(0xd2491a41, topK > 0 && maxGallerySize > 0, "top_k and max_gallery_size must be positive");
+	RHAssert2(0xc7ac93ff, momentum >= 0 && momentum < 1, "update_momentum must be in [0, 1)");
+}
+
+void BodyReidMatcherModule::operator ()(tdv::data::Context& data)
+{
+	if (!data.contains("objects"))
+		return;
+
+	tdv::utils::profiler::Profile profile;
+	{
+		tdv::utils::profiler::ProfileScope profileScope(profiler.isEnabled() ? &profile : tdv::utils::profiler::Profile::current());
+		tdv::utils::profiler::BlockScope blockScope(profiler, data);
+
+		const double now = data.contains("timestamp_ms") ? data["timestamp_ms"].get_as<double>() : steadyNowMs();
+		const bool update = data.get<bool>("gallery_update", true);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		Gallery& gallery = galleries[data.get<std::string>("camera_group", "default")];
+		{
+			tdv::utils::profiler::StageTimer timer("expire");
+			expire(gallery, now);
+		}
+		tdv::utils::profiler::StageTimer timer("match");
+		match(gallery, data, now, update);
+	}
+	profiler.write(profile, data);
+}
+
+void BodyReidMatcherModule::expire(Gallery& gallery, double now) const
+{
+	if (windowMs > 0)
+		for (size_t row = gallery.size(); row-- > 0;)
+			if (now - gallery.timestamps[row] > windowMs)
+				gallery.remove(row);
+}
+
+void BodyReidMatcherModule::match(Gallery& gallery, tdv::data::Context& data, double now, bool update)
+{
+	tdv::data::Context& objects = data["objects"];
+	const std::string camera = data.get<std::string>("camera_id", "");
+
+	// unit length query templates of the objects having one
+	std::vector<size_t> queries;
+	std::vector<float> templates;
+	for (size_t i = 0; i < objects.size(); ++i)
+	{
+		if (!objects[i].contains("template"))
+			continue;
+		const std::vector<float>& objectTemplate = objects[i]["template"].get<std::vector<float>>();
+		if (!gallery.dimension)
+			gallery.dimension = objectTemplate.size();
+		RHAssert2(0x7f5ab056, objectTemplate.size() == gallery.dimension, "template size differs from the gallery one");
+
+		queries.push_back(i);
+		templates.insert(templates.end(), objectTemplate.begin(), objectTemplate.end());
+		l2Normalize(templates.data() + templates.size() - gallery.dimension, gallery.dimension);
+	}
+
+	const size_t dimension = gallery.dimension;
+	const size_t rows = gallery.size();
+	const size_t k = std::min(topK, rows);
+
+	// (similarity, query, gallery row) of all pairs above the threshold, not only the top_k ones,
+	// so an object losing its best identity to a more similar one can still take any other above the threshold
+	std::vector<std::tuple<float, size_t, size_t>> candidates;
+	std::vector<float> scores(rows);
+	std::vector<size_t> order(rows);
+	for (size_t q = 0; q < queries.size(); ++q)
+	{
+		const float* query = templates.data() + q * dimension;
+		for (size_t row = 0; row < rows; ++row)
+		{
+			scores[row] = dot(query, gallery.templates.data() + row * dimension, dimension);
+			if (scores[row] >= threshold)
+				candidates.emplace_back(scores[row], q, row);
+		}
+
+		for (size_t row = 0; row < rows; ++row)
+			order[row] = row;
+		std::partial_sort(order.begin(), order.begin() + k, order.end(),
+			[&scores](size_t a, size_t b){ return scores[a] > scores[b]; });
+
+		tdv::data::Context& matches = objects[queries[q]]["matches"];
+		matches.clear();
+		for (size_t i = 0; i < k; ++i)
+		{
+			const size_t row = order[i];
+			tdv::data::Context match;
+			match["reid_id"] = gallery.ids[row];
+			match["similarity"] = static_cast<double>(scores[row]);
+			match["camera_id"] = gallery.cameras[row];
+			match["timestamp_ms"] = gallery.timestamps[row];
+			matches.push_back(std::move(match));
+		}
+	}
+
+	// every identity is given to at most one object of the frame, the most similar pairs first
+	std::sort(candidates.begin(), candidates.end(),
+		[](const std::tuple<float, size_t, size_t>& a, const std::tuple<float, size_t, size_t>& b){ return std::get<0>(a) > std::get<0>(b); });
+	std::vector<bool> queryAssigned(queries.size(), false), rowAssigned(rows, false);
+	for (const auto& candidate : candidates)
+	{
+		const size_t q = std::get<1>(candidate), row = std::get<2>(candidate);
+		if (queryAssigned[q] || rowAssigned[row])
+			continue;
+		queryAssigned[q] = rowAssigned[row] = true;
+		objects[queries[q]]["reid_id"] = gallery.ids[row];
+
+		if (update)
+		{
+			float* stored = gallery.templates.data() + row * dimension;
+			const float* query = templates.data() + q * dimension;
+			for (size_t i = 0; i < dimension; ++i)
+				stored[i] = momentum * stored[i] + (1 - momentum) * query[i];
+			l2Normalize(stored, dimension);
+			gallery.timestamps[row] = now;
+			gallery.cameras[row] = camera;
+		}
+	}
+
+	if (!update)
+		return;
+
+	for (size_t q = 0; q < queries.size(); ++q)
+	{
+		if (queryAssigned[q])
+			continue;
+
+		if (gallery.size() >= maxGallerySize)
+			gallery.remove(std::min_element(gallery.timestamps.begin(), gallery.timestamps.end()) - gallery.timestamps.begin());
+
+		const int64_t id = nextId++;
+		gallery.push_back(id, templates.data() + q * dimension, now, camera);
+		objects[queries[q]]["reid_id"] = id;
+	}
+}
+
+}
+}
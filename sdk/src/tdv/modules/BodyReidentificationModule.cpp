@@ -11,30 +11,37 @@
 
 namespace {
 
+// planar (x / 255 - mean) / std, written to output
+void blobFromImage(const cv::Mat& img, float* output){
+	RHAssert2(0x6a23a1ed, img.type() == CV_8UC3, "only 3 channel 8U images are supported");
+
+	static const cv::Scalar mean(0.485, 0.456, 0.406);
+	static const cv::Scalar scale(1 / 0.229, 1 / 0.224, 1 / 0.225);
+
+	cv::Mat normalized;
+	img.convertTo(normalized, CV_32F, 1.0 / 255);
+	cv::subtract(normalized, mean, normalized);
+	cv::multiply(normalized, scale, normalized);
+
+	std::vector<cv::Mat> planes;
+	for (int c = 0; c < 3; ++c)
+		planes.emplace_back(img.rows, img.cols, CV_32F, output + c * img.total());
+	cv::split(normalized, planes);
+}
 
-float* blobFromImage(cv::Mat& img){
-	float* blob = new float[img.total()*3];
-	int channels = 3;
-	int img_h = img.rows;
-	int img_w = img.cols;
-
-	std::vector<float> mean = {0.485, 0.456, 0.406};
-	std::vector<float> std = {0.229, 0.224, 0.225};
+// the same crop as the estimators with SIMPLE_CROP make, so they share the cache entries of equal input size
+cv::Mat bodyCrop(const cv::Mat &input, const tdv::data::Context& data, const int input_width, const int input_height){
+	cv::Mat image = input;
+	tdv::data::simpleCrop(image, data);
 
-	for (size_t c = 0; c < channels; c++)
-	{
-		for (size_t  h = 0; h < img_h; h++)
-		{
-			for (size_t w = 0; w < img_w; w++)
-			{
-				blob[c * img_w * img_h + h * img_w + w] =
-							(((float)img.at<cv::Vec3b>(h, w)[c]) / 255.0f - mean[c]) / std[c];
-			}
-		}
-	}
-	return blob;
+	cv::Mat resized;
+	cv::resize(image, resized, cv::Size(input_width, input_height));
+	return resized;
 }
 
+bool isBody(const tdv::data::Context& obj){
+	return obj.contains("bbox") && (!obj.contains("class") || obj["class"].get<std::string>() == "body");
+}
 
 }
 
@@ -46,48 +53,106 @@ namespace modules {
 
 
 BodyReidentificationModule::BodyReidentificationModule(const tdv::data::Context& config) :
-		ONNXModule<BodyReidentificationModule>(config)
+		ONNXModule<BodyReidentificationModule>(config),
+		useCropCache(config.get<bool>("use_crop_cache", true))
 {};
 
-std::vector<float> BodyReidentificationModule::getOutputData(std::shared_ptr<uint8_t> buff)
+const float* BodyReidentificationModule::getOutputData(std::shared_ptr<uint8_t> buff, size_t row) const
 {
 	const auto& shapes = getOutputShapes();
-	size_t predict_shape{static_cast<size_t>(shapes.front()[1])};
-	float* blob_data = reinterpret_cast<float*>(buff.get());
+	RHAssert2(0x14990f3a, static_cast<int64_t>(row) < shapes.front()[0], "batch row is out of range");
 
-	return std::vector<float>(blob_data, blob_data + predict_shape);
+	return reinterpret_cast<const float*>(buff.get()) + row * shapes.front()[1];
 }
 
+// Body objects from "objects@offset" on are taken as one batch (one by one for a static batch model),
+// their indices are kept in "objects@batch" for postprocess
 void BodyReidentificationModule::preprocess(tdv::data::Context& data) {
 
-	Context& imageInput = data.at("image");
-	cv::Mat image = tdv::data::bsmToCvMat(imageInput, true);
-
 	const auto& shapes = getInputShapes();
-	const int64_t& INPUT_H = shapes[0][2];
-	const int64_t& INPUT_W = shapes[0][3];
-	cv::Mat pr_img;
-	cv::resize(image, pr_img, cv::Size(INPUT_W, INPUT_H));
-	float* blob = blobFromImage(pr_img);
-	Context inputTensor;
-	inputTensor["input_ptr"] = std::shared_ptr<unsigned char>((unsigned char*)blob, [](unsigned char* ptr){ free(ptr);});
-	data["objects@input"].push_back(inputTensor);
-
-	return;
+	const int64_t INPUT_H = shapes[0][2];
+	const int64_t INPUT_W = shapes[0][3];
+	const size_t sizeInFloats = 3 * INPUT_H * INPUT_W;
+
+	std::vector<int> batch;
+	if (data.contains("objects"))
+	{
+		const int64_t count = static_cast<int64_t>(data["objects"].size());
+		const bool dynamicBatch = getDynamicBatchEnabled().front();
+		int64_t next = data.get<int64_t>("objects@offset", 0);
+		for (; next < count && (dynamicBatch || batch.empty()); ++next)
+			if (isBody(data["objects"][next]))
+				batch.push_back(static_cast<int>(next));
+
+		data["objects@offset"] = next;
+		if (batch.empty())
+			return;
+	}
+
+	const size_t batchSize = std::max<size_t>(batch.size(), 1);
+	float* input_ptr = static_cast<float*>(malloc(sizeInFloats * batchSize * sizeof(float)));
+	if(!input_ptr)
+		throw std::bad_alloc();
+	std::shared_ptr<unsigned char> input(reinterpret_cast<unsigned char*>(input_ptr), [](unsigned char* ptr){ free(ptr);});
+
+	if (batch.empty())
+	{
+		cv::Mat image;
+		cv::resize(tdv::data::bsmToCvMat(data.at("image")), image, cv::Size(INPUT_W, INPUT_H));
+		blobFromImage(image, input_ptr);
+	}
+	else
+	{
+		tdv::data::Context& indices = data["objects@batch"];
+		indices.clear();
+		for (size_t i = 0; i < batch.size(); ++i)
+		{
+			data["objects@current_id"] = batch[i];
+			auto makeCrop = [&data, INPUT_W, INPUT_H](const cv::Mat& image) { return bodyCrop(image, data, INPUT_W, INPUT_H); };
+			const cv::Mat crop = useCropCache ?
+				tdv::data::cachedCrop(data, "simple", cv::Size(INPUT_W, INPUT_H), makeCrop) :
+				makeCrop(tdv::data::bsmToCvMat(data.at("image")));
+			blobFromImage(crop, input_ptr + i * sizeInFloats);
+			indices.push_back(static_cast<int64_t>(batch[i]));
+		}
+		data.erase("objects@current_id");
+	}
+
+	tdv::data::Context& inputData = data["objects@input"][0];
+	inputData["input_ptr"] = input;
+	inputData["batch_size"] = batchSize;
 }
 
 void BodyReidentificationModule::postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) {
 	if(buffer)
 	{
-		std::vector<float> embeds = getOutputData(buffer);
-		tdv::data::Context& output_data = data["output_data"];
-		tdv::data::Context& templateData = output_data["template"];
+		const size_t templateSize = static_cast<size_t>(getOutputShapes().front()[1]);
+		if (data.contains("objects@batch"))
+		{
+			tdv::data::Context& objects = data["objects"];
+			const tdv::data::Context& indices = data["objects@batch"];
+			for (size_t row = 0; row < indices.size(); ++row)
+			{
+				const float* embeds = getOutputData(buffer, row);
+				tdv::data::Context& obj = objects[indices[row].get<int64_t>()];
+				obj["template_size"] = static_cast<int64_t>(templateSize);
+				obj["template"] = std::vector<float>(embeds, embeds + templateSize);
+			}
+			data.erase("objects@batch");
+		}
+		else
+		{
+			// the whole image output is kept element-wise to be readable through the public API
+			const float* embeds = getOutputData(buffer, 0);
+			tdv::data::Context& output_data = data["output_data"];
+			tdv::data::Context& templateData = output_data["template"];
 
-		output_data["template_size"] = embeds.size();
+			output_data["template_size"] = templateSize;
 
-		for (double value : embeds)
-		{
-			templateData.push_back(value);
+			for (size_t i = 0; i < templateSize; ++i)
+			{
+				templateData.push_back(static_cast<double>(embeds[i]));
+			}
 		}
 	}
 }
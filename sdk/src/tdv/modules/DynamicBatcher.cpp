@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <numeric>
+
+#include <tdv/modules/DynamicBatcher.h>
+#include <tdv/utils/rassert/RAssert.h>
+
+
+namespace tdv {
+
+namespace modules {
+
+struct DynamicBatcher::Request
+{
+	const std::vector<void*>* input_data;
+	const Shapes* input_shapes;
+	int64_t batch_size;
+	std::chrono::steady_clock::time_point enqueued;
+
+	std::shared_ptr<uint8_t> output;
+	Shapes output_shapes;
+	std::promise<void> done;
+};
+
+namespace {
+
+std::vector<size_t> sampleSizes(const DynamicBatcher::Shapes& shapes, const std::vector<size_t>& element_sizes)
+{
+	std::vector<size_t> sizes;
+	for (size_t i = 0; i < shapes.size(); ++i)
+		sizes.push_back(std::accumulate(shapes[i].begin() + 1, shapes[i].end(), element_sizes[i], std::multiplies<size_t>()));
+	return sizes;
+}
+
+// shapes differ in the batch dimension only
+bool sameSampleShapes(const DynamicBatcher::Shapes& first, const DynamicBatcher::Shapes& second)
+{
+	for (size_t i = 0; i < first.size(); ++i)
+		if (first[i].size() != second[i].size() || !std::equal(first[i].begin() + 1, first[i].end(), second[i].begin() + 1))
+			return false;
+	return true;
+}
+
+std::shared_ptr<uint8_t> allocate(size_t size)
+{
+	uint8_t* buff = static_cast<uint8_t*>(malloc(std::max<size_t>(size, 1)));
+	if (!buff)
+		throw std::bad_alloc();
+	return std::shared_ptr<uint8_t>(buff, [](void *ptr){free(ptr);});
+}
+
+}
+
+DynamicBatcher::DynamicBatcher(InferFunction infer, const std::vector<size_t>& input_element_sizes,
+	const std::vector<size_t>& output_element_sizes, int64_t max_batch_size, double window_ms,
+	tdv::utils::metrics::BlockMetrics& metrics) :
+	inferFunction(infer),
+	inputElementSizes(input_element_sizes),
+	outputElementSizes(output_element_sizes),
+	maxBatchSize(std::max<int64_t>(max_batch_size, 1)),
+	window(static_cast<int64_t>(std::max(window_ms, 0.) * 1000)),
+	metrics(metrics)
+{
+	worker = std::thread(&DynamicBatcher::run, this);
+}
+
+DynamicBatcher::~DynamicBatcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopped = true;
+	}
+	condition.notify_all();
+	worker.join();
+}
+
+std::shared_ptr<uint8_t> DynamicBatcher::infer(const std::vector<void*>& input_data, const Shapes& input_shapes, Shapes& output_shapes)
+{
+	RHAssert2(0xb8b7c1b8, input_data.size() == inputElementSizes.size() && input_shapes.size() == inputElementSizes.size(),
+		"all model inputs are required for batched inference");
+	for (const auto& shape : input_shapes)
+		RHAssert2(0x41c5e0d2, !shape.empty() && shape[0] == input_shapes.front()[0], "inputs differ in the batch size");
+
+	Request request;
+	request.input_data = &input_data;
+	request.input_shapes = &input_shapes;
+	request.batch_size = input_shapes.front()[0];
+	request.enqueued = std::chrono::steady_clock::now();
+	std::future<void> result = request.done.get_future();
+
+	size_t queueDepth;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		RHAssert2(0xc69efb7d, !stopped, "batcher is stopped");
+		queue.push_back(&request);
+		queuedSamples += request.batch_size;
+		queueDepth = queue.size();
+	}
+	condition.notify_all();
+	metrics.queueDepth.record(queueDepth);
+
+	result.get();
+
+	output_shapes = std::move(request.output_shapes);
+	return request.output;
+}
+
+void DynamicBatcher::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		condition.wait(lock, [this]{ return stopped || !queue.empty(); });
+		if (queue.empty())
+			break;
+
+		// the window is counted from the arrival of the oldest request, which may have waited for the previous batch
+		const auto deadline = queue.front()->enqueued + window;
+		condition.wait_until(lock, deadline, [this]{ return stopped || queuedSamples >= maxBatchSize; });
+
+		std::vector<Request*> batch;
+		int64_t total_batch_size = 0;
+		while (!queue.empty() && (batch.empty() || (total_batch_size + queue.front()->batch_size <= maxBatchSize &&
+			sameSampleShapes(*queue.front()->input_shapes, *batch.front()->input_shapes))))
+		{
+			batch.push_back(queue.front());
+			total_batch_size += queue.front()->batch_size;
+			queue.pop_front();
+		}
+		queuedSamples -= total_batch_size;
+
+		lock.unlock();
+		metrics.inferences.add();
+		metrics.batchSize.record(static_cast<uint64_t>(total_batch_size));
+		process(batch, total_batch_size);
+		lock.lock();
+	}
+}
+
+void DynamicBatcher::process(const std::vector<Request*>& batch, int64_t total_batch_size)
+{
+	try
+	{
+		if (batch.size() == 1)
+		{
+			Request* request = batch.front();
+			request->output = inferFunction(*request->input_data, *request->input_shapes, request->output_shapes);
+			request->done.set_value();
+			return;
+		}
+
+		// gather: inputs are stored one after another, each input holds the samples of all requests
+		const size_t inputsCount = inputElementSizes.size();
+		const std::vector<size_t> inputSampleSizes = sampleSizes(*batch.front()->input_shapes, inputElementSizes);
+		const size_t totalSize = std::accumulate(inputSampleSizes.begin(), inputSampleSizes.end(), size_t(0)) * total_batch_size;
+		std::shared_ptr<uint8_t> input_buffer = allocate(totalSize);
+
+		uint8_t* dst = input_buffer.get();
+		for (size_t i = 0; i < inputsCount; ++i)
+		{
+			const size_t offset = std::accumulate(inputSampleSizes.begin(), inputSampleSizes.begin() + i, size_t(0));
+			for (const Request* request : batch)
+			{
+				const size_t size = inputSampleSizes[i] * request->batch_size;
+				memcpy(dst, static_cast<const uint8_t*>((*request->input_data)[i]) + offset * request->batch_size, size);
+				dst += size;
+			}
+		}
+
+		Shapes shapes = *batch.front()->input_shapes;
+		for (auto& shape : shapes)
+			shape[0] = total_batch_size;
+
+		Shapes output_shapes;
+		std::shared_ptr<uint8_t> output_buffer = inferFunction(std::vector<void*>(inputsCount, input_buffer.get()), shapes, output_shapes);
+
+		// scatter: split every output along the batch dimension
+		std::vector<size_t> outputSampleSizes;
+		for (size_t i = 0; i < output_shapes.size(); ++i)
+		{
+			RHAssert2(0x76dafa4d, !output_shapes[i].empty() && output_shapes[i][0] == total_batch_size,
+				"model output has no batch dimension, dynamic batching is not applicable");
+			outputSampleSizes.push_back(std::accumulate(output_shapes[i].begin() + 1, output_shapes[i].end(),
+				outputElementSizes[i], std::multiplies<size_t>()));
+		}
+		const size_t outputSampleSize = std::accumulate(outputSampleSizes.begin(), outputSampleSizes.end(), size_t(0));
+
+		int64_t first_sample = 0;
+		for (Request* request : batch)
+		{
+			request->output = allocate(outputSampleSize * request->batch_size);
+			request->output_shapes = output_shapes;
+
+			uint8_t* out = request->output.get();
+			const uint8_t* src = output_buffer.get();
+			for (size_t i = 0; i < output_shapes.size(); ++i)
+			{
+				const size_t size = outputSampleSizes[i] * request->batch_size;
+				memcpy(out, src + outputSampleSizes[i] * first_sample, size);
+				out += size;
+				src += outputSampleSizes[i] * total_batch_size;
+				request->output_shapes[i][0] = request->batch_size;
+			}
+			first_sample += request->batch_size;
+		}
+	}
+	catch (...)
+	{
+		for (Request* request : batch)
+			request->done.set_exception(std::current_exception());
+		return;
+	}
+
+	for (Request* request : batch)
+		request->done.set_value();
+}
+
+}
+}
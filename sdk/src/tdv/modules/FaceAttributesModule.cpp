@@ -0,0 +1,204 @@
+#include <exception>
+#include <future>
+
+#include <tdv/data/ContextUtils.h>
+#include <tdv/modules/FaceAttributesModule.h>
+#include <tdv/modules/AgeEstimationModule.h>
+#include <tdv/modules/EmotionsEstimationModule.h>
+#include <tdv/modules/GenderEstimationModule.h>
+#include <tdv/modules/GlassesEstimationModule.h>
+#include <tdv/modules/MaskEstimationModule.h>
+#include <tdv/utils/rassert/RAssert.h>
+
+namespace {
+
+using tdv::modules::BaseEstimationModule;
+
+std::unique_ptr<BaseEstimationModule> createEstimator(const tdv::data::Context& config)
+{
+	const std::string unitType = config.at("unit_type").get<std::string>();
+	if (unitType == "AGE_ESTIMATOR")
+		return std::unique_ptr<BaseEstimationModule>(new tdv::modules::AgeEstimationModule(config));
+	if (unitType == "GENDER_ESTIMATOR")
+		return std::unique_ptr<BaseEstimationModule>(new tdv::modules::GenderEstimationModule(config));
+	if (unitType == "EMOTION_ESTIMATOR")
+		return std::unique_ptr<BaseEstimationModule>(new tdv::modules::EmotionsEstimationModule(config));
+	if (unitType == "GLASSES_ESTIMATOR")
+		return std::unique_ptr<BaseEstimationModule>(new tdv::modules::GlassesEstimationModule(config));
+	if (unitType == "MASK_ESTIMATOR")
+		return std::unique_ptr<BaseEstimationModule>(new tdv::modules::MaskEstimationModule(config));
+	throw tdv::utils::rassert::tdv_error(0xc6aafc42, "unsupported attribute unit_type: " + unitType);
+}
+
+// the estimator objects hold the id and the estimator outputs only, see tdv::data::cachedCropsFrame
+void mergeObject(tdv::data::Context& result, tdv::data::Context& obj)
+{
+	for (auto it = result.kvbegin(); it != result.kvend(); ++it)
+		if (it->first != "id")
+			obj[it->first] = std::move(it->second);
+}
+
+}
+
+namespace tdv {
+
+namespace modules {
+
+
+FaceAttributesModule::FaceAttributesModule(const tdv::data::Context& config) :
+	profiler(config, "FACE_ATTRIBUTES")
+{
+	RHAssert2(0x390a679a, config.contains("attributes") && config.at("attributes").size(), "need attributes");
+
+	tdv::data::Context sharedConfig = config;
+	sharedConfig.erase("attributes");
+	sharedConfig.erase("unit_type");
+	// estimators are profiled as a part of this block
+	sharedConfig.erase("enable_profiling");
+
+	for (const tdv::data::Context& attribute : config.at("attributes"))
+	{
+		tdv::data::Context estimatorConfig = sharedConfig;
+		for (auto it = attribute.kvbegin(); it != attribute.kvend(); ++it)
+			estimatorConfig[it->first] = it->second;
+		estimatorConfig["batch_objects"] = true;
+		// estimators take the crops cached by cacheCrops, see operator()
+		estimatorConfig["use_crop_cache"] = true;
+
+		estimators.push_back(createEstimator(estimatorConfig));
+	}
+
+	for (size_t i = 1; i < estimators.size(); ++i)
+	{
+		workers.emplace_back(new Worker());
+		workers.back()->thread = std::thread(&Worker::loop, workers.back().get());
+	}
+}
+
+FaceAttributesModule::~FaceAttributesModule()
+{
+	for (auto& worker : workers)
+	{
+		{
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			worker->stopped = true;
+		}
+		worker->condition.notify_all();
+		worker->thread.join();
+	}
+}
+
+std::future<void> FaceAttributesModule::Worker::run(std::function<void()> task)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (busy)
+		return std::future<void>();
+
+	busy = true;
+	this->task = std::packaged_task<void()>(std::move(task));
+	std::future<void> result = this->task.get_future();
+	condition.notify_all();
+	return result;
+}
+
+void FaceAttributesModule::Worker::loop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		condition.wait(lock, [this]{ return stopped || task.valid(); });
+		if (!task.valid())
+			break;
+
+		std::packaged_task<void()> current = std::move(task);
+		lock.unlock();
+		current();
+		lock.lock();
+		busy = false;
+	}
+}
+
+void FaceAttributesModule::operator ()(tdv::data::Context& data)
+{
+	using tdv::utils::profiler::StageTimer;
+
+	RHAssert2(0xa0c330b6, data.contains("objects"), "need objects");
+
+	tdv::utils::profiler::Profile profile;
+	tdv::utils::profiler::ProfileScope profileScope(profiler.isEnabled() ? &profile : tdv::utils::profiler::Profile::current());
+	tdv::utils::profiler::BlockScope blockScope(profiler, data);
+
+	tdv::data::Context& objects = data["objects"];
+	if (!objects.empty())
+	{
+		// estimators with the same crop type and input size hit the crops of the first one
+		{
+			StageTimer timer("crops");
+			for (auto& estimator : estimators)
+				estimator->cacheCrops(data);
+		}
+
+		// every estimator works on its own frame of the object ids and crops, so it writes nothing but its outputs
+		std::vector<tdv::data::Context> results;
+		{
+			StageTimer timer("inference");
+			const tdv::data::Context frame = tdv::data::cachedCropsFrame(data);
+			results.assign(estimators.size(), frame);
+
+			// the estimator stages are recorded to the profile and metrics of this block
+			std::vector<std::unique_ptr<tdv::utils::profiler::TaskProfile>> taskProfiles;
+			std::vector<std::future<void>> tasks;
+			for (size_t i = 1; i < estimators.size(); ++i)
+			{
+				taskProfiles.emplace_back(new tdv::utils::profiler::TaskProfile());
+				tdv::utils::profiler::TaskProfile* taskProfile = taskProfiles.back().get();
+				tasks.push_back(workers[i - 1]->run([this, &results, i, taskProfile]()
+				{
+					tdv::utils::profiler::TaskProfile::Scope taskScope(*taskProfile);
+					(*estimators[i])(results[i]);
+				}));
+			}
+
+			std::exception_ptr error;
+			try
+			{
+				(*estimators.front())(results.front());
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			// the tasks reference the results, they must be done before leaving the scope;
+			// the estimators of busy workers (a concurrent call) run on the calling thread
+			for (size_t i = 0; i < tasks.size(); ++i)
+			{
+				try
+				{
+					if (tasks[i].valid())
+						tasks[i].get();
+					else if (!error)
+						(*estimators[i + 1])(results[i + 1]);
+				}
+				catch (...)
+				{
+					if (!error)
+						error = std::current_exception();
+				}
+			}
+			for (auto& taskProfile : taskProfiles)
+				taskProfile->merge();
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+		StageTimer timer("merge");
+		for (size_t i = 0; i < objects.size(); ++i)
+			for (tdv::data::Context& result : results)
+				mergeObject(result["objects"][i], objects[i]);
+	}
+
+	profiler.write(profile, data);
+}
+
+}
+}
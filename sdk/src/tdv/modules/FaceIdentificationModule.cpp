@@ -45,21 +45,26 @@ cv::Mat blobFromImage(cv::Mat& image, int nchannel = 3, const int ddepth=CV_32F)
 }
 
 
-void processObject(cv::Mat &image, const tdv::data::Context data, const int input_width, const int input_height){
+cv::Mat processObject(const cv::Mat &image, const tdv::data::Context& data, const int input_width, const int input_height,
+	tdv::utils::alignment::AlignmentMethod alignmentMethod){
 	const tdv::data::Context& obj = data["objects"][data["objects@current_id"].get<int>()];
 
-	int img_width = data["image"]["shape"][1].get<int64_t>();
-	int img_height = data["image"]["shape"][0].get<int64_t>();
-
+	cv::Mat crop;
 	if (obj.contains("keypoints")){
-		const cv::Matx23f crop2image = makeCrop2ImageByPoints(obj["keypoints"], image, (std::max)(input_width, input_height));
-		warpAffine(image, image, crop2image, cv::Size(input_width, input_height));
+		const cv::Matx23f crop2image = makeCrop2ImageByPoints(obj["keypoints"], image, (std::max)(input_width, input_height), alignmentMethod);
+		tdv::utils::recognizer_utils::warpAffine(image, crop, crop2image, cv::Size(input_width, input_height));
 	}else{
 		const tdv::data::Context& rectCtx = obj["bbox"];
 		cv::Point bbox_top_left = {clip(static_cast<int>(rectCtx[0].get<double>() * image.cols), 0, image.cols), clip(static_cast<int>(rectCtx[1].get<double>() * image.rows), 0 , image.rows)}; //TODO add border of image
 		cv::Point bbox_bottom_right = {clip(static_cast<int>(rectCtx[2].get<double>() * image.cols), 0, image.cols), clip(static_cast<int>(rectCtx[3].get<double>() * image.rows), 0 , image.rows)}; //TODO add border of image
-		image = image(cv::Rect(bbox_top_left,bbox_bottom_right));
+		crop = image(cv::Rect(bbox_top_left,bbox_bottom_right));
 	}
+
+	RHAssert2(0x11113333, crop.depth() == CV_8U || crop.depth() == CV_32F, "only 8U and 32F image types are suported");
+
+	cv::Mat resized;
+	cv::resize(crop, resized, cv::Size(input_width, input_height));
+	return resized;
 }
 
 void l2Normalize(std::vector<float> &input_output){
@@ -85,7 +90,9 @@ namespace modules {
 
 
 FaceIdentificationModule::FaceIdentificationModule(const tdv::data::Context& config) :
-		ONNXModule<FaceIdentificationModule>(config)
+		ONNXModule<FaceIdentificationModule>(config),
+		useCropCache(config.get<bool>("use_crop_cache", true)),
+		alignmentMethod(tdv::utils::alignment::alignmentMethodFromString(config.get<std::string>("alignment_method", "closed_form")))
 {};
 
 std::vector<float> FaceIdentificationModule::getOutputData(std::shared_ptr<uint8_t> buff)
@@ -103,32 +110,52 @@ std::vector<float> FaceIdentificationModule::getOutputData(std::shared_ptr<uint8
 
 void FaceIdentificationModule::preprocess(tdv::data::Context& data) {
 
-	Context& firstInput = data["image"];
-	cv::Mat image = tdv::data::bsmToCvMat(firstInput, true);
-
+	// uint8 models take NHWC images
+	const bool uint8Input = isUint8Input();
 	const auto& shape = this->getInputShapes();
-	const auto& INPUT_H = shape.front()[2];
-	const auto& INPUT_W = shape.front()[3];
-	const auto& N_CHANNEL = shape.front()[1];
+	const auto& INPUT_H = shape.front()[uint8Input ? 1 : 2];
+	const auto& INPUT_W = shape.front()[uint8Input ? 2 : 3];
+	const auto& N_CHANNEL = shape.front()[uint8Input ? 3 : 1];
 
+	cv::Mat image;
 	if (data.contains("objects")){
-		processObject(image, data, INPUT_W, INPUT_H);
+		auto makeCrop = [this, &data, INPUT_W, INPUT_H](const cv::Mat& input) { return processObject(input, data, INPUT_W, INPUT_H, alignmentMethod); };
+		// the bbox crop is the same as the estimators' simple crop
+		const bool aligned = data["objects"][data["objects@current_id"].get<int>()].contains("keypoints");
+		const char* cropType = !aligned ? "simple" :
+			alignmentMethod == tdv::utils::alignment::AlignmentMethod::ROBUST ? "face_alignment_robust" : "face_alignment";
+		image = useCropCache ?
+			tdv::data::cachedCrop(data, cropType, cv::Size(INPUT_W, INPUT_H), makeCrop) :
+			makeCrop(tdv::data::bsmToCvMat(data["image"]));
+	}else{
+		image = tdv::data::bsmToCvMat(data["image"]);
+		RHAssert2(0x11113333, image.depth() == CV_8U || image.depth() == CV_32F, "only 8U and 32F image types are suported");
+		cv::resize(image, image, cv::Size(INPUT_W, INPUT_H));
 	}
 
-	RHAssert2(0x11113333, image.depth() == CV_8U || image.depth() == CV_32F, "only 8U and 32F image types are suported");
-
-	cv::resize(image, image, cv::Size(INPUT_W, INPUT_H));
-
-	size_t sizeInBytes = INPUT_W * INPUT_H * N_CHANNEL * sizeof(float);
+	size_t sizeInBytes = INPUT_W * INPUT_H * N_CHANNEL * (uint8Input ? sizeof(uint8_t) : sizeof(float));
 	unsigned char* input_ptr = static_cast<unsigned char*>(malloc(sizeInBytes));
 	if(!input_ptr)
 		throw std::bad_alloc();
-	cv::Mat img_blob = blobFromImage(image, N_CHANNEL);
+	std::shared_ptr<unsigned char> input(input_ptr, [](unsigned char* ptr){ free(ptr);});
+
+	if (uint8Input)
+	{
+		// the model casts the crop to float itself
+		if (image.channels() == 1)
+			cv::cvtColor(image, image, cv::COLOR_GRAY2RGB);
+		RHAssert2(0xe705e26f, image.type() == CV_8UC3 && N_CHANNEL == 3, "uint8 model input needs 8U images with 1 or 3 channels");
+		image.copyTo(cv::Mat(INPUT_H, INPUT_W, CV_8UC3, input_ptr));
+	}
+	else
+	{
+		cv::Mat img_blob = blobFromImage(image, N_CHANNEL);
 
-	memcpy(input_ptr, img_blob.data, sizeInBytes);
+		memcpy(input_ptr, img_blob.data, sizeInBytes);
+	}
 
 	tdv::data::Context& inputData = data["objects@input"][0];
-	inputData["input_ptr"] = std::shared_ptr<unsigned char>(input_ptr, [](unsigned char* ptr){ free(ptr);});
+	inputData["input_ptr"] = input;
 }
 
 void FaceIdentificationModule::postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) {
@@ -8,7 +8,8 @@ namespace modules {
 
 
 FitterModule::FitterModule(const tdv::data::Context& config):
-	BaseEstimationModule(config)
+	// all faces are fitted in one batch, the fitter precedes recognition and the attribute estimators
+	BaseEstimationModule(config, true)
 {
 	this->module_version = config.get<int64_t>("model_version", 1);
 	if (module_version == 1)
@@ -51,7 +51,9 @@ HpeResnetV1DModule::HpeResnetV1DModule(const tdv::data::Context &config) :
 	ONNXModule<HpeResnetV1DModule>(config),
 	RAW_OUTPUT(config.get<bool>("raw_output", false)),
 	LABEL_MAP(read_label_map(config.at("label_map").get<std::string>()))
-	{}
+{
+	heatmapParameters.refinement = tdv::utils::heatmap_utils::heatmapRefinementFromString(config.get<std::string>("heatmap_refinement", "dark"));
+}
 
 
 void HpeResnetV1DModule::preprocess(tdv::data::Context &data)
@@ -114,29 +116,41 @@ void HpeResnetV1DModule::postprocess(std::shared_ptr<uint8_t> buffer, tdv::data:
 	if (buffer)
 	{
 		const Context &meta = data["objects@input"][0];
-		std::map<int, std::vector<std::vector<float>>> keypoints = getOutputData(buffer, meta);
+		const std::vector<float> keypoints = getOutputData(buffer, meta);
 		if (!RAW_OUTPUT)
 		{
+			const size_t joints = getOutputShapes().front()[1];
 			std::vector<int> dims;
 			for (const auto &dim: data["image"]["shape"])
 				dims.push_back(static_cast<int>(dim.get<int64_t>()));
-			for (Context &obj: data["objects"])
-			{
-				int id = obj["id"].get<int64_t>();
-				obj["keypoints"] = pose_vector2normalizedCtx(keypoints[id], LABEL_MAP, dims);
-			}
+			// objects are batched in their order, see preprocess
+			Context &objects = data["objects"];
+			for (size_t p = 0; p < objects.size(); ++p)
+				objects[p]["keypoints"] = pose_vector2normalizedCtx(keypoints.data() + p * joints * 3, joints, LABEL_MAP, dims);
 		}
 	}
 }
 
-std::map<int, std::vector<std::vector<float>>>
+std::vector<float>
 HpeResnetV1DModule::getOutputData(std::shared_ptr<uint8_t> buff, const tdv::data::Context &meta)
 {
-	size_t predict_heatmap{17}, predict_width{64}, predict_height{48};
-	std::map<int, std::vector<std::vector<float>>> keypoints;
-	for (size_t p = 0; p < meta["id"].size(); ++p)
+	// heatmaps [persons, joints, height, width] with the stride of the model input
+	const auto &heatmapShape = getOutputShapes().front();
+	const auto &inputShape = getInputShapes().front();
+	const size_t persons = meta["id"].size();
+	const size_t joints = heatmapShape[1];
+	const size_t heatmapHeight = heatmapShape[2];
+	const size_t heatmapWidth = heatmapShape[3];
+	const double strideX = static_cast<double>(inputShape[3]) / heatmapWidth;
+	const double strideY = static_cast<double>(inputShape[2]) / heatmapHeight;
+	RHAssert2(0xba2b5116, static_cast<int64_t>(persons) <= heatmapShape[0], "heatmaps of some persons are missing");
+
+	std::vector<float> keypoints(persons * joints * 3);
+	tdv::utils::heatmap_utils::decodeHeatmaps(reinterpret_cast<const float *>(buff.get()), persons * joints,
+		heatmapHeight, heatmapWidth, heatmapParameters, keypoints.data());
+
+	for (size_t p = 0; p < persons; ++p)
 	{
-		int id = meta["id"][p].get<int64_t>();
 		auto &offset = meta["result_offset"][p];
 		auto heatmapShiftX = offset[0].get<double>();
 		auto heatmapShiftY = offset[1].get<double>();
@@ -145,21 +159,11 @@ HpeResnetV1DModule::getOutputData(std::shared_ptr<uint8_t> buff, const tdv::data
 		auto shiftX = offset[3].get<double>();
 		auto shiftY = offset[4].get<double>();
 
-		keypoints[id] = std::vector<std::vector<float>>(predict_heatmap, std::vector<float>(3, 0.0));
-		for (size_t h = 0; h < predict_heatmap; ++h)
+		float *point = keypoints.data() + p * joints * 3;
+		for (size_t h = 0; h < joints; ++h, point += 3)
 		{
-			float *blob_data = reinterpret_cast<float *>(buff.get() + sizeof(float) *
-																	  ((p * predict_heatmap + h) *
-																	   predict_width * predict_height));
-			cv::Mat heatmap(predict_width, predict_height, CV_32F, blob_data);
-			double minVal;
-			double maxVal;
-			cv::Point minLoc;
-			cv::Point maxLoc;
-			minMaxLoc(heatmap, &minVal, &maxVal, &minLoc, &maxLoc);
-			keypoints[id][h][0] = (4 * maxLoc.x - heatmapShiftX) * scaleX + shiftX;
-			keypoints[id][h][1] = (4 * maxLoc.y - heatmapShiftY) * scaleY + shiftY;
-			keypoints[id][h][2] = maxVal;
+			point[0] = (strideX * point[0] - heatmapShiftX) * scaleX + shiftX;
+			point[1] = (strideY * point[1] - heatmapShiftY) * scaleY + shiftY;
 		}
 	}
 	return keypoints;
@@ -9,26 +9,21 @@
 
 
 namespace {
-cv::Mat blobFromImage(cv::Mat& image, int nchannel = 3, const int ddepth=CV_32F) 
+// writes the image as planar float RGB to output
+void blobFromImage(cv::Mat& image, unsigned char* output, int nchannel = 3)
 {
-	cv::Mat output;
 	if(image.channels() == 1)
 		cv::cvtColor(image, image, cv::COLOR_GRAY2RGB);
 	image.convertTo(image, CV_32FC3);
 
 	int nch = image.channels();
-	int sz[] = { 1, nchannel, image.rows, image.cols};
-
-	output.create(4, sz, ddepth);
+	RHAssert2(0x11561385, nchannel == 3 && nch == 3, "Need 3 channel image (RGB)");
 
 	std::vector<cv::Mat> ch(nch);
-	
+	const size_t planeSize = image.total() * sizeof(float);
 	for( int j = 0; j < nchannel; j++ )
-		ch[j] = cv::Mat(image.rows, image.cols, ddepth, output.ptr(0,j));
+		ch[j] = cv::Mat(image.rows, image.cols, CV_32F, output + j * planeSize);
 	cv::split(image, ch);
-
-	RHAssert2(0x11561385, nchannel == 3 && nch == 3, "Need 3 channel image (RGB)");
-	return output;
 }
 
 std::vector<float> softmax(const std::vector<float> data)
@@ -58,18 +53,20 @@ namespace tdv {
 namespace modules {
 
 
+// Accepts a single {"image"} context or an array of them (see MultiInputAdapter),
+// all images of an array are processed as one batch if the model has a dynamic batch dimension
 LivenessBaseModule::LivenessBaseModule(const tdv::data::Context& config):
-	ONNXModule<LivenessBaseModule>(config)
+	ONNXModule<LivenessBaseModule>(config, std::make_shared<MultiInputAdapter>())
 {}
 
-std::vector<float> LivenessBaseModule::getOutputData(std::shared_ptr<uint8_t> buff) const
+std::vector<float> LivenessBaseModule::getOutputData(std::shared_ptr<uint8_t> buff, size_t batch_index) const
 {
 	const auto& shapes = getOutputShapes();
 
-	RHAssert2(0xcb64809c, shapes.front()[0] == 1, "batch output not supported yet");
+	RHAssert2(0xcb64809c, static_cast<int64_t>(batch_index) < shapes.front()[0], "batch index is out of range");
 
 	size_t predict_shape{static_cast<size_t>(shapes.front()[1])};
-	float* blob_data = reinterpret_cast<float*>(buff.get());
+	float* blob_data = reinterpret_cast<float*>(buff.get()) + batch_index * predict_shape;
 
 	std::vector<float> result_predict{blob_data, blob_data + predict_shape};
 
@@ -78,28 +75,41 @@ std::vector<float> LivenessBaseModule::getOutputData(std::shared_ptr<uint8_t> bu
 
 void LivenessBaseModule::preprocess(tdv::data::Context& data) {
 
-	Context& firstInput = data["image"];
-	cv::Mat image = tdv::data::bsmToCvMat(firstInput, true);
-
-	RHAssert2(0x7a11d233,  image.depth() == CV_8U ||  image.depth() == CV_32F, "only 8U and 32F image types are suported");
+	Context& images = data.at("input");
+	const int64_t first = data.get<int64_t>("input@offset", 0);
+	const int64_t count = static_cast<int64_t>(images.size()) - first;
+	const int64_t batchSize = getDynamicBatchEnabled().front() ? count : std::min<int64_t>(count, 1);
+	if (batchSize <= 0)
+		return;
 
 	const auto& shape = getInputShapes();
 	const auto& INPUT_SIZE = shape.front()[2];
 	const auto& N_CHANNEL = shape.front()[1];
 
-	cv::resize(image, image, cv::Size(INPUT_SIZE, INPUT_SIZE), 0, 0);
-
 	size_t sizeInBytes = INPUT_SIZE * INPUT_SIZE * N_CHANNEL * sizeof(float);
-	unsigned char* input_ptr = static_cast<unsigned char*>(malloc(sizeInBytes));
+	unsigned char* input_ptr = static_cast<unsigned char*>(malloc(sizeInBytes * batchSize));
 
 	if(!input_ptr)
 		throw std::bad_alloc();
-	cv::Mat img_blob = blobFromImage(image, N_CHANNEL);
+	std::shared_ptr<unsigned char> input(input_ptr, [](unsigned char* ptr){ free(ptr);});
 
-	memcpy(input_ptr, img_blob.data, sizeInBytes);
+	for (int64_t i = 0; i < batchSize; ++i)
+	{
+		// conversions below allocate new buffers, so the input image is not modified
+		cv::Mat image = tdv::data::bsmToCvMat(images[first + i].at("image"));
+
+		RHAssert2(0x7a11d233,  image.depth() == CV_8U ||  image.depth() == CV_32F, "only 8U and 32F image types are suported");
+
+		if (image.rows != INPUT_SIZE || image.cols != INPUT_SIZE)
+			cv::resize(image, image, cv::Size(INPUT_SIZE, INPUT_SIZE), 0, 0);
+
+		blobFromImage(image, input_ptr + i * sizeInBytes, N_CHANNEL);
+	}
 
 	Context& inputData = data["objects@input"][0];
-	inputData["input_ptr"] = std::shared_ptr<unsigned char>(input_ptr, [](unsigned char* ptr){ free(ptr);});
+	inputData["input_ptr"] = input;
+	inputData["batch_size"] = static_cast<size_t>(batchSize);
+	data["input@offset"] = first + batchSize;
 	return;
 }
 
@@ -107,17 +117,22 @@ void LivenessBaseModule::preprocess(tdv::data::Context& data) {
 void LivenessBaseModule::postprocess(std::shared_ptr<uint8_t> buffer, tdv::data::Context& data) {
 	if(buffer)
 	{
-		std::vector<float> pre_predict = getOutputData(buffer);
-		std::vector<float> predict = softmax(pre_predict);
-		tdv::data::Context& objects = data["objects"];
-		objects.clear();
-		
-		tdv::data::Context face;
-		face["liveness"] = static_cast<double>(predict[1]);
-		objects.push_back(std::move(face));
-		
+		const size_t batchSize = data.at("objects@input")[0].at("batch_size").get<size_t>();
+		const int64_t first = data.at("input@offset").get<int64_t>() - batchSize;
+		for (size_t i = 0; i < batchSize; ++i)
+		{
+			std::vector<float> pre_predict = getOutputData(buffer, i);
+			std::vector<float> predict = softmax(pre_predict);
+			tdv::data::Context& objects = data.at("input")[first + i]["objects"];
+			objects.clear();
+
+			tdv::data::Context face;
+			face["liveness"] = static_cast<double>(predict[1]);
+			objects.push_back(std::move(face));
+		}
 	}
 }
 
 }
-}
\ No newline at end of file
+}
+
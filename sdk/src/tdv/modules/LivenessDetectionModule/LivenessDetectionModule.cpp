@@ -7,6 +7,7 @@
 #include <tdv/modules/LivenessDetectionModule/LivenessBaseModule.h>
 #include <tdv/utils/rassert/RAssert.h>
 #include <math.h>
+#include <exception>
 #include <opencv2/core.hpp>
 
 namespace {
@@ -69,7 +70,8 @@ namespace tdv {
 namespace modules {
 
 LivenessDetectionModule::LivenessDetectionModule(const tdv::data::Context& config):
-			LIVENESS_THRESH(config.get<double>("liveness_threshold", 0.9))
+			LIVENESS_THRESH(config.get<double>("liveness_threshold", 0.9)),
+			profiler(config, "LIVENESS_ESTIMATOR")
 {
 	Context LivenessModel2_7Ctx;
 	LivenessModel2_7Ctx["model_path"] = config["model_scale2.7_path"];
@@ -82,94 +84,188 @@ LivenessDetectionModule::LivenessDetectionModule(const tdv::data::Context& confi
 
 	model1 = std::make_shared<tdv::modules::LivenessBaseModule> (LivenessModel2_7Ctx);
 	model2 = std::make_shared<tdv::modules::LivenessBaseModule> (LivenessModel4_0Ctx);
+
+	worker = std::thread(&LivenessDetectionModule::runWorker, this);
 }
 
-void LivenessDetectionModule::operator ()(tdv::data::Context& data)
+LivenessDetectionModule::~LivenessDetectionModule()
 {
-	RHAssert2(0xaa59e948, data.contains("objects"), "need objects");
-	for(int i = 0; i < data["objects"].size(); i++){
-		data["objects@current_id"] = i;
-		this->process(data);
+	{
+		std::lock_guard<std::mutex> lock(workerMutex);
+		workerStopped = true;
 	}
-	data.erase("objects@current_id");
+	workerCondition.notify_all();
+	worker.join();
 }
 
+std::future<void> LivenessDetectionModule::runOnWorker(std::function<void()> task)
+{
+	std::lock_guard<std::mutex> lock(workerMutex);
+	if (workerBusy)
+		return std::future<void>();
+
+	workerBusy = true;
+	workerTask = std::packaged_task<void()>(std::move(task));
+	std::future<void> result = workerTask.get_future();
+	workerCondition.notify_all();
+	return result;
+}
 
-void LivenessDetectionModule::process(tdv::data::Context& data)
+void LivenessDetectionModule::runWorker()
 {
-	tdv::data::Context& obj = data["objects"][data["objects@current_id"].get<int>()];
-	if(obj.get<std::string>("class", "").compare("face"))
+	std::unique_lock<std::mutex> lock(workerMutex);
+	while (true)
 	{
-		RHAssert2(0x7a11d253,  false, "input is not a face!");
-	}
-	tdv::data::Context& firstInput = data["image"];
-	cv::Mat input = tdv::data::bsmToCvMat(firstInput, true);
-
-	cv::cvtColor(input, input, cv::COLOR_BGR2RGB);
-
-	const Context& rectCtx = obj["bbox"];  // const overload calls .at()
-
-	int face_bbox_top_left_x =     clip(static_cast<int>(rectCtx[0].get<double>() * input.cols), 0, input.cols);
-	int face_bbox_top_left_y =     clip(static_cast<int>(rectCtx[1].get<double>() * input.rows), 0 , input.rows);
-	int face_bbox_bottom_rigth_x = clip(static_cast<int>(rectCtx[2].get<double>() * input.cols), 0, input.cols);
-	int face_bbox_bottom_rigth_y = clip(static_cast<int>(rectCtx[3].get<double>() * input.rows), 0 , input.rows);
-
-	// TODO: Below is an EXAMPLE of getting a face crop. Now face_detector returns a rectangular bbox, but we need a square bbox to work correctly.
-	//we need a square bbox, but rectangle given, so:
-	int correction_element = ((face_bbox_bottom_rigth_y - face_bbox_top_left_y) - (face_bbox_bottom_rigth_x - face_bbox_top_left_x)) / 2;
-	int bbox_top_left_x = face_bbox_top_left_x;
-	int bbox_top_left_y = face_bbox_top_left_y + correction_element;
-	int side_length = face_bbox_bottom_rigth_x - face_bbox_top_left_x;
-
-	cv::Rect detection = cv::Rect(bbox_top_left_x, bbox_top_left_y, side_length, side_length);
-	cv::Mat image = input(detection);
+		workerCondition.wait(lock, [this]{ return workerStopped || workerTask.valid(); });
+		if (!workerTask.valid())
+			break;
 
-	const cv::Rect optimal_rect1 = getRectScale(detection, input.size(), scales[0]);
-	const cv::Rect optimal_rect2 = getRectScale(detection, input.size(), scales[1]);
+		std::packaged_task<void()> task = std::move(workerTask);
+		lock.unlock();
+		task();
+		lock.lock();
+		workerBusy = false;
+	}
+}
 
-	cv::Mat crop1, crop2;
-	cv::resize(input(optimal_rect1), crop1, cv::Size(80, 80));
-	cv::resize(input(optimal_rect2), crop2, cv::Size(80, 80));
+void LivenessDetectionModule::operator ()(tdv::data::Context& data)
+{
+	RHAssert2(0xaa59e948, data.contains("objects"), "need objects");
 
-	if (input.channels() == 1  ) {
-		cv::cvtColor(crop1, crop1, cv::COLOR_GRAY2RGB);
-		cv::cvtColor(crop2, crop2, cv::COLOR_GRAY2RGB);
+	tdv::utils::profiler::Profile profile;
+	{
+		tdv::utils::profiler::ProfileScope profileScope(profiler.isEnabled() ? &profile : tdv::utils::profiler::Profile::current());
+		tdv::utils::profiler::BlockScope blockScope(profiler, data);
+		this->process(data, profile);
 	}
 
-	crop1.convertTo(crop1, CV_32FC3);
-	crop2.convertTo(crop2, CV_32FC3);
+	profiler.write(profile, data);
+}
 
-	tdv::data::Context livenessIoData1;
-	tdv::data::Context& livenessImg1Context = livenessIoData1["image"];
-	tdv::data::cvMatToBsm(livenessImg1Context, crop1);
 
-	tdv::data::Context livenessIoData2;
-	tdv::data::Context& livenessImg2Context = livenessIoData2["image"];
-	tdv::data::cvMatToBsm(livenessImg2Context, crop2);
+// Crops of all faces are gathered into two batches (one per scale) processed by both models concurrently
+void LivenessDetectionModule::process(tdv::data::Context& data, tdv::utils::profiler::Profile& profile)
+{
+	tdv::data::Context& objects = data["objects"];
+	if (objects.empty())
+		return;
 
-//////////////////////////////////////
-	(*model1)(livenessIoData1);///////
-	(*model2)(livenessIoData2);///////
-//////////////////////////////////////
+	const cv::Mat input = tdv::data::bsmToCvMat(data["image"]);
 
-	float predict1;
-	float predict2;
-	for(const Context& obj : livenessIoData1["objects"])
+	// crops are kept alive until inference is done, the batches reference their data
+	std::vector<cv::Mat> crops1, crops2;
+	tdv::data::Context livenessIoData1, livenessIoData2;
+	for (size_t i = 0; i < objects.size(); ++i)
 	{
-		predict1 = obj["liveness"].get<double>();
+		const Context& obj = objects[i];
+		profile.setObject(i);
+		tdv::utils::profiler::TraceSpan objectSpan("object", "object", i);
+		tdv::utils::profiler::StageTimer cropTimer("crop");
+
+		if(obj.get<std::string>("class", "").compare("face"))
+		{
+			RHAssert2(0x7a11d253,  false, "input is not a face!");
+		}
+
+		const Context& rectCtx = obj["bbox"];  // const overload calls .at()
+
+		int face_bbox_top_left_x =     clip(static_cast<int>(rectCtx[0].get<double>() * input.cols), 0, input.cols);
+		int face_bbox_top_left_y =     clip(static_cast<int>(rectCtx[1].get<double>() * input.rows), 0 , input.rows);
+		int face_bbox_bottom_rigth_x = clip(static_cast<int>(rectCtx[2].get<double>() * input.cols), 0, input.cols);
+		int face_bbox_bottom_rigth_y = clip(static_cast<int>(rectCtx[3].get<double>() * input.rows), 0 , input.rows);
+
+		// TODO: Below is an EXAMPLE of getting a face crop. Now face_detector returns a rectangular bbox, but we need a square bbox to work correctly.
+		//we need a square bbox, but rectangle given, so:
+		int correction_element = ((face_bbox_bottom_rigth_y - face_bbox_top_left_y) - (face_bbox_bottom_rigth_x - face_bbox_top_left_x)) / 2;
+		int bbox_top_left_x = face_bbox_top_left_x;
+		int bbox_top_left_y = face_bbox_top_left_y + correction_element;
+		int side_length = face_bbox_bottom_rigth_x - face_bbox_top_left_x;
+
+		cv::Rect detection = cv::Rect(bbox_top_left_x, bbox_top_left_y, side_length, side_length);
+
+		const cv::Rect optimal_rect1 = getRectScale(detection, input.size(), scales[0]);
+		const cv::Rect optimal_rect2 = getRectScale(detection, input.size(), scales[1]);
+
+		cv::Mat crop1, crop2;
+		cv::resize(input(optimal_rect1), crop1, cv::Size(80, 80));
+		cv::resize(input(optimal_rect2), crop2, cv::Size(80, 80));
+
+		// colour conversion of the 80x80 crops only
+		const int conversion = input.channels() == 1 ? cv::COLOR_GRAY2RGB : cv::COLOR_BGR2RGB;
+		cv::cvtColor(crop1, crop1, conversion);
+		cv::cvtColor(crop2, crop2, conversion);
+
+		crop1.convertTo(crop1, CV_32FC3);
+		crop2.convertTo(crop2, CV_32FC3);
+		crops1.push_back(crop1);
+		crops2.push_back(crop2);
+
+		tdv::data::Context livenessInput1, livenessInput2;
+		tdv::data::cvMatToBsm(livenessInput1["image"], crops1.back());
+		tdv::data::cvMatToBsm(livenessInput2["image"], crops2.back());
+		livenessIoData1.push_back(std::move(livenessInput1));
+		livenessIoData2.push_back(std::move(livenessInput2));
 	}
-	for(const Context& obj : livenessIoData2["objects"])
+	profile.setObject(-1);
+
 	{
-		predict2 = obj["liveness"].get<double>();
+		tdv::utils::profiler::StageTimer timer("liveness_models");
+
+		// the worker stages are recorded to the profile and metrics of this call
+		tdv::utils::profiler::TaskProfile taskProfile;
+		std::future<void> scale2 = runOnWorker([this, &livenessIoData2, &taskProfile]()
+		{
+			tdv::utils::profiler::TaskProfile::Scope taskScope(taskProfile);
+			(*model2)(livenessIoData2);
+		});
+
+		std::exception_ptr error;
+		try
+		{
+			(*model1)(livenessIoData1);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		// the task references the batch, it must be done before leaving the scope
+		try
+		{
+			if (scale2.valid())
+				scale2.get();
+			else if (!error)
+				(*model2)(livenessIoData2);
+		}
+		catch (...)
+		{
+			if (!error)
+				error = std::current_exception();
+		}
+		taskProfile.merge();
+
+		if (error)
+			std::rethrow_exception(error);
 	}
 
-	tdv::data::Context& liveness = obj["liveness"];
-	liveness["confidence"] = static_cast<double>(predict1 + predict2) / 2.0f;
+	for (size_t i = 0; i < objects.size(); ++i)
+	{
+		profile.setObject(i);
+		tdv::utils::profiler::TraceSpan objectSpan("object", "object", i);
+		tdv::utils::profiler::StageTimer timer("postprocess");
+
+		const float predict1 = livenessIoData1[i]["objects"][0]["liveness"].get<double>();
+		const float predict2 = livenessIoData2[i]["objects"][0]["liveness"].get<double>();
+
+		tdv::data::Context& liveness = objects[i]["liveness"];
+		liveness["confidence"] = static_cast<double>(predict1 + predict2) / 2.0f;
 
-	if (((predict1 + predict2) / 2.0f) > LIVENESS_THRESH)
-		liveness["value"] = static_cast<std::string>("REAL");
-	else
-		liveness["value"] = static_cast<std::string>("FAKE");
+		if (((predict1 + predict2) / 2.0f) > LIVENESS_THRESH)
+			liveness["value"] = static_cast<std::string>("REAL");
+		else
+			liveness["value"] = static_cast<std::string>("FAKE");
+	}
+	profile.setObject(-1);
 }
 
 }
@@ -67,14 +67,22 @@ namespace tdv {
 namespace modules {
 
 MatcherModule::MatcherModule(const tdv::data::Context& config):
-	threshold(config.get<double>("threshold", 1.175))
+	threshold(config.get<double>("threshold", 1.175)),
+	profiler(config, "MATCHER_MODULE")
 {}
 
 void MatcherModule::operator ()(tdv::data::Context& data)
 {
 	if(data.contains("verification"))
 	{
-		verifyMatch(data["verification"]);
+		tdv::utils::profiler::Profile profile;
+		{
+			tdv::utils::profiler::ProfileScope profileScope(profiler.isEnabled() ? &profile : tdv::utils::profiler::Profile::current());
+			tdv::utils::profiler::BlockScope blockScope(profiler, data);
+			tdv::utils::profiler::StageTimer timer("verification");
+			verifyMatch(data["verification"]);
+		}
+		profiler.write(profile, data);
 	}
 	else
 	{
@@ -1,8 +1,15 @@
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
 #include <numeric>
+#include <set>
+#include <sstream>
 #include <string>
 
 #include <tdv/modules/ONNXRuntimeEnvironment.h>
 #include <tdv/utils/rassert/RAssert.h>
+#include <tdv/utils/profiler/Profiler.h>
 
 #ifdef _WIN32
 	#define WIDEN2(x) L ## x
@@ -17,8 +24,80 @@ namespace modules {
 
 using Context = tdv::data::Context;
 
+namespace
+{
+
+// environments with the onnxruntime profiling running, see endAllProfiling
+struct ProfilingRegistry
+{
+	std::mutex mutex;
+	std::set<ONNXRuntimeEnvironment*> environments;
+};
+
+ProfilingRegistry& profilingRegistry()
+{
+	static ProfilingRegistry registry;
+	return registry;
+}
+
+// numpy .npy format 1.0: magic, header length, python dict literal padded to 64 bytes, raw data
+void writeNpy(const std::string& path, const void* data, ONNXTensorElementDataType type, const std::vector<int64_t>& shape)
+{
+	const char* descr;
+	switch (type)
+	{
+	case ONNXTensorElementDataType::ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT: descr = "<f4"; break;
+	case ONNXTensorElementDataType::ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE: descr = "<f8"; break;
+	case ONNXTensorElementDataType::ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8: descr = "|i1"; break;
+	case ONNXTensorElementDataType::ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8: descr = "|u1"; break;
+	case ONNXTensorElementDataType::ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32: descr = "<i4"; break;
+	case ONNXTensorElementDataType::ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64: descr = "<i8"; break;
+	default: throw tdv::utils::rassert::tdv_error(0xc4b3069c, "unsupported calibration input type");
+	}
+
+	std::ostringstream header;
+	header << "{'descr': '" << descr << "', 'fortran_order': False, 'shape': (";
+	for (size_t i = 0; i < shape.size(); ++i)
+		header << shape[i] << (i + 1 < shape.size() ? ", " : shape.size() == 1 ? "," : "");
+	header << "), }";
+	std::string headerStr = header.str();
+	headerStr.append(63 - (10 + headerStr.size()) % 64, ' ');
+	headerStr += '\n';
+
+	std::ofstream file(path, std::ios::binary);
+	RHAssert2(0x64ebc0b5, file.is_open(), "can not open calibration file " + path);
+	const uint16_t headerSize = static_cast<uint16_t>(headerStr.size());
+	const char prefix[] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+		static_cast<char>(headerSize & 0xff), static_cast<char>(headerSize >> 8)};
+	file.write(prefix, sizeof(prefix));
+	file << headerStr;
+	const size_t elements = std::accumulate(shape.begin(), shape.end(), static_cast<size_t>(1), std::multiplies<size_t>());
+	file.write(static_cast<const char*>(data), elements * OrtTypeTraits::tSize(type));
+}
+
+}
 
-void ONNXRuntimeEnvironment::OrtCheckStatus(OrtStatus* status) {
+std::string ONNXRuntimeEnvironment::getModelPath(const std::string& modelPath, const std::string& precision, bool uint8Input)
+{
+	if (precision == "fp32" && !uint8Input)
+		return modelPath;
+
+	RHAssert2(0x2a9643a7, precision == "fp32" || precision == "int8", "unsupported precision " + precision + ", use fp32 or int8");
+	const size_t extension = modelPath.rfind(".onnx");
+	std::string result = extension == std::string::npos ? modelPath : modelPath.substr(0, extension);
+	if (precision == "int8")
+		result += "_int8";
+	if (uint8Input)
+		result += "_uint8";
+	result += ".onnx";
+
+	RHAssert2(0xc12480e8, std::ifstream(result).good(), "model variant " + result + " not found, build it with " +
+		(uint8Input ? "scripts/quantization/fold_normalization.py" : "scripts/quantization/quantize_models.py"));
+	return result;
+}
+
+
+void ONNXRuntimeEnvironment::OrtCheckStatus(OrtStatus* status) const {
 	if (status) {
 		const char* msg = ort_api->GetErrorMessage(status);
 		tdv::utils::rassert::tdv_error tdv_err(0xa9c6bf42, msg);
@@ -35,6 +114,7 @@ ONNXRuntimeEnvironment::ONNXRuntimeEnvironment(const Context& config) : ort_api
 	const int inter_op_num_threads = config.get<int64_t>("inter_op_num_threads", 1);
 	const void* model_buffer = config["model_buffer"].get<char*>();
 	const uint64_t model_buffer_size = config["model_buffer_size"].get<uint64_t>();
+	calibrationDir = config.get<std::string>("calibration_dir", "");
 
 	// Initialize environment, could use ORT_LOGGING_LEVEL_VERBOSE to get more information
 	// NOTE: Only one instance of env can exist at any point in time
@@ -107,6 +187,9 @@ ONNXRuntimeEnvironment::ONNXRuntimeEnvironment(const Context& config) : ort_api
 #endif
 
 	OrtCheckStatus(ort_api->GetAllocatorWithDefaultOptions(&allocator));
+	// onnxruntime profile timestamps are relative to the session creation
+	if (enable_trace)
+		profilingStartUs = tdv::utils::profiler::TraceRecorder::now();
 	OrtCheckStatus(ort_api->CreateSessionFromArray(OnnxRuntimeAdapter::GetInstance(config)->GetEnv(), model_buffer, model_buffer_size, session_options, &session));
 	// TODO: extent on case of multiple inputs and outpus
 	size_t numInputNodes, numOutputNodes;
@@ -160,6 +243,13 @@ ONNXRuntimeEnvironment::ONNXRuntimeEnvironment(const Context& config) : ort_api
 		ort_api->ReleaseTypeInfo(typeinfo);
 	}
 	OrtCheckStatus(ort_api->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info));
+
+	if (profilingStartUs >= 0)
+	{
+		ProfilingRegistry& registry = profilingRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.environments.insert(this);
+	}
 }
 
 bool ONNXRuntimeEnvironment::adjust_batch_size(size_t input, int64_t batch_size)
@@ -178,6 +268,24 @@ bool ONNXRuntimeEnvironment::adjust_batch_size(size_t input, int64_t batch_size)
 
 std::shared_ptr<uint8_t> ONNXRuntimeEnvironment::infer(std::vector<void*> input_data)
 {
+	std::vector<std::vector<int64_t>> output_shapes;
+	std::shared_ptr<uint8_t> output_buffer = infer(input_data, inputShapes, output_shapes);
+
+	outputSizes.clear();
+	for(const auto& output_dims : output_shapes)
+		outputSizes.push_back(std::accumulate(output_dims.begin(), output_dims.end(), 1, std::multiplies<size_t>()));
+	outputShapes = std::move(output_shapes);
+
+	return output_buffer;
+}
+
+std::shared_ptr<uint8_t> ONNXRuntimeEnvironment::infer(const std::vector<void*>& input_data,
+	const std::vector<std::vector<int64_t>>& input_shapes,
+	std::vector<std::vector<int64_t>>& output_shapes) const
+{
+	if (!calibrationDir.empty())
+		dumpInputs(input_data, input_shapes);
+
 	std::vector<OrtValue*> input_tensors;
 	std::vector<OrtValue*> output_tensors;
 	for(size_t i=0; i < outputNames.size(); ++i)
@@ -187,31 +295,37 @@ std::shared_ptr<uint8_t> ONNXRuntimeEnvironment::infer(std::vector<void*> input_
 	for(size_t i = 0; i< inputNames.size(); ++i)
 	{
 		OrtValue *input_tensor = nullptr;
-		uint64_t data_size = inputSizes[i]*OrtTypeTraits::tSize(inputTypes[i]);
+		const size_t input_size = std::accumulate(std::begin(input_shapes[i]), std::end(input_shapes[i]), 1, std::multiplies<size_t>());
+		uint64_t data_size = input_size*OrtTypeTraits::tSize(inputTypes[i]);
 		OrtCheckStatus(ort_api->CreateTensorWithDataAsOrtValue(memory_info,
 															   static_cast<uint8_t*>(input_data[i])+p_data_len,
 															   data_size,
-															   inputShapes[i].data(), inputShapes[i].size(),
+															   input_shapes[i].data(), input_shapes[i].size(),
 															   inputTypes[i], &input_tensor));
 		input_tensors.push_back(input_tensor);
 		p_data_len += data_size;
 	}
 
-	OrtCheckStatus(ort_api->Run(
-			session,										// session
-			run_options,									// run_options
-			inputNames.data(),								// input_names
-			(const OrtValue *const *)input_tensors.data(),	// input values
-			input_tensors.size(),							// input_len
-			outputNames.data(),								// output_names
-			outputNames.size(),								// output_names_len
-			output_tensors.data()));						// OrtValue** output
+	{
+		tdv::utils::profiler::StageTimer timer("ort_run");
+		OrtCheckStatus(ort_api->Run(
+				session,										// session
+				run_options,									// run_options
+				inputNames.data(),								// input_names
+				(const OrtValue *const *)input_tensors.data(),	// input values
+				input_tensors.size(),							// input_len
+				outputNames.data(),								// output_names
+				outputNames.size(),								// output_names_len
+				output_tensors.data()));						// OrtValue** output
+	}
 
 	for(auto input_tensor : input_tensors)
 		ort_api->ReleaseValue(input_tensor);
 
-	outputSizes.clear();
-	outputShapes.clear();
+	tdv::utils::profiler::StageTimer copyTimer("output_copy");
+
+	std::vector<size_t> output_sizes;
+	output_shapes.clear();
 
 	int isTensor;
 	OrtTensorTypeAndShapeInfo* tensor_info;
@@ -226,15 +340,15 @@ std::shared_ptr<uint8_t> ONNXRuntimeEnvironment::infer(std::vector<void*> input_
 			OrtCheckStatus(ort_api->GetDimensionsCount(tensor_info, &numOutputDims));
 			output_dims.resize(numOutputDims);
 			OrtCheckStatus(ort_api->GetDimensions(tensor_info, output_dims.data(), numOutputDims));
-			outputSizes.push_back(std::accumulate(output_dims.begin(), output_dims.end(), 1, std::multiplies<size_t>()));
-			outputShapes.push_back(output_dims);
+			output_sizes.push_back(std::accumulate(output_dims.begin(), output_dims.end(), 1, std::multiplies<size_t>()));
+			output_shapes.push_back(output_dims);
 			ort_api->ReleaseTensorTypeAndShapeInfo(tensor_info);
 		}
 	}
 
 	size_t buff_size{0};
-	for(size_t i = 0; i < outputSizes.size(); ++i)
-		buff_size += outputSizes[i]*OrtTypeTraits::tSize(outputTypes[i]);
+	for(size_t i = 0; i < output_sizes.size(); ++i)
+		buff_size += output_sizes[i]*OrtTypeTraits::tSize(outputTypes[i]);
 	uint8_t* buff = static_cast<uint8_t*>(malloc(buff_size));
 	if(!buff)
 		throw std::bad_alloc();
@@ -249,7 +363,7 @@ std::shared_ptr<uint8_t> ONNXRuntimeEnvironment::infer(std::vector<void*> input_
 		{
 			void* parr = nullptr;
 			OrtCheckStatus(ort_api->GetTensorMutableData(output_tensor, &parr));
-			uint64_t data_size = outputSizes[i]*OrtTypeTraits::tSize(outputTypes[i]);
+			uint64_t data_size = output_sizes[i]*OrtTypeTraits::tSize(outputTypes[i]);
 			memcpy((buff + p_data_len), parr, data_size);
 			p_data_len += data_size;
 			ort_api->ReleaseValue(output_tensor);
@@ -258,6 +372,22 @@ std::shared_ptr<uint8_t> ONNXRuntimeEnvironment::infer(std::vector<void*> input_
 	return output_buffer;
 }
 
+void ONNXRuntimeEnvironment::dumpInputs(const std::vector<void*>& input_data,
+	const std::vector<std::vector<int64_t>>& input_shapes) const
+{
+	const uint64_t call = calibrationCalls++;
+	// the same layout as in infer: input i starts after the data of the previous inputs
+	size_t p_data_len = 0;
+	for (size_t i = 0; i < input_data.size(); ++i)
+	{
+		std::ostringstream path;
+		path << calibrationDir << "/" << std::setw(8) << std::setfill('0') << call << "_" << i << ".npy";
+		writeNpy(path.str(), static_cast<const uint8_t*>(input_data[i]) + p_data_len, inputTypes[i], input_shapes[i]);
+
+		const size_t input_size = std::accumulate(std::begin(input_shapes[i]), std::end(input_shapes[i]), 1, std::multiplies<size_t>());
+		p_data_len += input_size * OrtTypeTraits::tSize(inputTypes[i]);
+	}
+}
 
 const std::vector<std::vector<int64_t>>& ONNXRuntimeEnvironment::getInputShapes() const
 {
@@ -274,13 +404,52 @@ const std::vector<std::vector<int64_t>>& ONNXRuntimeEnvironment::getOutputShapes
 	return outputShapes;
 }
 
+const std::vector<ONNXTensorElementDataType>& ONNXRuntimeEnvironment::getInputTypes() const
+{
+	return inputTypes;
+}
+
 const std::vector<ONNXTensorElementDataType>& ONNXRuntimeEnvironment::getOutputTypes() const
 {
 	return outputTypes;
 }
 
+void ONNXRuntimeEnvironment::endAllProfiling()
+{
+	ProfilingRegistry& registry = profilingRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (ONNXRuntimeEnvironment* environment : registry.environments)
+		environment->endProfiling();
+	registry.environments.clear();
+}
+
+void ONNXRuntimeEnvironment::endProfiling()
+{
+	// the profile is written on the end of profiling, its graph events are merged into the following trace dumps
+	if (profilingStartUs < 0)
+		return;
+
+	char* profileFile = nullptr;
+	OrtStatus* status = ort_api->SessionEndProfiling(session, allocator, &profileFile);
+	const int64_t startUs = profilingStartUs;
+	profilingStartUs = -1;
+	if (status)
+		ort_api->ReleaseStatus(status);
+	else if (profileFile)
+	{
+		tdv::utils::profiler::TraceRecorder::addExternalTrace(profileFile, startUs);
+		OrtCheckStatus(ort_api->AllocatorFree(allocator, profileFile));
+	}
+}
+
 ONNXRuntimeEnvironment::~ONNXRuntimeEnvironment()
 {
+	{
+		ProfilingRegistry& registry = profilingRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.environments.erase(this);
+	}
+	endProfiling();
 	for(auto inputName : inputNames)
 		OrtCheckStatus(ort_api->AllocatorFree(allocator, inputName));
 	for(auto outputName : outputNames)
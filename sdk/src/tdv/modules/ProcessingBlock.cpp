@@ -1,6 +1,8 @@
 #include <tdv/modules/ProcessingBlock.h>
 
+#include <tdv/data/ContextUtils.h>
 #include <tdv/data/JSONSerializer.h>
+#include <tdv/utils/profiler/Trace.h>
 #include <cstring>
 #include <string>
 
@@ -20,8 +22,11 @@ void TDVProcessingBlock_destroy(TDVProcessingBlock* block)
 
 char* TDVProcessingBlock_processSparse(TDVProcessingBlock* block, char* serializedContext)
 {
+	tdv::utils::profiler::TraceSpan traceSpan("TDVProcessingBlock_processSparse", "c_api");
 	Context ctx = _tdv_ProcessingBlock_deserializeConfig(serializedContext); 
 	(*block->ptr)(ctx);
+	// the crops are image buffers, they are not serialized, and the context is not reused by the next call
+	dropCropCache(ctx);
 	std::string resultString = JSONSerializer::serialize(ctx);
 	char* ans = new char[resultString.length() + 1];
 	strcpy(ans, resultString.c_str());
@@ -0,0 +1,323 @@
+#include <tdv/modules/TrackCacheModule.h>
+#include <tdv/utils/rassert/RAssert.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+namespace{
+
+double steadyNowMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// yaw and pitch proxies: nose offset from the eyes center in the eyes coordinate frame, relative to the eyes distance
+bool estimatePose(const tdv::data::Context& obj, float pose[2])
+{
+	if (!obj.contains("keypoints"))
+		return false;
+	const tdv::data::Context& keypoints = obj["keypoints"];
+	for (const char* name : {"left_eye", "right_eye", "nose"})
+		if (!keypoints.isObject() || !keypoints.contains(name) || !keypoints[name].contains("proj"))
+			return false;
+
+	auto point = [&keypoints](const char* name, double& x, double& y)
+	{
+		const tdv::data::Context& proj = keypoints[name]["proj"];
+		x = proj[0].get_as<double>();
+		y = proj[1].get_as<double>();
+	};
+	double lx, ly, rx, ry, nx, ny;
+	point("left_eye", lx, ly);
+	point("right_eye", rx, ry);
+	point("nose", nx, ny);
+
+	const double ex = rx - lx, ey = ry - ly;
+	const double distance2 = ex * ex + ey * ey;
+	if (distance2 <= 0)
+		return false;
+	const double dx = nx - (lx + rx) / 2, dy = ny - (ly + ry) / 2;
+	pose[0] = static_cast<float>((dx * ex + dy * ey) / distance2);
+	pose[1] = static_cast<float>((dy * ex - dx * ey) / distance2);
+	return true;
+}
+
+tdv::data::Context aggregate(const std::vector<const tdv::data::Context*>& values, const std::vector<double>& weights)
+{
+	const tdv::data::Context& first = *values.front();
+	double weightSum = 0;
+	for (double weight : weights)
+		weightSum += weight;
+
+	if (first.is<std::vector<float>>())
+	{
+		// templates are averaged keeping the average norm, so that unit templates stay unit
+		const size_t size = first.as<std::vector<float>>().size();
+		std::vector<float> result(size, 0.f);
+		double norm = 0;
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			const std::vector<float>& value = values[i]->as<std::vector<float>>();
+			if (value.size() != size)
+				return first;
+			double norm2 = 0;
+			for (size_t j = 0; j < size; ++j)
+			{
+				result[j] += static_cast<float>(weights[i] / weightSum) * value[j];
+				norm2 += value[j] * value[j];
+			}
+			norm += weights[i] / weightSum * std::sqrt(norm2);
+		}
+		double resultNorm2 = 0;
+		for (float value : result)
+			resultNorm2 += value * value;
+		if (resultNorm2 > 0)
+		{
+			const float m = static_cast<float>(norm / std::sqrt(resultNorm2));
+			for (float& value : result)
+				value *= m;
+		}
+		return result;
+	}
+
+	if (first.is<double>() || first.is<int64_t>())
+	{
+		double mean = 0;
+		for (size_t i = 0; i < values.size(); ++i)
+			mean += weights[i] / weightSum * values[i]->get_as<double>();
+		if (first.is<int64_t>())
+			return static_cast<int64_t>(std::round(mean));
+		return mean;
+	}
+
+	if (first.is<bool>() || first.is<std::string>())
+	{
+		// weighted vote, ties are resolved in favour of the latest sample
+		std::vector<double> votes(values.size(), 0);
+		for (size_t i = 0; i < values.size(); ++i)
+			for (size_t j = 0; j <= i; ++j)
+				if (*values[i] == *values[j])
+				{
+					votes[j] += weights[i];
+					break;
+				}
+		return *values[std::max_element(votes.begin(), votes.end()) - votes.begin()];
+	}
+
+	if (first.isObject())
+	{
+		tdv::data::Context result;
+		for (auto it = first.kvbegin(); it != first.kvend(); ++it)
+		{
+			std::vector<const tdv::data::Context*> fieldValues;
+			std::vector<double> fieldWeights;
+			for (size_t i = 0; i < values.size(); ++i)
+			{
+				if (values[i]->isObject() && values[i]->contains(it->first))
+				{
+					fieldValues.push_back(&(*values[i])[it->first]);
+					fieldWeights.push_back(weights[i]);
+				}
+			}
+			result[it->first] = aggregate(fieldValues, fieldWeights);
+		}
+		return result;
+	}
+
+	return first;
+}
+
+}
+
+
+namespace tdv {
+
+namespace modules {
+
+TrackCacheModule::TrackCacheModule(const tdv::data::Context& config, std::vector<std::unique_ptr<ProcessingBlock>> blocks):
+	blocks(std::move(blocks)),
+	refreshIntervalMs(config.get_as<double>("refresh_interval_ms", 2000.)),
+	qualityKey(config.get<std::string>("quality_key", "confidence")),
+	qualityGain(config.get_as<double>("quality_gain", 0.1)),
+	poseThreshold(config.get_as<double>("pose_threshold", 0.15)),
+	maxSamples(config.get_as<int64_t>("max_samples", 5)),
+	maxTrackAgeMs(config.get_as<double>("max_track_age_ms", 10000.)),
+	profiler(config, "TRACK_CACHE")
+{
+	RHAssert2(0x5701fe08, !this->blocks.empty(), "need blocks");
+	RHAssert2(0xe333248f, maxSamples > 0, "max_samples must be positive");
+}
+
+double TrackCacheModule::quality(const tdv::data::Context& obj) const
+{
+	// a zero quality sample must not cancel the aggregation
+	const double value = obj.contains(qualityKey) ? obj[qualityKey].get_as<double>() : 1.;
+	return std::max(value, 1e-6);
+}
+
+bool TrackCacheModule::needsRefresh(const Entry& entry, const tdv::data::Context& obj, double now) const
+{
+	if (entry.samples.empty())
+		return true;
+	if (refreshIntervalMs > 0 && now - entry.lastRefresh >= refreshIntervalMs)
+		return true;
+	if (quality(obj) > entry.bestQuality * (1 + qualityGain))
+		return true;
+
+	float pose[2];
+	if (poseThreshold > 0 && entry.hasPose && estimatePose(obj, pose))
+		return std::max(std::abs(pose[0] - entry.pose[0]), std::abs(pose[1] - entry.pose[1])) > poseThreshold;
+	return false;
+}
+
+void TrackCacheModule::addSample(Entry& entry, tdv::data::Context&& outputs, const tdv::data::Context& obj, double now) const
+{
+	// the fresh sample is always taken and the oldest one is dropped, so time varying outputs (emotion, liveness)
+	// follow the track; the samples are kept newest first
+	entry.samples.insert(entry.samples.begin(), Sample{std::move(outputs), quality(obj)});
+	if (entry.samples.size() > maxSamples)
+		entry.samples.pop_back();
+
+	entry.bestQuality = std::max_element(entry.samples.begin(), entry.samples.end(),
+		[](const Sample& a, const Sample& b){ return a.quality < b.quality; })->quality;
+	entry.lastRefresh = now;
+	entry.hasPose = estimatePose(obj, entry.pose);
+
+	std::vector<const tdv::data::Context*> values;
+	std::vector<double> weights;
+	for (const Sample& item : entry.samples)
+	{
+		values.push_back(&item.outputs);
+		weights.push_back(item.quality);
+	}
+	entry.aggregated = aggregate(values, weights);
+}
+
+void TrackCacheModule::operator ()(tdv::data::Context& data)
+{
+	using tdv::utils::profiler::StageTimer;
+
+	RHAssert2(0x8597a13e, data.contains("objects"), "need objects");
+
+	tdv::utils::profiler::Profile profile;
+	{
+		tdv::utils::profiler::ProfileScope profileScope(profiler.isEnabled() ? &profile : tdv::utils::profiler::Profile::current());
+		tdv::utils::profiler::BlockScope blockScope(profiler, data);
+
+		const double now = data.contains("timestamp_ms") ? data["timestamp_ms"].get_as<double>() : steadyNowMs();
+		const std::string stream = data.get<std::string>("stream_id", "default");
+		tdv::data::Context& objects = data["objects"];
+
+		// objects to process: untracked ones and the tracks to refresh
+		std::vector<size_t> indices;
+		{
+			StageTimer timer("lookup");
+			std::lock_guard<std::mutex> lock(mutex);
+			Cache& cache = caches[stream];
+			for (auto it = cache.begin(); it != cache.end();)
+				it = now - it->second.lastSeen > maxTrackAgeMs ? cache.erase(it) : std::next(it);
+
+			for (size_t i = 0; i < objects.size(); ++i)
+			{
+				if (!objects[i].contains("track_id"))
+				{
+					indices.push_back(i);
+					continue;
+				}
+				Entry& entry = cache[objects[i]["track_id"].get<int64_t>()];
+				entry.lastSeen = now;
+				if (needsRefresh(entry, objects[i], now))
+					indices.push_back(i);
+			}
+		}
+
+		// blocks work on a context of the processed objects, the rest of the data is moved there and back,
+		// so the top level outputs of the blocks (e.g. "@profile") reach the caller
+		tdv::data::Context processed;
+		if (!indices.empty())
+		{
+			StageTimer timer("process");
+			std::vector<std::string> keys;
+			for (auto it = data.kvbegin(); it != data.kvend(); ++it)
+				if (it->first != "objects")
+					keys.push_back(it->first);
+			for (const std::string& key : keys)
+				processed[key] = std::move(data[key]);
+			tdv::data::Context& processedObjects = processed["objects"];
+			for (size_t i : indices)
+				processedObjects.push_back(objects[i]);
+
+			auto moveBack = [&data, &processed, &keys]()
+			{
+				for (const std::string& key : keys)
+					if (!processed.contains(key))
+						data.erase(key);
+				for (auto it = processed.kvbegin(); it != processed.kvend(); ++it)
+					if (it->first != "objects")
+						data[it->first] = std::move(it->second);
+			};
+			try
+			{
+				for (auto& block : blocks)
+					(*block)(processed);
+			}
+			catch (...)
+			{
+				moveBack();
+				throw;
+			}
+			moveBack();
+
+			RHAssert2(0x337fa6d0, processed.contains("objects") && processed["objects"].size() == indices.size(),
+				"cached blocks must not add or remove objects");
+		}
+
+		StageTimer timer("aggregate");
+		std::lock_guard<std::mutex> lock(mutex);
+		Cache& cache = caches[stream];
+
+		std::vector<bool> isProcessed(objects.size(), false);
+		for (size_t k = 0; k < indices.size(); ++k)
+		{
+			tdv::data::Context& obj = objects[indices[k]];
+			tdv::data::Context& result = processed["objects"][k];
+			isProcessed[indices[k]] = true;
+
+			// block outputs are the values added or changed, "@" keys are internal
+			tdv::data::Context outputs;
+			for (auto it = result.kvbegin(); it != result.kvend(); ++it)
+				if (it->first.front() != '@' && (!obj.contains(it->first) || !(obj[it->first] == it->second)))
+					outputs[it->first] = std::move(it->second);
+
+			if (!obj.contains("track_id"))
+			{
+				for (auto it = outputs.kvbegin(); it != outputs.kvend(); ++it)
+					obj[it->first] = std::move(it->second);
+				continue;
+			}
+
+			Entry& entry = cache[obj["track_id"].get<int64_t>()];
+			entry.lastSeen = now;
+			addSample(entry, std::move(outputs), obj, now);
+		}
+
+		for (size_t i = 0; i < objects.size(); ++i)
+		{
+			tdv::data::Context& obj = objects[i];
+			if (!obj.contains("track_id"))
+				continue;
+			auto entry = cache.find(obj["track_id"].get<int64_t>());
+			if (entry == cache.end() || !entry->second.aggregated.isObject())
+				continue;
+			for (auto it = entry->second.aggregated.kvbegin(); it != entry->second.aggregated.kvend(); ++it)
+				obj[it->first] = it->second;
+			obj["cached"] = !isProcessed[i];
+		}
+	}
+	profiler.write(profile, data);
+}
+
+}
+}
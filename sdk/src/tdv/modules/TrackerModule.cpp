@@ -0,0 +1,161 @@
+#include <tdv/modules/TrackerModule.h>
+#include <tdv/utils/rassert/RAssert.h>
+
+#include <algorithm>
+#include <vector>
+
+
+namespace tdv {
+
+namespace modules {
+
+using tdv::utils::tracker_utils::Detection;
+using tdv::utils::tracker_utils::Track;
+
+TrackerModule::TrackerModule(const tdv::data::Context& config, std::unique_ptr<ProcessingBlock> detector):
+	detector(std::move(detector)),
+	detectionInterval(config.get_as<int64_t>("detection_interval", 1)),
+	redetectConfidence(config.get_as<double>("redetect_confidence", 0.3)),
+	profiler(config, "TRACKER")
+{
+	parameters.highThreshold = config.get_as<double>("high_threshold", parameters.highThreshold);
+	parameters.lowThreshold = config.get_as<double>("low_threshold", parameters.lowThreshold);
+	parameters.matchThreshold = config.get_as<double>("iou_threshold", parameters.matchThreshold);
+	parameters.embeddingWeight = config.get_as<double>("embedding_weight", parameters.embeddingWeight);
+	parameters.maxLostFrames = config.get_as<int64_t>("max_lost_frames", parameters.maxLostFrames);
+	parameters.confidenceDecay = config.get_as<double>("confidence_decay", parameters.confidenceDecay);
+
+	RHAssert2(0xa0d67f7b, detectionInterval > 0, "detection_interval must be positive");
+	RHAssert2(0xf0b2b71d, parameters.lowThreshold <= parameters.highThreshold, "low_threshold must not exceed high_threshold");
+	RHAssert2(0x7d4d8fc5, parameters.embeddingWeight >= 0 && parameters.embeddingWeight <= 1, "embedding_weight must be in [0, 1]");
+}
+
+TrackerModule::Stream& TrackerModule::getStream(const std::string& id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<Stream>& stream = streams[id];
+	if (!stream)
+		stream.reset(new Stream(parameters));
+	return *stream;
+}
+
+void TrackerModule::operator ()(tdv::data::Context& data)
+{
+	tdv::utils::profiler::Profile profile;
+	{
+		tdv::utils::profiler::ProfileScope profileScope(profiler.isEnabled() ? &profile : tdv::utils::profiler::Profile::current());
+		tdv::utils::profiler::BlockScope blockScope(profiler, data);
+
+		Stream& stream = getStream(data.get<std::string>("stream_id", "default"));
+		std::lock_guard<std::mutex> lock(stream.mutex);
+
+		{
+			tdv::utils::profiler::StageTimer timer("predict");
+			stream.tracker.predict();
+		}
+
+		// without an own detector the frame is a detection one if the objects are given
+		const bool detect = detector ? stream.detectionRequired : data.contains("objects");
+		if (detect)
+		{
+			if (detector)
+			{
+				tdv::utils::profiler::StageTimer timer("detect");
+				(*detector)(data);
+			}
+			tdv::utils::profiler::StageTimer timer("associate");
+			associate(stream, data);
+			stream.framesSinceDetection = 0;
+		}
+		else
+		{
+			predict(stream, data);
+			++stream.framesSinceDetection;
+		}
+
+		stream.detectionRequired = isDetectionRequired(stream);
+		data["detection_required"] = stream.detectionRequired;
+	}
+	profiler.write(profile, data);
+}
+
+void TrackerModule::associate(Stream& stream, tdv::data::Context& data) const
+{
+	if (!data.contains("objects"))
+		return;
+	tdv::data::Context& objects = data["objects"];
+
+	std::vector<Detection> detections;
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < objects.size(); ++i)
+	{
+		const tdv::data::Context& obj = objects[i];
+		if (!obj.contains("bbox"))
+			continue;
+		const tdv::data::Context& bbox = obj["bbox"];
+		RHAssert2(0xc2c99db2, bbox.size() == 4, "bbox must contain 4 coordinates");
+
+		Detection detection;
+		detection.x1 = bbox[0].get_as<double>();
+		detection.y1 = bbox[1].get_as<double>();
+		detection.x2 = bbox[2].get_as<double>();
+		detection.y2 = bbox[3].get_as<double>();
+		detection.score = obj.contains("confidence") ? obj["confidence"].get_as<double>() : 1.f;
+		detection.label = obj.get<std::string>("class", "");
+		if (parameters.embeddingWeight > 0 && obj.contains("template"))
+			detection.embedding = &obj["template"].as<std::vector<float>>();
+		detections.push_back(detection);
+		indices.push_back(i);
+	}
+
+	const std::vector<int64_t> trackIds = stream.tracker.update(detections);
+	for (size_t i = 0; i < indices.size(); ++i)
+		if (trackIds[i] >= 0)
+			objects[indices[i]]["track_id"] = trackIds[i];
+}
+
+void TrackerModule::predict(const Stream& stream, tdv::data::Context& data) const
+{
+	tdv::data::Context objects;
+	int64_t id = 0;
+	for (const Track& track : stream.tracker.getTracks())
+	{
+		if (!track.active)
+			continue;
+
+		float x1, y1, x2, y2;
+		track.box(x1, y1, x2, y2);
+		tdv::data::Context obj;
+		obj["id"] = id++;
+		if (!track.label.empty())
+			obj["class"] = track.label;
+		obj["confidence"] = static_cast<double>(track.confidence);
+		for (float coord : {x1, y1, x2, y2})
+			obj["bbox"].push_back(static_cast<double>(std::min(std::max(coord, 0.f), 1.f)));
+		obj["track_id"] = track.id;
+		obj["predicted"] = true;
+		objects.push_back(std::move(obj));
+	}
+	data["objects"] = std::move(objects);
+}
+
+bool TrackerModule::isDetectionRequired(const Stream& stream) const
+{
+	if (stream.framesSinceDetection + 1 >= detectionInterval)
+		return true;
+
+	bool hasActive = false;
+	for (const Track& track : stream.tracker.getTracks())
+	{
+		if (!track.active)
+			continue;
+		hasActive = true;
+		// the confidence is decayed once more on the next frame
+		if (track.confidence * parameters.confidenceDecay < redetectConfidence)
+			return true;
+	}
+	return !hasActive;
+}
+
+}
+}
@@ -0,0 +1,124 @@
+#include <tdv/utils/alignment/Alignment.h>
+#include <tdv/utils/rassert/RAssert.h>
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace alignment
+{
+
+namespace
+{
+
+inline cv::Point2f transform(const cv::Matx23f& m, const cv::Point2f& p)
+{
+	return cv::Point2f(
+		m(0, 0) * p.x + m(0, 1) * p.y + m(0, 2),
+		m(1, 0) * p.x + m(1, 1) * p.y + m(1, 2));
+}
+
+inline float distance(const cv::Point2f& a, const cv::Point2f& b)
+{
+	return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+
+}
+
+AlignmentMethod alignmentMethodFromString(const std::string& method)
+{
+	if (method == "closed_form")
+		return AlignmentMethod::CLOSED_FORM;
+	if (method == "robust")
+		return AlignmentMethod::ROBUST;
+	throw tdv::utils::rassert::tdv_error(0xa79cced2, "unknown alignment method: " + method);
+}
+
+cv::Matx23f estimateSimilarity(const std::vector<cv::Point2f>& src, const std::vector<cv::Point2f>& dst,
+	const std::vector<float>* weights)
+{
+	RHAssert2(0x1588fd3c, src.size() == dst.size(), "point sets differ in size");
+	RHAssert2(0x5bd8a652, src.size() >= 2, "need at least 2 points");
+	RHAssert2(0x210dcf8c, !weights || weights->size() == src.size(), "weights differ in size");
+
+	// with centered points the rotation and scale do not depend on the shift
+	double sw = 0, mx = 0, my = 0, mu = 0, mv = 0;
+	for (size_t i = 0; i < src.size(); ++i)
+	{
+		const double w = weights ? (*weights)[i] : 1.;
+		sw += w;
+		mx += w * src[i].x;
+		my += w * src[i].y;
+		mu += w * dst[i].x;
+		mv += w * dst[i].y;
+	}
+	mx /= sw;
+	my /= sw;
+	mu /= sw;
+	mv /= sw;
+
+	double norm = 0, sa = 0, sb = 0;
+	for (size_t i = 0; i < src.size(); ++i)
+	{
+		const double w = weights ? (*weights)[i] : 1.;
+		const double x = src[i].x - mx, y = src[i].y - my;
+		const double u = dst[i].x - mu, v = dst[i].y - mv;
+		norm += w * (x * x + y * y);
+		sa += w * (x * u + y * v);
+		sb += w * (y * u - x * v);
+	}
+	RHAssert2(0x34be23cb, norm > 0, "source points coincide");
+
+	const double a = sa / norm;
+	const double b = sb / norm;
+	return cv::Matx23f(
+		a, b, mu - a * mx - b * my,
+		-b, a, mv + b * mx - a * my);
+}
+
+cv::Matx23f estimateSimilarityRobust(const std::vector<cv::Point2f>& src, const std::vector<cv::Point2f>& dst,
+	const RobustParameters& parameters)
+{
+	cv::Matx23f result = estimateSimilarity(src, dst);
+
+	std::vector<float> weights(src.size());
+	std::vector<float> residuals(src.size());
+	for (int iteration = 0; iteration < parameters.maxIterations; ++iteration)
+	{
+		for (size_t i = 0; i < src.size(); ++i)
+			residuals[i] = distance(transform(result, src[i]), dst[i]);
+
+		weights = residuals;
+		std::nth_element(weights.begin(), weights.begin() + weights.size() / 2, weights.end());
+		const float median = weights[weights.size() / 2];
+
+		for (size_t i = 0; i < src.size(); ++i)
+			weights[i] = 1.f / (median + residuals[i] + 1e-6f);
+
+		const cv::Matx23f previous = result;
+		result = estimateSimilarity(src, dst, &weights);
+
+		float shift = 0;
+		for (const cv::Point2f& point : src)
+			shift = std::max(shift, distance(transform(result, point), transform(previous, point)));
+		if (shift < parameters.tolerance)
+			break;
+	}
+
+	return result;
+}
+
+cv::Matx23f estimateSimilarity(const std::vector<cv::Point2f>& src, const std::vector<cv::Point2f>& dst, AlignmentMethod method)
+{
+	if (method == AlignmentMethod::ROBUST)
+		return estimateSimilarityRobust(src, dst);
+	return estimateSimilarity(src, dst);
+}
+
+} // alignment
+} // namespace utils
+} // namespace tdv
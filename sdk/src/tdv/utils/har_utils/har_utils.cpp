@@ -64,6 +64,22 @@ tdv::data::Context pose_vector2normalizedCtx(std::vector<std::vector<float>> &ke
 	return poses;
 }
 
+tdv::data::Context pose_vector2normalizedCtx(const float *keypoints, size_t joints,
+							   std::map<int, std::string> &label_map,
+							   std::vector<int>& dims)
+{
+	tdv::data::Context poses;
+	for (size_t i = 0; i < joints; i++, keypoints += 3)
+	{
+		tdv::data::Context point;
+		point["proj"].push_back(static_cast<double>(keypoints[0]/dims[1]));
+		point["proj"].push_back(static_cast<double>(keypoints[1]/dims[0]));
+		point["confidence"] = static_cast<double>(keypoints[2]);
+		poses[label_map[i]] = std::move(point);
+	}
+	return poses;
+}
+
 void bboxScaler (std::vector<double> &bbox,
 				  const std::vector<int> &dims,
 				  double padding ){
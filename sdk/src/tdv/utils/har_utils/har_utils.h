@@ -9,6 +9,10 @@ std::map<int, std::string> read_label_map(std::string label_path);
 tdv::data::Context pose_vector2normalizedCtx(std::vector<std::vector<float>> &keypoints, std::map<int,
 		std::string> &label_map, std::vector<int> &dims);
 
+// keypoints - (x, y, score) triplets of the joints
+tdv::data::Context pose_vector2normalizedCtx(const float *keypoints, size_t joints, std::map<int,
+		std::string> &label_map, std::vector<int> &dims);
+
 void bboxScaler(std::vector<double> &bbox, const std::vector<int> &dims, double padding);
 
 std::vector<double> resizeWithPad(cv::Mat &image, int width, int height);
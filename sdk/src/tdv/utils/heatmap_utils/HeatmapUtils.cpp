@@ -0,0 +1,150 @@
+#include <tdv/utils/heatmap_utils/HeatmapUtils.h>
+#include <tdv/utils/rassert/RAssert.h>
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#endif
+
+namespace tdv
+{
+namespace utils
+{
+namespace heatmap_utils
+{
+
+namespace
+{
+
+// index of the first maximum, as cv::minMaxLoc
+size_t argmax(const float* data, size_t size)
+{
+	float maxValue = data[0];
+	size_t i = 0;
+#ifdef __SSE2__
+	if (size >= 4)
+	{
+		__m128 maxVector = _mm_loadu_ps(data);
+		for (i = 4; i + 4 <= size; i += 4)
+			maxVector = _mm_max_ps(maxVector, _mm_loadu_ps(data + i));
+		float buffer[4];
+		_mm_storeu_ps(buffer, maxVector);
+		maxValue = std::max(std::max(buffer[0], buffer[1]), std::max(buffer[2], buffer[3]));
+	}
+#endif
+	for (; i < size; ++i)
+		maxValue = std::max(maxValue, data[i]);
+
+	size_t index = 0;
+#ifdef __SSE2__
+	const __m128 maxVector = _mm_set1_ps(maxValue);
+	for (; index + 4 <= size; index += 4)
+	{
+		const int mask = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(data + index), maxVector));
+		if (mask)
+		{
+			while (!(mask & 1 << (index & 3)))
+				++index;
+			return index;
+		}
+	}
+#endif
+	while (index < size && data[index] != maxValue)
+		++index;
+	return index < size ? index : 0;
+}
+
+void refineQuadratic(const float* heatmap, size_t height, size_t width, int x, int y, float& dx, float& dy)
+{
+	const float center = heatmap[y * width + x];
+	if (x > 0 && x + 1 < static_cast<int>(width))
+	{
+		const float left = heatmap[y * width + x - 1], right = heatmap[y * width + x + 1];
+		const float curvature = left - 2 * center + right;
+		if (curvature < 0)
+			dx = 0.5f * (left - right) / curvature;
+	}
+	if (y > 0 && y + 1 < static_cast<int>(height))
+	{
+		const float top = heatmap[(y - 1) * width + x], bottom = heatmap[(y + 1) * width + x];
+		const float curvature = top - 2 * center + bottom;
+		if (curvature < 0)
+			dy = 0.5f * (top - bottom) / curvature;
+	}
+}
+
+void refineDark(const float* heatmap, size_t height, size_t width, int x, int y, float& dx, float& dy)
+{
+	if (x < 2 || y < 2 || x + 2 >= static_cast<int>(width) || y + 2 >= static_cast<int>(height))
+		return;
+
+	auto value = [heatmap, width, x, y](int ox, int oy)
+	{
+		return std::log(std::max(heatmap[(y + oy) * width + x + ox], 1e-10f));
+	};
+
+	const float center = value(0, 0);
+	const float gx = 0.5f * (value(1, 0) - value(-1, 0));
+	const float gy = 0.5f * (value(0, 1) - value(0, -1));
+	const float hxx = 0.25f * (value(2, 0) - 2 * center + value(-2, 0));
+	const float hyy = 0.25f * (value(0, 2) - 2 * center + value(0, -2));
+	const float hxy = 0.25f * (value(1, 1) - value(1, -1) - value(-1, 1) + value(-1, -1));
+
+	// offset = -H^-1 * g
+	const float det = hxx * hyy - hxy * hxy;
+	if (std::abs(det) < 1e-12f)
+		return;
+	const float ox = -(hyy * gx - hxy * gy) / det;
+	const float oy = -(hxx * gy - hxy * gx) / det;
+	// the expansion is only trusted within the pixel of the maximum
+	if (std::abs(ox) <= 1 && std::abs(oy) <= 1)
+	{
+		dx = ox;
+		dy = oy;
+	}
+}
+
+}
+
+HeatmapRefinement heatmapRefinementFromString(const std::string& refinement)
+{
+	if (refinement == "none")
+		return HeatmapRefinement::NONE;
+	if (refinement == "quadratic")
+		return HeatmapRefinement::QUADRATIC;
+	if (refinement == "dark")
+		return HeatmapRefinement::DARK;
+	throw tdv::utils::rassert::tdv_error(0xd6f39d9f, "unknown heatmap refinement: " + refinement);
+}
+
+void decodeHeatmaps(const float* heatmaps, size_t count, size_t height, size_t width,
+	const HeatmapParameters& parameters, float* keypoints)
+{
+	RHAssert2(0x1d6793ad, height > 0 && width > 0, "empty heatmaps");
+
+	const HeatmapRefinement refinement = parameters.refinement;
+	const size_t size = height * width;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float* heatmap = heatmaps + i * size;
+		const size_t index = argmax(heatmap, size);
+		const int x = static_cast<int>(index % width);
+		const int y = static_cast<int>(index / width);
+
+		float dx = 0, dy = 0;
+		if (refinement == HeatmapRefinement::QUADRATIC)
+			refineQuadratic(heatmap, height, width, x, y, dx, dy);
+		else if (refinement == HeatmapRefinement::DARK)
+			refineDark(heatmap, height, width, x, y, dx, dy);
+
+		keypoints[3 * i] = x + dx;
+		keypoints[3 * i + 1] = y + dy;
+		keypoints[3 * i + 2] = heatmap[index];
+	}
+}
+
+} // heatmap_utils
+} // namespace utils
+} // namespace tdv
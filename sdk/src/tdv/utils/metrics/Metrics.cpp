@@ -0,0 +1,255 @@
+#include <tdv/utils/metrics/Metrics.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace metrics
+{
+
+namespace
+{
+
+thread_local BlockMetrics* currentBlock = nullptr;
+
+std::string& lastFailed()
+{
+	thread_local std::string name;
+	return name;
+}
+
+// Prometheus bucket bounds of the latencies in microseconds and of the batch sizes
+const uint64_t LATENCY_BOUNDS_US[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+	1000000, 2500000, 5000000, 10000000};
+const uint64_t BATCH_BOUNDS[] = {1, 2, 4, 8, 16, 32, 64, 128};
+
+std::string escapeLabel(const std::string& value)
+{
+	std::string result;
+	for (char c : value)
+	{
+		if (c == '\\' || c == '"')
+			result += '\\';
+		if (c == '\n')
+		{
+			result += "\\n";
+			continue;
+		}
+		result += c;
+	}
+	return result;
+}
+
+template<size_t N>
+void writeHistogram(std::ostringstream& out, const std::string& metric, const std::string& labels,
+	const Histogram& histogram, const uint64_t (&bounds)[N], double scale)
+{
+	for (uint64_t bound : bounds)
+		out << metric << "_bucket{" << labels << ",le=\"" << bound * scale << "\"} " << histogram.countBelow(bound) << "\n";
+	out << metric << "_bucket{" << labels << ",le=\"+Inf\"} " << histogram.getCount() << "\n";
+	out << metric << "_sum{" << labels << "} " << histogram.getSum() * scale << "\n";
+	out << metric << "_count{" << labels << "} " << histogram.getCount() << "\n";
+}
+
+}
+
+tdv::data::Context Histogram::toContext(double scale) const
+{
+	tdv::data::Context result;
+	const uint64_t total = getCount();
+	result["count"] = static_cast<int64_t>(total);
+	result["mean"] = total ? getSum() * scale / total : 0.;
+	result["max"] = getMax() * scale;
+	const std::pair<const char*, double> quantiles[] = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}};
+	for (const auto& q : quantiles)
+		result[q.first] = quantile(q.second) * scale;
+	return result;
+}
+
+void BlockMetrics::recordStage(const char* stage, uint64_t us)
+{
+	// literals of the same name may differ in address between translation units
+	for (Stage& slot : stages)
+	{
+		const char* slotName = slot.name.load(std::memory_order_acquire);
+		if (!slotName)
+		{
+			if (slot.name.compare_exchange_strong(slotName, stage, std::memory_order_acq_rel))
+			{
+				slot.latency.record(us);
+				return;
+			}
+			// taken by another thread meanwhile, slotName is its name now
+		}
+		if (slotName == stage || !std::strcmp(slotName, stage))
+		{
+			slot.latency.record(us);
+			return;
+		}
+	}
+}
+
+tdv::data::Context BlockMetrics::toContext() const
+{
+	tdv::data::Context result;
+	result["calls"] = static_cast<int64_t>(calls.get());
+	result["errors"] = static_cast<int64_t>(errors.get());
+	result["frames"] = static_cast<int64_t>(frames.get());
+	result["objects"] = static_cast<int64_t>(objects.get());
+	result["inferences"] = static_cast<int64_t>(inferences.get());
+	result["latency_ms"] = latency.toContext(1e-3);
+	result["batch_size"] = batchSize.toContext();
+	if (queueDepth.getCount())
+		result["queue_depth"] = queueDepth.toContext();
+
+	tdv::data::Context& stagesCtx = result["stages"];
+	forEachStage([&stagesCtx](const char* stage, const Histogram& histogram)
+	{
+		stagesCtx[stage] = histogram.toContext(1e-3);
+	});
+	if (stagesCtx.isNone())
+		result.erase("stages");
+	return result;
+}
+
+BlockMetrics* BlockMetrics::current()
+{
+	return currentBlock;
+}
+
+void BlockMetrics::setCurrent(BlockMetrics* metrics)
+{
+	currentBlock = metrics;
+}
+
+void BlockMetrics::recordInference(int64_t batchSize)
+{
+	if (BlockMetrics* metrics = currentBlock)
+	{
+		metrics->inferences.add();
+		metrics->batchSize.record(static_cast<uint64_t>(std::max<int64_t>(batchSize, 0)));
+	}
+}
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+	// never destroyed, blocks may be released during the static destruction
+	static MetricsRegistry* registry = new MetricsRegistry();
+	return *registry;
+}
+
+BlockMetrics& MetricsRegistry::block(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<BlockMetrics>& metrics = blocks[name];
+	if (!metrics)
+		metrics.reset(new BlockMetrics(name));
+	return *metrics;
+}
+
+void MetricsRegistry::recordError(const std::string& block, unsigned int code)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	++errors[std::make_pair(block, code)];
+}
+
+tdv::data::Context MetricsRegistry::toContext() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	tdv::data::Context result;
+	tdv::data::Context& blocksCtx = result["blocks"];
+	for (const auto& item : blocks)
+		blocksCtx[item.first] = item.second->toContext();
+
+	tdv::data::Context& errorsCtx = result["errors"];
+	for (const auto& item : errors)
+	{
+		std::ostringstream code;
+		code << "0x" << std::hex << std::setw(8) << std::setfill('0') << item.first.second;
+
+		tdv::data::Context error;
+		error["unit_type"] = item.first.first;
+		error["code"] = code.str();
+		error["count"] = static_cast<int64_t>(item.second);
+		errorsCtx.push_back(std::move(error));
+	}
+	return result;
+}
+
+std::string MetricsRegistry::toPrometheus() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::ostringstream out;
+
+	const std::pair<const char*, Counter BlockMetrics::*> counters[] = {
+		{"face_sdk_block_calls_total", &BlockMetrics::calls},
+		{"face_sdk_block_failed_calls_total", &BlockMetrics::errors},
+		{"face_sdk_block_frames_total", &BlockMetrics::frames},
+		{"face_sdk_block_objects_total", &BlockMetrics::objects},
+		{"face_sdk_block_inferences_total", &BlockMetrics::inferences}};
+	for (const auto& counter : counters)
+	{
+		out << "# TYPE " << counter.first << " counter\n";
+		for (const auto& item : blocks)
+			out << counter.first << "{unit_type=\"" << escapeLabel(item.first) << "\"} " << ((*item.second).*counter.second).get() << "\n";
+	}
+
+	out << "# TYPE face_sdk_errors_total counter\n";
+	for (const auto& item : errors)
+	{
+		std::ostringstream code;
+		code << "0x" << std::hex << std::setw(8) << std::setfill('0') << item.first.second;
+		out << "face_sdk_errors_total{unit_type=\"" << escapeLabel(item.first.first) << "\",code=\"" << code.str() << "\"} "
+			<< item.second << "\n";
+	}
+
+	out << "# TYPE face_sdk_block_latency_seconds histogram\n";
+	for (const auto& item : blocks)
+		writeHistogram(out, "face_sdk_block_latency_seconds", "unit_type=\"" + escapeLabel(item.first) + "\"",
+			item.second->latency, LATENCY_BOUNDS_US, 1e-6);
+
+	out << "# TYPE face_sdk_stage_latency_seconds histogram\n";
+	for (const auto& item : blocks)
+	{
+		item.second->forEachStage([&out, &item](const char* stage, const Histogram& histogram)
+		{
+			writeHistogram(out, "face_sdk_stage_latency_seconds",
+				"unit_type=\"" + escapeLabel(item.first) + "\",stage=\"" + escapeLabel(stage) + "\"",
+				histogram, LATENCY_BOUNDS_US, 1e-6);
+		});
+	}
+
+	out << "# TYPE face_sdk_inference_batch_size histogram\n";
+	for (const auto& item : blocks)
+		writeHistogram(out, "face_sdk_inference_batch_size", "unit_type=\"" + escapeLabel(item.first) + "\"",
+			item.second->batchSize, BATCH_BOUNDS, 1);
+
+	out << "# TYPE face_sdk_batching_queue_depth histogram\n";
+	for (const auto& item : blocks)
+		if (item.second->queueDepth.getCount())
+			writeHistogram(out, "face_sdk_batching_queue_depth", "unit_type=\"" + escapeLabel(item.first) + "\"",
+				item.second->queueDepth, BATCH_BOUNDS, 1);
+
+	return out.str();
+}
+
+const std::string& lastFailedBlock()
+{
+	return lastFailed();
+}
+
+void setLastFailedBlock(const std::string& name)
+{
+	lastFailed() = name;
+}
+
+} // metrics
+} // namespace utils
+} // namespace tdv
@@ -0,0 +1,300 @@
+#include <tdv/utils/nms_utils/NMSUtils.h>
+#include <tdv/utils/rassert/RAssert.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+namespace tdv
+{
+namespace utils
+{
+namespace nms_utils
+{
+
+namespace
+{
+
+inline float boxArea(float x1, float y1, float x2, float y2)
+{
+	const float w = x2 - x1;
+	const float h = y2 - y1;
+	return (w > 0 && h > 0) ? w * h : 0;
+}
+
+// Candidates with precomputed areas, kept in the same layout as Boxes
+struct Candidates
+{
+	std::vector<float> x1, y1, x2, y2, area, scores;
+	std::vector<int> classes, indices;
+
+	void reserve(size_t count)
+	{
+		for (auto v : {&x1, &y1, &x2, &y2, &area, &scores})
+			v->reserve(count);
+		classes.reserve(count);
+		indices.reserve(count);
+	}
+
+	void push_back(const Boxes& boxes, int index)
+	{
+		x1.push_back(boxes.x1[index]);
+		y1.push_back(boxes.y1[index]);
+		x2.push_back(boxes.x2[index]);
+		y2.push_back(boxes.y2[index]);
+		area.push_back(boxArea(boxes.x1[index], boxes.y1[index], boxes.x2[index], boxes.y2[index]));
+		scores.push_back(boxes.scores[index]);
+		classes.push_back(boxes.classes.empty() ? 0 : boxes.classes[index]);
+		indices.push_back(index);
+	}
+
+	void swap(size_t a, size_t b)
+	{
+		for (auto v : {&x1, &y1, &x2, &y2, &area, &scores})
+			std::swap((*v)[a], (*v)[b]);
+		std::swap(classes[a], classes[b]);
+		std::swap(indices[a], indices[b]);
+	}
+
+	void move(size_t from, size_t to)
+	{
+		x1[to] = x1[from];
+		y1[to] = y1[from];
+		x2[to] = x2[from];
+		y2[to] = y2[from];
+		area[to] = area[from];
+		scores[to] = scores[from];
+		classes[to] = classes[from];
+		indices[to] = indices[from];
+	}
+
+	void resize(size_t count)
+	{
+		for (auto v : {&x1, &y1, &x2, &y2, &area, &scores})
+			v->resize(count);
+		classes.resize(count);
+		indices.resize(count);
+	}
+
+	size_t size() const { return indices.size(); }
+};
+
+// Candidates above the score threshold in descending score order
+Candidates sortedCandidates(const Boxes& boxes, const NMSParameters& parameters)
+{
+	std::vector<int> order;
+	for (size_t i = 0; i < boxes.size(); ++i)
+		if (boxes.scores[i] > parameters.scoreThreshold)
+			order.push_back(static_cast<int>(i));
+
+	std::stable_sort(order.begin(), order.end(),
+		[&boxes](int a, int b){ return boxes.scores[a] > boxes.scores[b]; });
+
+	if (parameters.topK > 0 && parameters.topK < static_cast<int>(order.size()))
+		order.resize(parameters.topK);
+
+	Candidates candidates;
+	candidates.reserve(order.size());
+	for (int index : order)
+		candidates.push_back(boxes, index);
+	return candidates;
+}
+
+// IoU of the box i against the boxes [first, last) of the set
+void computeIoU(const Candidates& set, size_t i, size_t first, size_t last, float* iou)
+{
+	size_t j = first;
+#ifdef __SSE2__
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 bx1 = _mm_set1_ps(set.x1[i]);
+	const __m128 by1 = _mm_set1_ps(set.y1[i]);
+	const __m128 bx2 = _mm_set1_ps(set.x2[i]);
+	const __m128 by2 = _mm_set1_ps(set.y2[i]);
+	const __m128 barea = _mm_set1_ps(set.area[i]);
+	for (; j + 4 <= last; j += 4)
+	{
+		const __m128 w = _mm_max_ps(zero, _mm_sub_ps(_mm_min_ps(bx2, _mm_loadu_ps(&set.x2[j])), _mm_max_ps(bx1, _mm_loadu_ps(&set.x1[j]))));
+		const __m128 h = _mm_max_ps(zero, _mm_sub_ps(_mm_min_ps(by2, _mm_loadu_ps(&set.y2[j])), _mm_max_ps(by1, _mm_loadu_ps(&set.y1[j]))));
+		const __m128 inter = _mm_mul_ps(w, h);
+		const __m128 uni = _mm_sub_ps(_mm_add_ps(barea, _mm_loadu_ps(&set.area[j])), inter);
+		// zero union gives zero IoU
+		const __m128 valid = _mm_cmpgt_ps(uni, zero);
+		_mm_storeu_ps(iou + j - first, _mm_and_ps(valid, _mm_div_ps(inter, _mm_max_ps(uni, _mm_set1_ps(FLT_MIN)))));
+	}
+#endif
+	for (; j < last; ++j)
+	{
+		const float w = std::min(set.x2[i], set.x2[j]) - std::max(set.x1[i], set.x1[j]);
+		const float h = std::min(set.y2[i], set.y2[j]) - std::max(set.y1[i], set.y1[j]);
+		const float inter = (w > 0 && h > 0) ? w * h : 0;
+		const float uni = set.area[i] + set.area[j] - inter;
+		iou[j - first] = uni > 0 ? inter / uni : 0;
+	}
+}
+
+// true if the candidate overlaps one of the kept boxes more than the threshold
+bool isSuppressed(const Candidates& kept, const Candidates& candidates, size_t i, const NMSParameters& parameters)
+{
+	const size_t count = kept.size();
+	const float x1 = candidates.x1[i], y1 = candidates.y1[i], x2 = candidates.x2[i], y2 = candidates.y2[i];
+	const float area = candidates.area[i];
+	const int class_id = candidates.classes[i];
+
+	size_t k = 0;
+#ifdef __SSE2__
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 bx1 = _mm_set1_ps(x1);
+	const __m128 by1 = _mm_set1_ps(y1);
+	const __m128 bx2 = _mm_set1_ps(x2);
+	const __m128 by2 = _mm_set1_ps(y2);
+	const __m128 barea = _mm_set1_ps(area);
+	const __m128 threshold = _mm_set1_ps(parameters.iouThreshold);
+	const __m128i bclass = _mm_set1_epi32(class_id);
+	for (; k + 4 <= count; k += 4)
+	{
+		const __m128 w = _mm_max_ps(zero, _mm_sub_ps(_mm_min_ps(bx2, _mm_loadu_ps(&kept.x2[k])), _mm_max_ps(bx1, _mm_loadu_ps(&kept.x1[k]))));
+		const __m128 h = _mm_max_ps(zero, _mm_sub_ps(_mm_min_ps(by2, _mm_loadu_ps(&kept.y2[k])), _mm_max_ps(by1, _mm_loadu_ps(&kept.y1[k]))));
+		const __m128 inter = _mm_mul_ps(w, h);
+		const __m128 uni = _mm_sub_ps(_mm_add_ps(barea, _mm_loadu_ps(&kept.area[k])), inter);
+		// inter / union > threshold without division
+		__m128 mask = _mm_cmpgt_ps(inter, _mm_mul_ps(threshold, uni));
+		if (parameters.classAware)
+			mask = _mm_and_ps(mask, _mm_castsi128_ps(_mm_cmpeq_epi32(bclass, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kept.classes[k])))));
+		if (_mm_movemask_ps(mask))
+			return true;
+	}
+#endif
+	for (; k < count; ++k)
+	{
+		if (parameters.classAware && kept.classes[k] != class_id)
+			continue;
+		const float w = std::min(x2, kept.x2[k]) - std::max(x1, kept.x1[k]);
+		const float h = std::min(y2, kept.y2[k]) - std::max(y1, kept.y1[k]);
+		const float inter = (w > 0 && h > 0) ? w * h : 0;
+		if (inter > parameters.iouThreshold * (area + kept.area[k] - inter))
+			return true;
+	}
+	return false;
+}
+
+std::vector<int> hardNMS(const Boxes& boxes, const NMSParameters& parameters, std::vector<float>* scores)
+{
+	Candidates candidates = sortedCandidates(boxes, parameters);
+	Candidates kept;
+	kept.reserve(candidates.size());
+
+	for (size_t i = 0; i < candidates.size(); ++i)
+		if (!isSuppressed(kept, candidates, i, parameters))
+			kept.push_back(boxes, candidates.indices[i]);
+
+	if (scores)
+		*scores = kept.scores;
+	return kept.indices;
+}
+
+std::vector<int> softNMS(const Boxes& boxes, const NMSParameters& parameters, std::vector<float>* scores)
+{
+	Candidates candidates = sortedCandidates(boxes, parameters);
+	std::vector<float> iou(candidates.size());
+	std::vector<int> indices;
+	std::vector<float> keptScores;
+
+	// the first candidate has the highest score, the rest are rescored after every pick
+	size_t first = 0;
+	while (first < candidates.size())
+	{
+		size_t best = first;
+		for (size_t i = first + 1; i < candidates.size(); ++i)
+			if (candidates.scores[i] > candidates.scores[best])
+				best = i;
+		candidates.swap(first, best);
+
+		indices.push_back(candidates.indices[first]);
+		keptScores.push_back(candidates.scores[first]);
+
+		computeIoU(candidates, first, first + 1, candidates.size(), iou.data());
+
+		size_t last = first + 1;
+		for (size_t i = first + 1; i < candidates.size(); ++i)
+		{
+			const float overlap = iou[i - first - 1];
+			float score = candidates.scores[i];
+			if (!parameters.classAware || candidates.classes[i] == candidates.classes[first])
+			{
+				if (parameters.method == NMSMethod::SOFT_GAUSSIAN)
+					score *= std::exp(-(overlap * overlap) / parameters.sigma);
+				else if (overlap > parameters.iouThreshold)
+					score *= 1 - overlap;
+			}
+			if (score > parameters.scoreThreshold)
+			{
+				candidates.move(i, last);
+				candidates.scores[last++] = score;
+			}
+		}
+		candidates.resize(last);
+		++first;
+	}
+
+	if (scores)
+		*scores = std::move(keptScores);
+	return indices;
+}
+
+}
+
+void Boxes::reserve(size_t count)
+{
+	for (auto v : {&x1, &y1, &x2, &y2, &scores})
+		v->reserve(count);
+	classes.reserve(count);
+}
+
+void Boxes::clear()
+{
+	for (auto v : {&x1, &y1, &x2, &y2, &scores})
+		v->clear();
+	classes.clear();
+}
+
+void Boxes::push_back(float box_x1, float box_y1, float box_x2, float box_y2, float score, int class_id)
+{
+	x1.push_back(box_x1);
+	y1.push_back(box_y1);
+	x2.push_back(box_x2);
+	y2.push_back(box_y2);
+	scores.push_back(score);
+	classes.push_back(class_id);
+}
+
+NMSMethod nmsMethodFromString(const std::string& method)
+{
+	if (method == "hard")
+		return NMSMethod::HARD;
+	if (method == "soft_linear")
+		return NMSMethod::SOFT_LINEAR;
+	if (method == "soft_gaussian")
+		return NMSMethod::SOFT_GAUSSIAN;
+	throw tdv::utils::rassert::tdv_error(0xb2392a02, "unknown nms method: " + method);
+}
+
+std::vector<int> nms(const Boxes& boxes, const NMSParameters& parameters, std::vector<float>* scores)
+{
+	RHAssert2(0xe30ac701, boxes.x1.size() == boxes.size() && boxes.y1.size() == boxes.size() &&
+		boxes.x2.size() == boxes.size() && boxes.y2.size() == boxes.size(), "inconsistent boxes arrays");
+	RHAssert2(0x03c1d41e, boxes.classes.empty() || boxes.classes.size() == boxes.size(), "inconsistent boxes arrays");
+
+	if (parameters.method == NMSMethod::HARD)
+		return hardNMS(boxes, parameters, scores);
+	return softNMS(boxes, parameters, scores);
+}
+
+} // nms_utils
+} // namespace utils
+} // namespace tdv
@@ -0,0 +1,195 @@
+#include <tdv/utils/profiler/Profiler.h>
+
+#include <exception>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace profiler
+{
+
+namespace
+{
+
+thread_local Profile* currentProfile = nullptr;
+
+void accumulate(Profile::Stages& stages, const std::string& stage, double ms)
+{
+	for (auto& item : stages)
+	{
+		if (item.first == stage)
+		{
+			item.second += ms;
+			return;
+		}
+	}
+	stages.emplace_back(stage, ms);
+}
+
+void accumulate(tdv::data::Context& ctx, const Profile::Stages& stages)
+{
+	for (const auto& stage : stages)
+	{
+		tdv::data::Context& value = ctx[stage.first];
+		value = (value.is<double>() ? value.get<double>() : 0.) + stage.second;
+	}
+}
+
+}
+
+void Profile::add(const std::string& stage, double ms)
+{
+	accumulate(stages, stage, ms);
+	if (object >= 0)
+		accumulate(objects[object], stage, ms);
+}
+
+void Profile::merge(const Profile& other)
+{
+	for (const auto& stage : other.stages)
+		add(stage.first, stage.second);
+	for (const auto& item : other.objects)
+		for (const auto& stage : item.second)
+			accumulate(objects[item.first], stage.first, stage.second);
+}
+
+Profile* Profile::current()
+{
+	return currentProfile;
+}
+
+ProfileScope::ProfileScope(Profile* profile) :
+	previous(currentProfile)
+{
+	currentProfile = profile;
+}
+
+ProfileScope::~ProfileScope()
+{
+	currentProfile = previous;
+}
+
+TaskProfile::TaskProfile() :
+	parent(Profile::current()),
+	metrics(tdv::utils::metrics::BlockMetrics::current())
+{}
+
+void TaskProfile::merge()
+{
+	if (parent)
+		parent->merge(profile);
+}
+
+TaskProfile::Scope::Scope(TaskProfile& task) :
+	profileScope(task.parent ? &task.profile : nullptr),
+	previous(tdv::utils::metrics::BlockMetrics::current())
+{
+	tdv::utils::metrics::BlockMetrics::setCurrent(task.metrics);
+}
+
+TaskProfile::Scope::~Scope()
+{
+	tdv::utils::metrics::BlockMetrics::setCurrent(previous);
+}
+
+StageTimer::StageTimer(const char* stage) :
+	profile(currentProfile),
+	metrics(tdv::utils::metrics::BlockMetrics::current()),
+	stage(stage),
+	traced(TraceRecorder::isEnabled())
+{
+	if (profile || metrics || traced)
+		start = std::chrono::steady_clock::now();
+}
+
+StageTimer::~StageTimer()
+{
+	stop();
+}
+
+void StageTimer::stop()
+{
+	if (profile || metrics || traced)
+	{
+		const auto end = std::chrono::steady_clock::now();
+		if (profile)
+			profile->add(stage, std::chrono::duration<double, std::milli>(end - start).count());
+		if (metrics)
+			metrics->recordStage(stage, std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+		if (traced)
+			TraceRecorder::record(stage, "stage", TraceRecorder::toMicroseconds(start), TraceRecorder::toMicroseconds(end));
+	}
+	profile = nullptr;
+	metrics = nullptr;
+	traced = false;
+}
+
+BlockProfiler::BlockProfiler(const tdv::data::Context& config, const std::string& defaultName) :
+	enabled(config.get<bool>("enable_profiling", false)),
+	histogramsEnabled(config.get<bool>("profiling_histograms", false)),
+	name(config.get<std::string>("unit_type", defaultName)),
+	traceName(TraceRecorder::intern(name)),
+	metrics(tdv::utils::metrics::MetricsRegistry::instance().block(name))
+{}
+
+void BlockProfiler::write(const Profile& profile, tdv::data::Context& data)
+{
+	if (!enabled || !data.isObject())
+		return;
+
+	tdv::data::Context& blockProfile = data["@profile"][name];
+	accumulate(blockProfile["stages"], profile.getStages());
+	for (const auto& object : profile.getObjects())
+		accumulate(blockProfile["objects"][std::to_string(object.first)], object.second);
+
+	if (histogramsEnabled)
+	{
+		// the stage timers record to the metrics of the block, so both report the same histograms
+		tdv::data::Context& output = blockProfile["histograms"];
+		metrics.forEachStage([&output](const char* stage, const tdv::utils::metrics::Histogram& histogram)
+		{
+			output[stage] = histogram.toContext(1e-3);
+		});
+	}
+}
+
+BlockScope::BlockScope(const BlockProfiler& profiler, const tdv::data::Context& data) :
+	traceSpan(profiler.getTraceName(), "block"),
+	data(data),
+	metrics(profiler.getMetrics()),
+	previous(tdv::utils::metrics::BlockMetrics::current()),
+	start(std::chrono::steady_clock::now())
+{
+	tdv::utils::metrics::BlockMetrics::setCurrent(&metrics);
+}
+
+BlockScope::~BlockScope()
+{
+	tdv::utils::metrics::BlockMetrics::setCurrent(previous);
+	if (previous == &metrics)
+		return;
+
+	metrics.calls.add();
+	metrics.latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+
+	if (std::uncaught_exception())
+	{
+		// the error code is known to the catching side only, see TDVProcessingBlock_processContext
+		metrics.errors.add();
+		tdv::utils::metrics::setLastFailedBlock(metrics.getName());
+		return;
+	}
+
+	if (!data.isObject())
+		return;
+	if (data.contains("image"))
+		metrics.frames.add();
+	if (data.contains("objects") && data.at("objects").isArray())
+		metrics.objects.add(data.at("objects").size());
+}
+
+} // profiler
+} // namespace utils
+} // namespace tdv
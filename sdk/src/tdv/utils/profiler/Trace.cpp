@@ -0,0 +1,274 @@
+#include <tdv/utils/profiler/Trace.h>
+#include <tdv/utils/rassert/RAssert.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+
+namespace tdv
+{
+namespace utils
+{
+namespace profiler
+{
+
+namespace
+{
+
+using NJSON = nlohmann::json;
+
+const int64_t SDK_PID = 0;
+const int64_t EXTERNAL_PID = 1;
+
+struct Event
+{
+	const char* name;
+	const char* category;
+	int64_t start;
+	int64_t duration;
+	int64_t object;
+};
+
+// written by the owning thread only, the lock is contended by dumps only.
+// The ring grows on demand up to the capacity, so threads recording a few spans stay small
+struct ThreadBuffer
+{
+	std::mutex mutex;
+	std::vector<Event> events;
+	size_t capacity = 0;
+	size_t next = 0;	// the oldest event once the ring is full
+	uint64_t generation = 0;
+	int64_t tid = 0;
+};
+
+struct Registry
+{
+	std::mutex mutex;
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;	// buffers outlive their threads to be dumped, see threadBuffer()
+	std::set<std::string> names;
+	std::vector<std::pair<std::string, int64_t>> externalTraces;
+	std::atomic<size_t> capacity{65536};
+	std::atomic<uint64_t> generation{1};
+	int64_t nextTid = 1;
+};
+
+// never destroyed, threads may still record during the static destruction
+Registry& registry()
+{
+	static Registry* instance = new Registry();
+	return *instance;
+}
+
+const std::chrono::steady_clock::time_point& epoch()
+{
+	static const std::chrono::steady_clock::time_point value = std::chrono::steady_clock::now();
+	return value;
+}
+
+ThreadBuffer& threadBuffer()
+{
+	thread_local std::shared_ptr<ThreadBuffer> buffer;
+	if (!buffer)
+	{
+		Registry& reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		// a buffer held by the registry only belongs to an exited thread and is taken over with its track,
+		// so short lived threads (e.g. std::async tasks) neither add buffers nor tracks
+		for (const auto& item : reg.buffers)
+			if (item.use_count() == 1)
+			{
+				buffer = item;
+				break;
+			}
+		if (!buffer)
+		{
+			buffer = std::make_shared<ThreadBuffer>();
+			buffer->tid = reg.nextTid++;
+			reg.buffers.push_back(buffer);
+		}
+	}
+	return *buffer;
+}
+
+NJSON metadata(const char* name, int64_t pid, int64_t tid, const std::string& value)
+{
+	NJSON event = {{"name", name}, {"ph", "M"}, {"pid", pid}, {"args", {{"name", value}}}};
+	if (tid >= 0)
+		event["tid"] = tid;
+	return event;
+}
+
+void appendExternalTrace(const std::string& path, int64_t offset, NJSON& events)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+		return;
+
+	NJSON trace;
+	try
+	{
+		file >> trace;
+	}
+	catch (const std::exception&)
+	{
+		return;	// the file is still being written
+	}
+
+	NJSON& external = trace.is_object() && trace.contains("traceEvents") ? trace["traceEvents"] : trace;
+	if (!external.is_array())
+		return;
+
+	for (NJSON& event : external)
+	{
+		if (!event.is_object())
+			continue;
+		if (event.contains("ts") && event["ts"].is_number())
+			event["ts"] = event["ts"].get<int64_t>() + offset;
+		event["pid"] = EXTERNAL_PID;
+		events.push_back(std::move(event));
+	}
+}
+
+}
+
+std::atomic<bool> TraceRecorder::enabled{false};
+
+void TraceRecorder::start(size_t eventsPerThread)
+{
+	Registry& reg = registry();
+	{
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		reg.externalTraces.clear();
+		reg.capacity = std::max<size_t>(eventsPerThread, 1);
+		++reg.generation;	// the buffers are reset on the next record
+		// the spans of exited threads are not dumped anymore
+		reg.buffers.erase(std::remove_if(reg.buffers.begin(), reg.buffers.end(),
+			[](const std::shared_ptr<ThreadBuffer>& buffer) { return buffer.use_count() == 1; }), reg.buffers.end());
+	}
+	epoch();
+	enabled = true;
+}
+
+void TraceRecorder::stop()
+{
+	enabled = false;
+}
+
+int64_t TraceRecorder::now()
+{
+	return toMicroseconds(std::chrono::steady_clock::now());
+}
+
+int64_t TraceRecorder::toMicroseconds(std::chrono::steady_clock::time_point time)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(time - epoch()).count();
+}
+
+void TraceRecorder::record(const char* name, const char* category, int64_t startUs, int64_t endUs, int64_t object)
+{
+	const Registry& reg = registry();
+	ThreadBuffer& buffer = threadBuffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+
+	const uint64_t generation = reg.generation.load(std::memory_order_relaxed);
+	if (buffer.generation != generation)
+	{
+		std::vector<Event>().swap(buffer.events);
+		buffer.capacity = reg.capacity.load(std::memory_order_relaxed);
+		buffer.next = 0;
+		buffer.generation = generation;
+	}
+
+	const Event event = {name, category, startUs, endUs - startUs, object};
+	if (buffer.events.size() < buffer.capacity)
+	{
+		buffer.events.push_back(event);
+	}
+	else
+	{
+		buffer.events[buffer.next] = event;
+		buffer.next = (buffer.next + 1) % buffer.capacity;
+	}
+}
+
+const char* TraceRecorder::intern(const std::string& name)
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	return reg.names.insert(name).first->c_str();
+}
+
+void TraceRecorder::addExternalTrace(const std::string& path, int64_t offsetUs)
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	reg.externalTraces.emplace_back(path, offsetUs);
+}
+
+std::string TraceRecorder::toChromeTrace()
+{
+	Registry& reg = registry();
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	std::vector<std::pair<std::string, int64_t>> externalTraces;
+	uint64_t generation;
+	{
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		buffers = reg.buffers;
+		externalTraces = reg.externalTraces;
+		generation = reg.generation;
+	}
+
+	NJSON events = NJSON::array();
+	events.push_back(metadata("process_name", SDK_PID, -1, "face_sdk"));
+
+	for (const auto& buffer : buffers)
+	{
+		std::lock_guard<std::mutex> lock(buffer->mutex);
+		if (buffer->generation != generation || buffer->events.empty())
+			continue;
+
+		events.push_back(metadata("thread_name", SDK_PID, buffer->tid, "thread " + std::to_string(buffer->tid)));
+
+		// oldest first
+		const size_t count = buffer->events.size();
+		const size_t first = buffer->next;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Event& event = buffer->events[(first + i) % buffer->events.size()];
+			NJSON item = {{"name", event.name}, {"cat", event.category}, {"ph", "X"},
+				{"ts", event.start}, {"dur", event.duration}, {"pid", SDK_PID}, {"tid", buffer->tid}};
+			if (event.object >= 0)
+				item["args"] = {{"object", event.object}};
+			events.push_back(std::move(item));
+		}
+	}
+
+	if (!externalTraces.empty())
+	{
+		events.push_back(metadata("process_name", EXTERNAL_PID, -1, "onnxruntime"));
+		for (const auto& trace : externalTraces)
+			appendExternalTrace(trace.first, trace.second, events);
+	}
+
+	NJSON result = {{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}};
+	return result.dump();
+}
+
+void TraceRecorder::dump(const std::string& path)
+{
+	const std::string trace = toChromeTrace();
+	std::ofstream file(path);
+	RHAssert2(0x57102c73, file.is_open(), "can not open trace file " + path);
+	file << trace;
+}
+
+} // profiler
+} // namespace utils
+} // namespace tdv
@@ -3,6 +3,8 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include <tdv/utils/rassert/RAssert.h>
+
 #include <iostream>
 
 namespace tdv
@@ -12,9 +14,51 @@ namespace utils
 namespace recognizer_utils
 {
 
-void construct_fda_points(const tdv::data::Context& fitter, std::vector<cv::Point2f> &dst_points, int i_w = 1, int i_h = 1);
+namespace
+{
 
-void placePoint2Ctx(tdv::data::Context& fitter, cv::Point2f point, std::string pointName)
+const std::vector<std::string> fda_string_mapping = {
+	"left_eye_brow_left", "left_eye_brow_up", "left_eye_brow_right",    //   0   1   2
+	"right_eye_brow_left", "right_eye_brow_up", "right_eye_brow_right", //   3   4   5
+	"left_eye_left", "left_eye", "left_eye_right",						//   6  (7)  8
+	"right_eye_left", "right_eye", "right_eye_right",					//   9 (10) 11
+	"left_ear_bottom",													//  12  --  --
+	"nose_left", "nose", "nose_right",									//  13 (14) 15
+	"right_ear_bottom",													//  16  --  --
+	"mouth_left", "mouth", "mouth_right",								// (17) 18 (19)
+	"chin"																//  20
+};
+
+// Fitter points stored as an array of {"x", "y", "z"}, as a float NDARRAY of shape [N, 3] or as raw x, y, z triplets
+class PointsView
+{
+public:
+	explicit PointsView(const float* data) :
+		data(data)
+	{}
+
+	explicit PointsView(const tdv::data::Context& points) :
+		points(&points)
+	{
+		if (points.isObject())
+		{
+			RHAssert2(0x3d36bc5b, points.at("dtype").get<std::string>() == "float" && points.at("shape").size() == 2 &&
+				points.at("shape")[1].get<int64_t>() == 3, "compact points must be a float array of shape [N, 3]");
+			blob = points.at("blob").get<std::shared_ptr<unsigned char>>();
+			data = reinterpret_cast<const float*>(blob.get());
+		}
+	}
+
+	double x(int index) const { return data ? data[3 * index] : (*points)[index]["x"].get<double>(); }
+	double y(int index) const { return data ? data[3 * index + 1] : (*points)[index]["y"].get<double>(); }
+
+private:
+	const tdv::data::Context* points = nullptr;
+	std::shared_ptr<unsigned char> blob;
+	const float* data = nullptr;
+};
+
+void placePoint2Ctx(tdv::data::Context& fitter, cv::Point2f point, const std::string& pointName)
 {
 	tdv::data::Context pointCtx;
 	pointCtx.push_back((double)point.x);
@@ -23,15 +67,14 @@ void placePoint2Ctx(tdv::data::Context& fitter, cv::Point2f point, std::string p
 }
 
 cv::Point2f getSpecialPointCenter(
-	const tdv::data::Context& context, 
-	std::vector<int> &point_indexs, 
+	const PointsView& points,
+	const std::vector<int> &point_indexs,
 	cv::Size2i size = cv::Size2i(1,1))
 {
 	double x = 0, y = 0;
-	const tdv::data::Context& points = context["points"];
 	for (const int& index : point_indexs){
-		x += points[index]["x"].get<double>();
-		y += points[index]["y"].get<double>();
+		x += points.x(index);
+		y += points.y(index);
 	}
 
 	return cv::Point2f(
@@ -39,38 +82,11 @@ cv::Point2f getSpecialPointCenter(
 		(float)((y / point_indexs.size()) * size.height));
 }
 
-void constructFdaPonints2Context(tdv::data::Context& fitter)
-{
-	std::vector<std::string> fda_string_mapping;
-
-	if(fitter["fitter_type"].get<std::string>() != "fda")
-	{
-		fda_string_mapping = {
-		"left_eye_brow_left", "left_eye_brow_up", "left_eye_brow_right",    //   0   1   2
-		"right_eye_brow_left", "right_eye_brow_up", "right_eye_brow_right", //   3   4   5
-		"left_eye_left", "left_eye", "left_eye_right",						//   6  (7)  8
-		"right_eye_left", "right_eye", "right_eye_right",					//   9 (10) 11
-		"left_ear_bottom",													//  12  --  --			
-		"nose_left", "nose", "nose_right",									//  13 (14) 15 
-		"right_ear_bottom",													//  16  --  -- 
-		"mouth_left", "mouth", "mouth_right",								// (17) 18 (19)
-		"chin"																//  20
-		};
-	}
-	std::vector<cv::Point2f> constructed_points;
-
-	construct_fda_points(fitter, constructed_points);
-
-	for(int i = 0; i < constructed_points.size(); ++i)
-	{
-		placePoint2Ctx(fitter, constructed_points[i], fda_string_mapping[i]);
-	}
-}
-
 void construct_fda_points(
-	const tdv::data::Context& fitter,
+	const std::string& fitter_type,
+	const PointsView& points,
 	std::vector<cv::Point2f> &dst_points,
-	int i_w, int i_h)
+	int i_w = 1, int i_h = 1)
 {
 	std::vector<int> fda_mapping;
 	std::vector<int> mouth_center;
@@ -78,14 +94,14 @@ void construct_fda_points(
 	std::vector<int> left_eye_center;
 
 	//	{0,   1,    2,   3,   4,   5,   6,   7,   8,   9,  10,  11, 12,  13, 14,  15,  16, 17, 18,  19, 20};
-	if (fitter["fitter_type"].get<std::string>() == "mesh") // mesh
+	if (fitter_type == "mesh") // mesh
 	{
 		fda_mapping =  {70, 105, 107, 336, 334, 300,  33, -1, 133, 362, -1, 263, 93, 218,  1, 294, 361, 78, -1, 308, 152};
 		mouth_center = {13, 14};
 		right_eye_center = {385, 387, 380, 373};
 		left_eye_center = {160, 158, 144, 153};
 	}
-	else if (fitter["fitter_type"].get<std::string>() == "tddfa")
+	else if (fitter_type == "tddfa")
 	{
 		fda_mapping =  {17, 19, 21, 22, 24, 26, 36, -1, 39, 42, -1, 45, 2, 31, 30, 35, 14, 48, 62, 54, 8};
 		mouth_center = {48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67};
@@ -93,7 +109,6 @@ void construct_fda_points(
 		left_eye_center = {42, 43, 44, 45, 46};
 	}
 
-	const tdv::data::Context& points = fitter["points"];
 	for(size_t i = 0; i < fda_mapping.size(); ++i)
 	{
 		int ind = fda_mapping[i];
@@ -101,8 +116,8 @@ void construct_fda_points(
 		if(ind != -1)
 		{
 			cv::Point2f cvPoint(
-				points[ind]["x"].get<double>() * i_w,
-				points[ind]["y"].get<double>() * i_h
+				points.x(ind) * i_w,
+				points.y(ind) * i_h
 			);
 			dst_points.push_back(cvPoint);
 		} else {
@@ -110,164 +125,71 @@ void construct_fda_points(
 		}
 	}
 
-	if (fitter["fitter_type"].get<std::string>() != "fda")
+	if (fitter_type != "fda")
 	{
-		dst_points[18] = getSpecialPointCenter(fitter, mouth_center, cv::Size2i(i_w, i_h));
-		dst_points[7] = getSpecialPointCenter(fitter, left_eye_center, cv::Size2i(i_w, i_h));
-		dst_points[10]= getSpecialPointCenter(fitter, right_eye_center, cv::Size2i(i_w, i_h));
+		dst_points[18] = getSpecialPointCenter(points, mouth_center, cv::Size2i(i_w, i_h));
+		dst_points[7] = getSpecialPointCenter(points, left_eye_center, cv::Size2i(i_w, i_h));
+		dst_points[10]= getSpecialPointCenter(points, right_eye_center, cv::Size2i(i_w, i_h));
 	}
 }
 
-cv::Matx23f estimate_scaled_rigid_transform(
-	const std::vector<cv::Point2f> &src,
-	const std::vector<cv::Point2f> &dst,
-	const int iterations_count=10)
+void placeFdaPoints2Context(tdv::data::Context& fitter, const PointsView& points)
 {
-	std::vector<float> weights(src.size(), 1.f);
-
-	std::vector<float> temp(src.size());
-
-	for(int iterations = 0; ; ++iterations)
-	{
-		// scaled rigid transform is just a matrix:
-		//    a b c
-		//   -b a d
-		// with arbitrary a, b, c and d
-
-		// here we will iteratively compute it, reweighting points pairs by they error from prev iteration
-
-		float sa[4][4], sb[4], sr[4];
-
-		std::memset(sa, 0, sizeof(sa));
-		std::memset(sb, 0, sizeof(sb));
-		std::memset(sr, 0, sizeof(sr));
-
-		for(size_t i = 0; i < src.size(); ++i)
-		{
-			const cv::Point2f &a = src[i];
-			const cv::Point2f &b = dst[i];
-			const float w = weights[i];
-
-			#if 0
-			// naive and without weights
-			sa[0][0] += a.x * a.x  +  a.y * a.y;
-			sa[0][1] += a.x * a.y  +  a.y * (-a.x);  // = 0
-			sa[0][2] += a.x * 1    +  a.y * 0;
-			sa[0][3] += a.x * 0    +  a.y * 1;
-
-			sa[1][0] += a.y * a.x  +  (-a.x) * a.y;
-			sa[1][1] += a.y * a.y  +  (-a.x) * (-a.x);
-			sa[1][2] += a.y * 1    +  (-a.x) * 0;
-			sa[1][3] += a.y * 0    +  (-a.x) * 1;
-
-			sa[2][0] += 1 * a.x    +  0 * a.y;
-			sa[2][1] += 1 * a.y    +  0 * (-a.x);
-			sa[2][2] += 1 * 1      +  0 * 0;
-			sa[2][3] += 1 * 0      +  0 * 1;
-
-			sa[3][0] += 0 * a.x    +  1 * a.y;
-			sa[3][1] += 0 * a.y    +  1 * (-a.x);
-			sa[3][2] += 0 * 1      +  1 * 0;
-			sa[3][3] += 0 * 0      +  1 * 1;
-
-			sb[0] += a.x * b.x     + a.y * b.y;
-			sb[1] += a.y * b.x     + (-a.x) * b.y;
-			sb[2] += 1 * b.x       + 0 * b.y;
-			sb[3] += 0 * b.x       + 1 * b.y;
-			#else
-
-			sa[0][0] += w * ( a.x * a.x  +  a.y * a.y );
-			sa[0][2] += w * ( a.x );
-			sa[0][3] += w * ( a.y );
-			sa[1][0] += w * ( a.y * a.x  -  a.x * a.y );
-			sa[2][2] += w * ( 1.f );
-
-			sb[0] += w * ( a.x * b.x + a.y * b.y );
-			sb[1] += w * ( a.y * b.x - a.x * b.y );
-			sb[2] += w * ( b.x );
-			sb[3] += w * ( b.y );
-			#endif
-		}
-
-		sa[1][1] = sa[0][0];
-		sa[1][2] = sa[0][3];
-		sa[1][3] = - sa[0][2];
-
-		sa[2][0] = sa[0][2];
-		sa[2][1] = sa[0][3];
-
-		sa[3][0] = sa[0][3];
-		sa[3][1] = -sa[0][2];
-		sa[3][3] = sa[2][2];
-
-
-		float sw[4];
-		for(int i = 0; i < 4; ++i)
-			sw[i] = 1.f / sqrt( std::abs<float>(sa[i][i]) + 1e-6 );
-
-
-		for(int i = 0; i < 4; ++i)
-		{
-			sb[i] *= sw[i];
-
-			for(int j = 0; j < 4; ++j)
-				sa[i][j] *= sw[i] * sw[j];
-		}
-
-		const bool solved = cv::solve(
-			cv::Mat_<float>(4, 4, (float*) sa),
-			cv::Mat_<float>(4, 1, (float*) sb),
-			cv::Mat_<float>(4, 1, (float*) sr),
-			cv::DECOMP_SVD);
-
-		for(int i = 0; i < 4; ++i)
-			sr[i] *= sw[i];
+	const std::string fitter_type = fitter["fitter_type"].get<std::string>();
+	if (fitter_type == "fda")
+		return;
 
-		if(iterations >= iterations_count)
-		{
-			cv::Matx23f result;
-			result(0, 0) = sr[0];
-			result(0, 1) = sr[1];
-			result(0, 2) = sr[2];
-			result(1, 0) = -sr[1];
-			result(1, 1) = sr[0];
-			result(1, 2) = sr[3];
-			return result;
-		}
+	std::vector<cv::Point2f> constructed_points;
 
+	construct_fda_points(fitter_type, points, constructed_points);
 
-		for(size_t i = 0; i < src.size(); ++i)
-		{
-			const cv::Point2f &a = src[i];
-			const cv::Point2f &b = dst[i];
-
-			cv::Point2f c;
-			c.x =   a.x * sr[0] + a.y * sr[1] + sr[2];
-			c.y = - a.x * sr[1] + a.y * sr[0] + sr[3];
+	for(size_t i = 0; i < constructed_points.size(); ++i)
+	{
+		placePoint2Ctx(fitter, constructed_points[i], fda_string_mapping[i]);
+	}
+}
 
-			weights[i] = cv::norm(b-c);
-		}
+cv::Point2f namedPoint(const tdv::data::Context& fitter, int index, cv::Size2i size)
+{
+	const tdv::data::Context& proj = fitter[fda_string_mapping[index]]["proj"];
+	return cv::Point2f(proj[0].get<double>() * size.width, proj[1].get<double>() * size.height);
+}
 
-		temp = weights;
+}
 
-		std::nth_element(
-			temp.data(),
-			temp.data() + temp.size() / 2,
-			temp.data() + temp.size());
+LandmarksOutput landmarksOutputFromString(const std::string& output)
+{
+	if (output == "verbose")
+		return LandmarksOutput::VERBOSE;
+	if (output == "compact")
+		return LandmarksOutput::COMPACT;
+	if (output == "fda")
+		return LandmarksOutput::FDA;
+	throw tdv::utils::rassert::tdv_error(0x60482025, "unknown landmarks output: " + output);
+}
 
-		const float nw = temp[temp.size() / 2];
+void constructFdaPonints2Context(tdv::data::Context& fitter)
+{
+	placeFdaPoints2Context(fitter, PointsView(fitter["points"]));
+}
 
-		for(size_t i = 0; i < src.size(); ++i)
-			weights[i] = 1.f / (nw + weights[i] + 1e-6);
-	}
+void constructFdaPonints2Context(tdv::data::Context& fitter, const float* points)
+{
+	placeFdaPoints2Context(fitter, PointsView(points));
 }
 
-// TO DO optimize
-cv::Matx23f makeCrop2ImageByPoints(const tdv::data::Context& fitter, cv::Mat& image, const int base_crop_size)
+cv::Matx23f makeCrop2ImageByPoints(const tdv::data::Context& fitter, const cv::Mat& image, const int base_crop_size,
+	alignment::AlignmentMethod method)
 {
 	std::vector<cv::Point2f> constructed_points;
 
-	construct_fda_points(fitter, constructed_points, image.cols, image.rows);
+	// without the point set (fda landmarks output) the named points are used directly
+	if (fitter.contains("points"))
+		construct_fda_points(fitter["fitter_type"].get<std::string>(), PointsView(fitter["points"]), constructed_points, image.cols, image.rows);
+	else
+		for (size_t i = 0; i < fda_string_mapping.size(); ++i)
+			constructed_points.push_back(fitter.contains(fda_string_mapping[i]) ?
+				namedPoint(fitter, static_cast<int>(i), image.size()) : cv::Point2f(-1.f, -1.f));
 
 	static const int target_points_count = 5;
 	static const int crop_size_src = 112;
@@ -296,10 +218,10 @@ cv::Matx23f makeCrop2ImageByPoints(const tdv::data::Context& fitter, cv::Mat& im
 	};
 
 	const cv::Matx23f crop2image =
-		estimate_scaled_rigid_transform(
+		alignment::estimateSimilarity(
 			std::vector<cv::Point2f> (crop_points,  crop_points  + target_points_count ),
 			std::vector<cv::Point2f> (image_points, image_points + target_points_count ),
-			10  // = iterations_count
+			method
 		);
 
 	return crop2image;
@@ -307,7 +229,7 @@ cv::Matx23f makeCrop2ImageByPoints(const tdv::data::Context& fitter, cv::Mat& im
 }
 
 void warpAffine(
-	cv::Mat &src,
+	const cv::Mat &src,
 	cv::Mat &dst,
 	const cv::Matx23f &transform_m_input_,
 	const cv::Size &dsize)
@@ -0,0 +1,232 @@
+#include <tdv/utils/tracker_utils/Tracker.h>
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+namespace tdv
+{
+namespace utils
+{
+namespace tracker_utils
+{
+
+namespace
+{
+
+const float STD_WEIGHT_POSITION = 1.f / 20;
+const float STD_WEIGHT_VELOCITY = 1.f / 160;
+
+float iou(const Track& track, const Detection& detection)
+{
+	float x1, y1, x2, y2;
+	track.box(x1, y1, x2, y2);
+	const float w = std::min(x2, detection.x2) - std::max(x1, detection.x1);
+	const float h = std::min(y2, detection.y2) - std::max(y1, detection.y1);
+	if (w <= 0 || h <= 0)
+		return 0;
+	const float inter = w * h;
+	const float uni = (x2 - x1) * (y2 - y1) + (detection.x2 - detection.x1) * (detection.y2 - detection.y1) - inter;
+	return uni > 0 ? inter / uni : 0;
+}
+
+void normalize(std::vector<float>& v)
+{
+	float norm2 = 0;
+	for (float value : v)
+		norm2 += value * value;
+	if (norm2 > 0)
+	{
+		const float m = 1.f / std::sqrt(norm2);
+		for (float& value : v)
+			value *= m;
+	}
+}
+
+float cosine(const std::vector<float>& unit, const std::vector<float>& v)
+{
+	if (unit.size() != v.size())
+		return 0;
+	float dot = 0, norm2 = 0;
+	for (size_t i = 0; i < v.size(); ++i)
+	{
+		dot += unit[i] * v[i];
+		norm2 += v[i] * v[i];
+	}
+	return norm2 > 0 ? dot / std::sqrt(norm2) : 0;
+}
+
+}
+
+void KalmanFilter1D::init(float position, float height)
+{
+	x[0] = position;
+	x[1] = 0;
+	const float sp = 2 * STD_WEIGHT_POSITION * height, sv = 10 * STD_WEIGHT_VELOCITY * height;
+	p[0][0] = sp * sp;
+	p[0][1] = p[1][0] = 0;
+	p[1][1] = sv * sv;
+}
+
+void KalmanFilter1D::predict(float height)
+{
+	const float qp = STD_WEIGHT_POSITION * height, qv = STD_WEIGHT_VELOCITY * height;
+	x[0] += x[1];
+	// P = F P F^T + Q, F = [[1, 1], [0, 1]]
+	p[0][0] += p[0][1] + p[1][0] + p[1][1] + qp * qp;
+	p[0][1] += p[1][1];
+	p[1][0] += p[1][1];
+	p[1][1] += qv * qv;
+}
+
+void KalmanFilter1D::update(float position, float height)
+{
+	const float r = STD_WEIGHT_POSITION * height;
+	const float s = p[0][0] + r * r;
+	const float k0 = p[0][0] / s, k1 = p[1][0] / s;
+	const float innovation = position - x[0];
+	x[0] += k0 * innovation;
+	x[1] += k1 * innovation;
+	// P = (I - K H) P, H = [1, 0]
+	const float p00 = p[0][0], p01 = p[0][1];
+	p[0][0] -= k0 * p00;
+	p[0][1] -= k0 * p01;
+	p[1][0] -= k1 * p00;
+	p[1][1] -= k1 * p01;
+}
+
+void Track::box(float& x1, float& y1, float& x2, float& y2) const
+{
+	const float cx = filters[0].position(), cy = filters[1].position();
+	const float w = std::max(filters[2].position(), 0.f), h = std::max(filters[3].position(), 0.f);
+	x1 = cx - w / 2;
+	y1 = cy - h / 2;
+	x2 = cx + w / 2;
+	y2 = cy + h / 2;
+}
+
+Tracker::Tracker(const TrackerParameters& parameters) :
+	parameters(parameters)
+{}
+
+void Tracker::predict()
+{
+	for (Track& track : tracks)
+	{
+		const float height = track.filters[3].position();
+		for (KalmanFilter1D& filter : track.filters)
+			filter.predict(height);
+		track.confidence *= parameters.confidenceDecay;
+	}
+}
+
+void Tracker::match(const std::vector<Detection>& detections, const std::vector<size_t>& candidates,
+	std::vector<bool>& trackMatched, std::vector<int64_t>& result)
+{
+	// (similarity, detection, track) pairs above the threshold, the most similar are matched first
+	std::vector<std::tuple<float, size_t, size_t>> pairs;
+	for (size_t d : candidates)
+	{
+		const Detection& detection = detections[d];
+		for (size_t t = 0; t < tracks.size(); ++t)
+		{
+			if (trackMatched[t] || tracks[t].label != detection.label)
+				continue;
+			float similarity = iou(tracks[t], detection);
+			if (parameters.embeddingWeight > 0 && detection.embedding && !tracks[t].embedding.empty())
+				similarity = (1 - parameters.embeddingWeight) * similarity +
+					parameters.embeddingWeight * cosine(tracks[t].embedding, *detection.embedding);
+			if (similarity >= parameters.matchThreshold)
+				pairs.emplace_back(similarity, d, t);
+		}
+	}
+	std::sort(pairs.begin(), pairs.end(),
+		[](const std::tuple<float, size_t, size_t>& a, const std::tuple<float, size_t, size_t>& b){ return std::get<0>(a) > std::get<0>(b); });
+
+	for (const auto& pair : pairs)
+	{
+		const size_t d = std::get<1>(pair), t = std::get<2>(pair);
+		if (result[d] >= 0 || trackMatched[t])
+			continue;
+		trackMatched[t] = true;
+
+		const Detection& detection = detections[d];
+		Track& track = tracks[t];
+		const float h = detection.y2 - detection.y1;
+		track.filters[0].update((detection.x1 + detection.x2) / 2, h);
+		track.filters[1].update((detection.y1 + detection.y2) / 2, h);
+		track.filters[2].update(detection.x2 - detection.x1, h);
+		track.filters[3].update(h, h);
+		track.score = track.confidence = detection.score;
+		++track.hits;
+		track.lostFrames = 0;
+		track.active = true;
+		if (detection.embedding)
+		{
+			if (track.embedding.size() != detection.embedding->size())
+				track.embedding = *detection.embedding;
+			else
+				for (size_t i = 0; i < track.embedding.size(); ++i)
+					track.embedding[i] = parameters.embeddingMomentum * track.embedding[i] + (1 - parameters.embeddingMomentum) * (*detection.embedding)[i];
+			normalize(track.embedding);
+		}
+		result[d] = track.id;
+	}
+}
+
+std::vector<int64_t> Tracker::update(const std::vector<Detection>& detections)
+{
+	std::vector<int64_t> result(detections.size(), -1);
+	std::vector<bool> trackMatched(tracks.size(), false);
+
+	std::vector<size_t> high, low;
+	for (size_t d = 0; d < detections.size(); ++d)
+	{
+		if (detections[d].score >= parameters.highThreshold)
+			high.push_back(d);
+		else if (detections[d].score >= parameters.lowThreshold)
+			low.push_back(d);
+	}
+
+	match(detections, high, trackMatched, result);
+	match(detections, low, trackMatched, result);
+
+	for (size_t t = 0; t < tracks.size(); ++t)
+	{
+		if (trackMatched[t])
+			continue;
+		tracks[t].active = false;
+		++tracks[t].lostFrames;
+	}
+	tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+		[this](const Track& track){ return track.lostFrames > parameters.maxLostFrames; }), tracks.end());
+
+	for (size_t d : high)
+	{
+		if (result[d] >= 0)
+			continue;
+		const Detection& detection = detections[d];
+		Track track;
+		track.id = nextId++;
+		track.label = detection.label;
+		const float h = detection.y2 - detection.y1;
+		track.filters[0].init((detection.x1 + detection.x2) / 2, h);
+		track.filters[1].init((detection.y1 + detection.y2) / 2, h);
+		track.filters[2].init(detection.x2 - detection.x1, h);
+		track.filters[3].init(h, h);
+		track.score = track.confidence = detection.score;
+		if (detection.embedding)
+		{
+			track.embedding = *detection.embedding;
+			normalize(track.embedding);
+		}
+		result[d] = track.id;
+		tracks.push_back(std::move(track));
+	}
+
+	return result;
+}
+
+} // tracker_utils
+} // namespace utils
+} // namespace tdv
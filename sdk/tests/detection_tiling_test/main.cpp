@@ -0,0 +1,80 @@
+#include <iostream>
+#include <string>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <api/Service.h>
+
+using Context = api::Context;
+
+namespace
+{
+
+/**
+ * @brief Detections of a single tiled 1280x720 frame (15 tiles and the whole frame) with the given batch size
+ */
+Context detect(api::Service& service, const cv::Mat& rgb, int64_t batchSize)
+{
+	Context config = service.createContext();
+	config["unit_type"] = "FACE_DETECTOR";
+	config["tile_size"] = 320l;
+	config["batch_size"] = batchSize;
+	api::ProcessingBlock detector = service.createProcessingBlock(config);
+
+	Context data = service.createContext();
+	data["image"]["format"] = "NDARRAY";
+	data["image"]["blob"].setDataPtr(rgb.data, static_cast<int>(rgb.total() * rgb.elemSize()));
+	data["image"]["dtype"] = "uint8_t";
+	data["image"]["shape"].push_back(static_cast<int64_t>(rgb.rows));
+	data["image"]["shape"].push_back(static_cast<int64_t>(rgb.cols));
+	data["image"]["shape"].push_back(static_cast<int64_t>(rgb.channels()));
+
+	detector(data);
+	return data;
+}
+
+bool check(bool condition, const std::string& message)
+{
+	if (!condition)
+		std::cout << "FAILED: " << message << std::endl;
+	return condition;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	const std::string sdk_dir = argc > 1 ? argv[1] : "..";
+
+	try
+	{
+		api::Service service = api::Service::createService(sdk_dir);
+
+		const cv::Mat image = cv::imread(sdk_dir + "/test_images/face.jpg", cv::IMREAD_COLOR);
+		if (image.empty())
+			throw std::runtime_error("can not read " + sdk_dir + "/test_images/face.jpg");
+		cv::Mat resized, rgb;
+		cv::resize(image, resized, cv::Size(1280, 720));
+		cv::cvtColor(resized, rgb, cv::COLOR_BGR2RGB);
+
+		// the views of the frame are split into several batches, the single image input must still get all of them
+		const Context split = detect(service, rgb, 2);
+		const Context whole = detect(service, rgb, 32);
+
+		bool ok = check(split.contains("objects"), "no objects with views above batch_size");
+		ok = check(!split.contains("objects@candidates"), "candidates of the views leak into the output") && ok;
+		ok = ok && check(split["objects"].size() == whole["objects"].size(), "detections depend on the batch size");
+		if (!ok)
+			return 1;
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "FAILED: " << e.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << "OK" << std::endl;
+	return 0;
+}